@@ -0,0 +1,269 @@
+#include "SCHC_GW_Bench_Sender.hpp"
+#include "SCHC_GW_Bench_Stack.hpp"
+#include "SCHC_GW_CRC32.hpp"
+#include <algorithm>
+#include <cstring>
+
+/* Bit pos del mensaje, MSB-first. Los bits que no estan en el mensaje valen 1 (bitmap comprimido) */
+static int get_bit(const char* msg, int len, int pos)
+{
+    if(pos >= len*8)
+        return 1;
+    return (static_cast<uint8_t>(msg[pos/8]) >> (7 - pos%8)) & 1;
+}
+
+static uint64_t get_bitmap(const char* msg, int len, int pos)
+{
+    /* bitmap de una ventana: el tile i en el bit (63 - i), como en SCHC_GW_Ack_on_error */
+    uint64_t bitmap = 0;
+    for(int i=0; i<SCHC_GW_BENCH_WINDOW_SIZE; i++)
+        bitmap = bitmap | (uint64_t(get_bit(msg, len, pos + i)) << (63 - i));
+    return bitmap;
+}
+
+uint8_t SCHC_GW_Bench_Sender::initialize(uint32_t device, int packet_size, int tiles_per_fragment, uint8_t ack_mode, int max_ack_req)
+{
+    if(packet_size < 1 || packet_size > SCHC_GW_BENCH_MAX_PACKET || tiles_per_fragment < 1)
+        return 1;
+
+    _device             = device;
+    _dev_id             = SCHC_GW_Bench_Stack::get_device_id(device);
+    _tiles_per_fragment = tiles_per_fragment;
+    _ack_mode           = ack_mode;
+    _max_ack_req        = max_ack_req;
+
+    /* El paquete no se guarda: sus bytes se generan al armar cada fragmento */
+    _packet_size    = packet_size;
+    uint32_t crc    = SCHC_GW_CRC32::init();
+    char     tile[SCHC_GW_BENCH_TILE_SIZE];
+    for(int offset=0; offset<packet_size; offset=offset+SCHC_GW_BENCH_TILE_SIZE)
+    {
+        int len = std::min(SCHC_GW_BENCH_TILE_SIZE, packet_size - offset);
+        get_packet_bytes(offset, len, tile);
+        crc = SCHC_GW_CRC32::update(crc, tile, len);
+    }
+    _rcs = SCHC_GW_CRC32::finalize(crc);
+
+    /* El ultimo tile (1 a 10 bytes) viaja en el All-1 */
+    _last_tile_len  = packet_size % SCHC_GW_BENCH_TILE_SIZE != 0 ? packet_size % SCHC_GW_BENCH_TILE_SIZE : SCHC_GW_BENCH_TILE_SIZE;
+    _n_tiles        = (packet_size - _last_tile_len) / SCHC_GW_BENCH_TILE_SIZE;
+    _last_window    = _n_tiles / SCHC_GW_BENCH_WINDOW_SIZE;
+    return 0;
+}
+
+void SCHC_GW_Bench_Sender::start(SCHC_GW_Bench_Uplink_Sink& sink)
+{
+    if(_ack_mode == ACK_MODE_ACK_END_WIN)
+    {
+        send_window(sink, 0);
+        return;
+    }
+
+    std::vector<int> tiles(_n_tiles);
+    for(int t=0; t<_n_tiles; t++)
+        tiles[t] = t;
+    send_tiles(sink, tiles, true);
+    wait_ack();
+}
+
+void SCHC_GW_Bench_Sender::on_ack(SCHC_GW_Bench_Uplink_Sink& sink, const char* msg, int len)
+{
+    if(_state != SCHC_GW_BENCH_WAITING || len < 1)
+        return;
+
+    uint8_t header  = static_cast<uint8_t>(msg[0]);
+    int     w       = header >> 6;
+    int     c       = (header >> 5) & 1;
+
+    /* ACK_END_WIN: los ACKs de ventanas anteriores son duplicados */
+    if(_ack_mode == ACK_MODE_ACK_END_WIN && w < _window)
+        return;
+
+    if(c == 1)
+    {
+        if(w == _last_window)
+        {
+            send_ack_req(sink, w);      // termina la sesion del gateway (STATE_RX_END)
+            _state = SCHC_GW_BENCH_DONE;
+        }
+        else if(_ack_mode == ACK_MODE_ACK_END_WIN)
+        {
+            send_window(sink, w + 1);
+        }
+        return;
+    }
+
+    /* C=0: se retransmiten los tiles que faltan en las ventanas del ACK */
+    std::vector<int>    tiles;
+    bool                all1 = false;
+    add_missing_tiles(w, get_bitmap(msg, len, 3), tiles, all1);
+    if(_ack_mode == ACK_MODE_COMPOUND_ACK)
+    {
+        /* Las ventanas siguientes llevan W y el bitmap completo, sin C */
+        for(int pos = 3 + SCHC_GW_BENCH_WINDOW_SIZE; pos + 2 + SCHC_GW_BENCH_WINDOW_SIZE <= len*8; pos = pos + 2 + SCHC_GW_BENCH_WINDOW_SIZE)
+        {
+            int next_w = (get_bit(msg, len, pos) << 1) | get_bit(msg, len, pos + 1);
+            add_missing_tiles(next_w, get_bitmap(msg, len, pos + 2), tiles, all1);
+        }
+    }
+
+    /* Un ACK que no pide nada no reinicia la espera: los ACK REQ siguen contando para el fallo */
+    if(tiles.empty() && !all1)
+        return;
+
+    if(_ack_mode == ACK_MODE_ACK_END_WIN)
+        _window = w;
+    _retransmitted_tiles = _retransmitted_tiles + tiles.size();
+    send_tiles(sink, tiles, all1);
+    wait_ack();
+}
+
+void SCHC_GW_Bench_Sender::on_timeout(SCHC_GW_Bench_Uplink_Sink& sink)
+{
+    if(_state != SCHC_GW_BENCH_WAITING)
+        return;
+    if(static_cast<int>(_ack_reqs) >= _max_ack_req)
+    {
+        _state = SCHC_GW_BENCH_FAILED;
+        return;
+    }
+
+    send_ack_req(sink, _ack_mode == ACK_MODE_ACK_END_WIN ? _window : _last_window);
+    _ack_reqs++;
+    _total_ack_reqs++;
+    _burst++;
+}
+
+void SCHC_GW_Bench_Sender::send_window(SCHC_GW_Bench_Uplink_Sink& sink, int w)
+{
+    std::vector<int> tiles;
+    for(int t = w*SCHC_GW_BENCH_WINDOW_SIZE; t < _n_tiles && t < (w + 1)*SCHC_GW_BENCH_WINDOW_SIZE; t++)
+        tiles.push_back(t);
+
+    _window = w;
+    send_tiles(sink, tiles, w == _last_window);
+    wait_ack();
+}
+
+void SCHC_GW_Bench_Sender::send_tiles(SCHC_GW_Bench_Uplink_Sink& sink, const std::vector<int>& tiles, bool all1)
+{
+    /* Tiles consecutivos de una misma ventana van en el mismo fragmento */
+    char    msg[1 + SCHC_GW_BENCH_TILE_SIZE * SCHC_GW_BENCH_WINDOW_SIZE];
+    size_t  i = 0;
+    while(i < tiles.size())
+    {
+        int first   = tiles[i];
+        int w       = first / SCHC_GW_BENCH_WINDOW_SIZE;
+        int fcn     = (SCHC_GW_BENCH_WINDOW_SIZE - 1) - first % SCHC_GW_BENCH_WINDOW_SIZE;
+        int len     = 1;
+        msg[0]      = static_cast<char>((w << 6) | fcn);
+
+        size_t j = i;
+        while(j < tiles.size() && static_cast<int>(j - i) < _tiles_per_fragment && tiles[j] == first + static_cast<int>(j - i) && tiles[j] / SCHC_GW_BENCH_WINDOW_SIZE == w)
+        {
+            get_packet_bytes(tiles[j]*SCHC_GW_BENCH_TILE_SIZE, SCHC_GW_BENCH_TILE_SIZE, msg + len);
+            len = len + SCHC_GW_BENCH_TILE_SIZE;
+            j++;
+        }
+        sink.send_uplink(*this, msg, len);
+        i = j;
+    }
+
+    if(all1)
+        send_all1(sink);
+}
+
+void SCHC_GW_Bench_Sender::send_all1(SCHC_GW_Bench_Uplink_Sink& sink)
+{
+    /* header (W, FCN=63), RCS de 4 bytes y el ultimo tile */
+    char msg[1 + 4 + SCHC_GW_BENCH_TILE_SIZE];
+    msg[0] = static_cast<char>((_last_window << 6) | 63);
+    msg[1] = static_cast<char>(_rcs >> 24);
+    msg[2] = static_cast<char>(_rcs >> 16);
+    msg[3] = static_cast<char>(_rcs >> 8);
+    msg[4] = static_cast<char>(_rcs);
+    get_packet_bytes(_n_tiles*SCHC_GW_BENCH_TILE_SIZE, _last_tile_len, msg + 5);
+    sink.send_uplink(*this, msg, 5 + _last_tile_len);
+}
+
+void SCHC_GW_Bench_Sender::send_ack_req(SCHC_GW_Bench_Uplink_Sink& sink, int w)
+{
+    char msg[1];
+    msg[0] = static_cast<char>(w << 6);
+    sink.send_uplink(*this, msg, 1);
+}
+
+void SCHC_GW_Bench_Sender::add_missing_tiles(int w, uint64_t bitmap, std::vector<int>& tiles, bool& all1)
+{
+    for(int i=0; i<SCHC_GW_BENCH_WINDOW_SIZE; i++)
+    {
+        if((bitmap >> (63 - i)) & 1)
+            continue;
+
+        int t = w*SCHC_GW_BENCH_WINDOW_SIZE + i;
+        if(t < _n_tiles)
+            tiles.push_back(t);
+        else if(w == _last_window && i == SCHC_GW_BENCH_WINDOW_SIZE - 1)
+            all1 = true;        // el ultimo bit de la ultima ventana es el All-1
+    }
+}
+
+void SCHC_GW_Bench_Sender::get_packet_bytes(int offset, int len, char* out)
+{
+    /* Paquete reproducible: el bloque de 8 bytes b del dispositivo d es splitmix64(d << 32 | b) */
+    for(int i=0; i<len; i++)
+    {
+        uint64_t z = ((uint64_t(_device) << 32) | uint64_t((offset + i) / 8)) + 0x9E3779B97F4A7C15ull;
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        z = z ^ (z >> 31);
+        out[i] = static_cast<char>(z >> (8 * ((offset + i) % 8)));
+    }
+}
+
+void SCHC_GW_Bench_Sender::wait_ack()
+{
+    _state      = SCHC_GW_BENCH_WAITING;
+    _ack_reqs   = 0;
+    _burst++;
+}
+
+uint32_t SCHC_GW_Bench_Sender::get_device()
+{
+    return _device;
+}
+
+const std::string& SCHC_GW_Bench_Sender::get_device_id()
+{
+    return _dev_id;
+}
+
+uint8_t SCHC_GW_Bench_Sender::get_state()
+{
+    return _state;
+}
+
+uint32_t SCHC_GW_Bench_Sender::get_burst()
+{
+    return _burst;
+}
+
+uint32_t SCHC_GW_Bench_Sender::get_ack_reqs()
+{
+    return _total_ack_reqs;
+}
+
+uint32_t SCHC_GW_Bench_Sender::get_retransmitted_tiles()
+{
+    return _retransmitted_tiles;
+}
+
+int64_t SCHC_GW_Bench_Sender::get_last_uplink_ns()
+{
+    return _last_uplink_ns;
+}
+
+void SCHC_GW_Bench_Sender::set_last_uplink_ns(int64_t ns)
+{
+    _last_uplink_ns = ns;
+}
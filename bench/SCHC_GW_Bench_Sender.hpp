@@ -0,0 +1,82 @@
+#ifndef SCHC_GW_Bench_Sender_hpp
+#define SCHC_GW_Bench_Sender_hpp
+
+#include "SCHC_GW_Macros.hpp"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/* Emisor Ack-on-Error (RFC 9011, rule 20) de un dispositivo virtual de schc_bench. Arma
+los fragmentos regulares (tiles_per_fragment tiles de 10 bytes), el All-1 con el RCS y
+los ACK REQ, y responde a los ACKs del gateway retransmitiendo los tiles que faltan:
+
+    ACK_END_WIN     envia una ventana y espera su ACK antes de la siguiente
+    ACK_END_SES     envia todas las ventanas y el All-1, y espera el ACK
+    COMPOUND_ACK    igual que ACK_END_SES, pero el ACK trae los bitmaps de varias ventanas
+
+Si no llega un ACK antes del timeout el benchmark llama a on_timeout(), que envia un ACK
+REQ. Cuando llega el ACK con C=1 de la ultima ventana se envia un ACK REQ mas, que lleva a
+la sesion del gateway de STATE_RX_END a su fin, y la sesion del emisor termina. */
+
+#define SCHC_GW_BENCH_TILE_SIZE     10
+#define SCHC_GW_BENCH_WINDOW_SIZE   63
+#define SCHC_GW_BENCH_MAX_WINDOWS   4
+#define SCHC_GW_BENCH_MAX_PACKET    (SCHC_GW_BENCH_TILE_SIZE * SCHC_GW_BENCH_WINDOW_SIZE * SCHC_GW_BENCH_MAX_WINDOWS)
+
+#define SCHC_GW_BENCH_SENDING       0
+#define SCHC_GW_BENCH_WAITING       1   // espera un ACK
+#define SCHC_GW_BENCH_DONE          2
+#define SCHC_GW_BENCH_FAILED        3   // se agotaron los ACK REQ
+
+class SCHC_GW_Bench_Sender;
+
+/* Destino de los mensajes SCHC del emisor (el benchmark los envuelve en un uplink de TTN) */
+class SCHC_GW_Bench_Uplink_Sink
+{
+    public:
+        virtual void send_uplink(SCHC_GW_Bench_Sender& sender, const char* msg, int len) = 0;
+};
+
+class SCHC_GW_Bench_Sender
+{
+    public:
+        uint8_t     initialize(uint32_t device, int packet_size, int tiles_per_fragment, uint8_t ack_mode, int max_ack_req);   // 0 si packet_size es valido
+        void        start(SCHC_GW_Bench_Uplink_Sink& sink);
+        void        on_ack(SCHC_GW_Bench_Uplink_Sink& sink, const char* msg, int len);
+        void        on_timeout(SCHC_GW_Bench_Uplink_Sink& sink);
+        uint32_t    get_device();
+        const std::string& get_device_id();
+        uint8_t     get_state();
+        uint32_t    get_burst();                // cambia cada vez que el emisor envia y pasa a esperar un ACK
+        uint32_t    get_ack_reqs();
+        uint32_t    get_retransmitted_tiles();
+        int64_t     get_last_uplink_ns();
+        void        set_last_uplink_ns(int64_t ns);
+    private:
+        void        send_window(SCHC_GW_Bench_Uplink_Sink& sink, int w);
+        void        send_tiles(SCHC_GW_Bench_Uplink_Sink& sink, const std::vector<int>& tiles, bool all1);
+        void        send_all1(SCHC_GW_Bench_Uplink_Sink& sink);
+        void        send_ack_req(SCHC_GW_Bench_Uplink_Sink& sink, int w);
+        void        add_missing_tiles(int w, uint64_t bitmap, std::vector<int>& tiles, bool& all1);
+        void        get_packet_bytes(int offset, int len, char* out);
+        void        wait_ack();
+        uint32_t                _device;
+        std::string             _dev_id;
+        int                     _packet_size;
+        int                     _n_tiles;           // tiles completos, sin el ultimo tile
+        int                     _last_tile_len;     // en bytes
+        int                     _last_window;
+        uint32_t                _rcs;
+        int                     _tiles_per_fragment;
+        uint8_t                 _ack_mode;
+        int                     _max_ack_req;
+        int                     _window         = 0;    // ACK_END_WIN: ventana en curso
+        uint8_t                 _state          = SCHC_GW_BENCH_SENDING;
+        uint32_t                _burst          = 0;
+        uint32_t                _ack_reqs       = 0;    // enviados por timeout en la espera actual
+        uint32_t                _total_ack_reqs = 0;
+        uint32_t                _retransmitted_tiles = 0;
+        int64_t                 _last_uplink_ns = 0;
+};
+
+#endif
\ No newline at end of file
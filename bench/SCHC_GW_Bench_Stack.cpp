@@ -0,0 +1,62 @@
+#include "SCHC_GW_Bench_Stack.hpp"
+#include "SCHC_GW_Device_Table.hpp"
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fmt/format.h>
+
+uint8_t SCHC_GW_Bench_Stack::initialize_stack(void)
+{
+    return 0;
+}
+
+void SCHC_GW_Bench_Stack::stop_stack(void)
+{
+    _cv.notify_all();
+}
+
+uint8_t SCHC_GW_Bench_Stack::send_downlink_frame(uint32_t device, uint8_t ruleID, char* msg, int len)
+{
+    /* El device id (terminado en '\0') lleva el numero del sender simulado */
+    std::string_view dev_id = SCHC_GW_Device_Table::get_device_id(device);
+    if(len > SCHC_ACK_MAX_LEN || dev_id.compare(0, strlen(SCHC_GW_BENCH_DEVICE_PREFIX), SCHC_GW_BENCH_DEVICE_PREFIX) != 0)
+        return 1;
+
+    SCHC_GW_Bench_Downlink downlink;
+    downlink.device     = static_cast<uint32_t>(strtoul(dev_id.data() + strlen(SCHC_GW_BENCH_DEVICE_PREFIX), nullptr, 16));
+    downlink.time_ns    = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    downlink.len        = len;
+    memcpy(downlink.payload, msg, len);
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _mailbox.push_back(downlink);
+    }
+    _downlinks.fetch_add(1, std::memory_order_relaxed);
+    _cv.notify_one();
+    return 0;
+}
+
+int SCHC_GW_Bench_Stack::getMtu(bool consider_Fopt)
+{
+    return 0;
+}
+
+void SCHC_GW_Bench_Stack::take(std::vector<SCHC_GW_Bench_Downlink>& downlinks, int timeout_ms)
+{
+    downlinks.clear();
+    std::unique_lock<std::mutex> lock(_mutex);
+    if(_mailbox.empty() && timeout_ms > 0)
+        _cv.wait_for(lock, std::chrono::milliseconds(timeout_ms));
+    downlinks.swap(_mailbox);
+}
+
+uint64_t SCHC_GW_Bench_Stack::get_downlinks()
+{
+    return _downlinks.load(std::memory_order_relaxed);
+}
+
+std::string SCHC_GW_Bench_Stack::get_device_id(uint32_t device)
+{
+    return fmt::format(SCHC_GW_BENCH_DEVICE_PREFIX "{:08x}", device);
+}
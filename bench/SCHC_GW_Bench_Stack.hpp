@@ -0,0 +1,45 @@
+#ifndef SCHC_GW_Bench_Stack_hpp
+#define SCHC_GW_Bench_Stack_hpp
+
+#include "SCHC_GW_Stack_L2.hpp"
+#include "SCHC_GW_Macros.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/* Stack L2 de schc_bench. En lugar de publicar los downlinks en el broker los deja en
+un buzon que el hilo del benchmark vacia con take(). Cada downlink guarda el indice del
+dispositivo virtual (el device id es "bench-%08x") y la hora en que la maquina de estado
+lo envio, para medir la latencia de los ACKs. */
+
+#define SCHC_GW_BENCH_DEVICE_PREFIX     "bench-"
+
+struct SCHC_GW_Bench_Downlink
+{
+    uint32_t    device;
+    int64_t     time_ns;        // steady_clock
+    int         len;
+    char        payload[SCHC_ACK_MAX_LEN];
+};
+
+class SCHC_GW_Bench_Stack: public SCHC_GW_Stack_L2
+{
+    public:
+        uint8_t     initialize_stack(void);
+        void        stop_stack(void);
+        uint8_t     send_downlink_frame(uint32_t device, uint8_t ruleID, char* msg, int len);
+        int         getMtu(bool consider_Fopt);
+        void        take(std::vector<SCHC_GW_Bench_Downlink>& downlinks, int timeout_ms);   // espera hasta timeout_ms si el buzon esta vacio
+        uint64_t    get_downlinks();
+        static std::string  get_device_id(uint32_t device);
+    private:
+        std::vector<SCHC_GW_Bench_Downlink>     _mailbox;
+        std::mutex                              _mutex;
+        std::condition_variable                 _cv;
+        std::atomic<uint64_t>                   _downlinks{0};
+};
+
+#endif
\ No newline at end of file
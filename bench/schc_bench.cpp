@@ -0,0 +1,762 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#ifndef SPDLOG_ACTIVE_LEVEL
+#define SPDLOG_ACTIVE_LEVEL SPDLOG_LEVEL_TRACE
+#endif
+#include <spdlog/spdlog.h>
+#include <spdlog/sinks/stdout_color_sinks.h>
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <queue>
+#include <random>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "SCHC_GW_Fragmenter.hpp"
+#include "SCHC_GW_Association_Map.hpp"
+#include "SCHC_GW_Base64.hpp"
+#include "SCHC_GW_CRC32.hpp"
+#include "SCHC_GW_Device_Table.hpp"
+#include "SCHC_GW_Loss_Pattern.hpp"
+#include "SCHC_GW_TTN_MQTT_Stack.hpp"
+#include "SCHC_GW_TTN_Parser.hpp"
+#include "SCHC_GW_ThreadSafeQueue.hpp"
+#include "SCHC_GW_Bench_Sender.hpp"
+#include "SCHC_GW_Bench_Stack.hpp"
+
+/* schc_bench: benchmark del gateway sin broker.
+
+    ./schc_bench [--devices 10,1000,100000] [--packet 2400] [--tiles 5] [--ack-mode 1]
+                 [--loss none] [--workers 4] [--active 10000] [--ack-timeout-ms 1000]
+                 [--max-ack-req 8] [--grace-ms 1000] [--log-level error]
+    ./schc_bench --micro
+    ./schc_bench --fuzz-base64 1000000
+
+Por cada cantidad de dispositivos de --devices se crea un proceso nuevo con su propio
+SCHC_GW_Fragmenter. N dispositivos virtuales (SCHC_GW_Bench_Sender) envian un paquete de
+--packet bytes con Ack-on-Error; cada mensaje SCHC se envuelve en un uplink de TTN y se
+entrega a SCHC_GW_Fragmenter::listen_messages(), y los ACKs vuelven por un stack L2 falso
+(SCHC_GW_Bench_Stack). Las perdidas las simula el gateway con --loss (mismo formato que
+loss_pattern en config.ini). A lo sumo --active sesiones estan en curso a la vez.
+
+Se informa: fragmentos/s (uplinks entregados a listen_messages), sesiones/s, p50/p99 de la
+latencia del ACK (desde el uplink que lo provoco hasta send_downlink_frame) y la memoria
+residente al terminar (RSS) y el maximo (HWM) del proceso.
+
+--micro mide por separado las piezas del camino de un uplink y de un downlink: CRC32 y
+base64 con cada implementacion soportada, el parser de TTN, el JSON de downlink, la
+tabla de dispositivos (memoria por dispositivo y costo de las busquedas con 1M device ids),
+el mapa de asociacion handle -> session id y la run queue de los workers con 1, 2 y 4
+productores, comparada con la version anterior (std::queue con un mutex).
+
+--fuzz-base64 compara cada implementacion de base64 soportada por la CPU con la escalar
+sobre N entradas aleatorias y termina con 1 en la primera diferencia. */
+
+#define SCHC_GW_BENCH_JSON_MAX_LEN  2048
+#define SCHC_GW_BENCH_START_BATCH   64      // sesiones nuevas por vuelta del loop, para que los ACKs no esperen detras de los arranques
+#define SCHC_GW_BENCH_FUZZ_MAX_LEN  600     // varias vueltas de 64 caracteres de cada implementacion SIMD mas la cola escalar
+#define SCHC_GW_BENCH_FUZZ_GUARD    64      // bytes centinela despues de cada buffer de salida
+#define SCHC_GW_BENCH_FUZZ_SEED     0x5C4C
+
+struct SCHC_GW_Bench_Options
+{
+    std::vector<int>    devices             = {10, 1000, 100000};
+    int                 packet_size         = 2400;
+    int                 tiles_per_fragment  = 5;
+    uint8_t             ack_mode            = ACK_MODE_ACK_END_WIN;
+    std::string         loss                = "none";
+    int                 n_workers           = 4;
+    int                 active              = 10000;   // 0: todas las sesiones a la vez
+    int                 ack_timeout_ms      = 1000;
+    int                 max_ack_req         = 8;
+    int                 grace_period_ms     = 1000;
+    int                 run_timeout_s       = 600;
+    std::string         log_level           = "error";
+    bool                micro               = false;
+    int                 fuzz_base64         = 0;        // iteraciones de --fuzz-base64
+};
+
+static int64_t now_ns()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/* VmRSS y VmHWM de /proc/self/status, en kB */
+static uint64_t get_proc_status_kb(const char* field)
+{
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    size_t field_len = strlen(field);
+    while(std::getline(status, line))
+    {
+        if(line.compare(0, field_len, field) == 0 && line.size() > field_len && line[field_len] == ':')
+            return strtoull(line.c_str() + field_len + 1, nullptr, 10);
+    }
+    return 0;
+}
+
+class SCHC_GW_Bench_Runner: public SCHC_GW_Bench_Uplink_Sink
+{
+    public:
+        uint8_t     run(const SCHC_GW_Bench_Options& options, int n_devices);
+        void        send_uplink(SCHC_GW_Bench_Sender& sender, const char* msg, int len);
+    private:
+        struct Timeout
+        {
+            int64_t     deadline_ns;
+            uint32_t    device;
+            uint32_t    burst;
+        };
+        void        arm(SCHC_GW_Bench_Sender& sender, uint8_t previous_state, uint32_t previous_burst);
+        SCHC_GW_Fragmenter*                     _frag;
+        std::vector<SCHC_GW_Bench_Sender>       _senders;
+        std::deque<Timeout>                     _timeouts;          // el timeout es fijo: los deadlines quedan ordenados
+        int64_t                                 _ack_timeout_ns;
+        int                                     _running    = 0;
+        int                                     _done       = 0;
+        int                                     _failed     = 0;
+        uint64_t                                _uplinks    = 0;
+        uint64_t                                _f_cnt      = 0;
+        fmt::memory_buffer                      _json;
+        char                                    _b64[SCHC_GW_BENCH_JSON_MAX_LEN];
+};
+
+void SCHC_GW_Bench_Runner::send_uplink(SCHC_GW_Bench_Sender& sender, const char* msg, int len)
+{
+    /* Uplink con la forma de los mensajes de TTN v3 */
+    int b64_len = SCHC_GW_Base64::encode(msg, len, _b64);
+    _json.clear();
+    fmt::format_to(std::back_inserter(_json),
+        "{{\"end_device_ids\":{{\"device_id\":\"{}\",\"application_ids\":{{\"application_id\":\"schc-bench\"}},\"dev_eui\":\"70B3D57ED0{:06X}\"}},"
+        "\"received_at\":\"2024-11-05T10:00:00.000000Z\",\"uplink_message\":{{\"session_key_id\":\"AZLq2f8cXhE1vN0wqTgQ4A==\",\"f_port\":{},\"f_cnt\":{},"
+        "\"frm_payload\":\"{}\",\"rx_metadata\":[{{\"gateway_ids\":{{\"gateway_id\":\"schc-bench\"}},\"rssi\":-70,\"snr\":9.5}}],"
+        "\"settings\":{{\"data_rate\":{{\"lora\":{{\"bandwidth\":125000,\"spreading_factor\":7}}}},\"frequency\":\"904300000\"}}}}}}",
+        sender.get_device_id(), sender.get_device() & 0xFFFFFF, SCHC_FRAG_UPDIR_RULE_ID, _f_cnt++, fmt::string_view(_b64, b64_len));
+    _json.push_back('\0');
+
+    sender.set_last_uplink_ns(now_ns());
+    _frag->listen_messages(_json.data());
+    _uplinks++;
+}
+
+void SCHC_GW_Bench_Runner::arm(SCHC_GW_Bench_Sender& sender, uint8_t previous_state, uint32_t previous_burst)
+{
+    /* Despues de start(), on_ack() u on_timeout(): termino la sesion o se espera un nuevo ACK */
+    uint8_t state = sender.get_state();
+    if(state != previous_state && (state == SCHC_GW_BENCH_DONE || state == SCHC_GW_BENCH_FAILED))
+    {
+        _running--;
+        if(state == SCHC_GW_BENCH_DONE)
+            _done++;
+        else
+            _failed++;
+        return;
+    }
+    if(state == SCHC_GW_BENCH_WAITING && sender.get_burst() != previous_burst)
+        _timeouts.push_back({now_ns() + _ack_timeout_ns, sender.get_device(), sender.get_burst()});
+}
+
+uint8_t SCHC_GW_Bench_Runner::run(const SCHC_GW_Bench_Options& options, int n_devices)
+{
+    SCHC_GW_Loss_Pattern loss_pattern;
+    if(SCHC_GW_Loss_Pattern::parse(options.loss, loss_pattern) != 0)
+    {
+        SPDLOG_ERROR("Invalid loss pattern: {}", options.loss);
+        return 1;
+    }
+
+    _senders.resize(n_devices);
+    for(int i=0; i<n_devices; i++)
+    {
+        if(_senders[i].initialize(i, options.packet_size, options.tiles_per_fragment, options.ack_mode, options.max_ack_req) != 0)
+        {
+            SPDLOG_ERROR("Invalid packet size {} (1 to {} bytes) or tiles per fragment {}", options.packet_size, SCHC_GW_BENCH_MAX_PACKET, options.tiles_per_fragment);
+            return 1;
+        }
+    }
+    _ack_timeout_ns = int64_t(options.ack_timeout_ms) * 1000000;
+
+    /* El stack se destruye despues del fragmenter: los workers lo usan hasta el final */
+    SCHC_GW_Bench_Stack stack;
+    SCHC_GW_Fragmenter  frag;
+    _frag = &frag;
+    frag.set_stack(&stack);
+    int max_sessions = std::max(n_devices, SCHC_GW_BENCH_START_BATCH);
+    frag.initialize(SCHC_FRAG_LORAWAN, options.ack_mode, loss_pattern, options.n_workers, max_sessions, 0, options.grace_period_ms);
+
+    std::vector<int64_t>                    ack_latency_ns;     // muestras exactas: los buckets de SCHC_GW_Latency_Histogram son potencias de 2
+    std::vector<SCHC_GW_Bench_Downlink>     downlinks;
+    int                                     next_device = 0;
+    int64_t                                 start_ns    = now_ns();
+    int64_t                                 end_ns      = start_ns + int64_t(options.run_timeout_s) * 1000000000;
+
+    while(_done + _failed < n_devices && now_ns() < end_ns)
+    {
+        /* Arranque de nuevas sesiones */
+        for(int i=0; i<SCHC_GW_BENCH_START_BATCH && next_device < n_devices && (options.active == 0 || _running < options.active); i++)
+        {
+            SCHC_GW_Bench_Sender& sender = _senders[next_device++];
+            uint8_t state = sender.get_state();
+            uint32_t burst = sender.get_burst();
+            _running++;
+            sender.start(*this);
+            arm(sender, state, burst);
+        }
+
+        /* ACKs del gateway */
+        bool idle = next_device == n_devices || (options.active != 0 && _running >= options.active);
+        stack.take(downlinks, idle ? 1 : 0);
+        for(SCHC_GW_Bench_Downlink& downlink : downlinks)
+        {
+            if(downlink.device >= static_cast<uint32_t>(n_devices))
+                continue;
+            SCHC_GW_Bench_Sender& sender = _senders[downlink.device];
+            uint8_t state = sender.get_state();
+            uint32_t burst = sender.get_burst();
+            if(state == SCHC_GW_BENCH_WAITING && downlink.time_ns > sender.get_last_uplink_ns())
+                ack_latency_ns.push_back(downlink.time_ns - sender.get_last_uplink_ns());
+            sender.on_ack(*this, downlink.payload, downlink.len);
+            arm(sender, state, burst);
+        }
+
+        /* ACK REQ de los emisores que no recibieron su ACK a tiempo */
+        int64_t now = now_ns();
+        while(!_timeouts.empty() && _timeouts.front().deadline_ns <= now)
+        {
+            Timeout timeout = _timeouts.front();
+            _timeouts.pop_front();
+            SCHC_GW_Bench_Sender& sender = _senders[timeout.device];
+            if(sender.get_state() != SCHC_GW_BENCH_WAITING || sender.get_burst() != timeout.burst)
+                continue;
+            uint8_t state = sender.get_state();
+            uint32_t burst = sender.get_burst();
+            sender.on_timeout(*this);
+            arm(sender, state, burst);
+        }
+    }
+    double elapsed_s = (now_ns() - start_ns) / 1e9;
+
+    /* Memoria antes de destruir el gateway */
+    uint64_t rss_kb = get_proc_status_kb("VmRSS");
+    uint64_t hwm_kb = get_proc_status_kb("VmHWM");
+
+    uint64_t ack_reqs = 0;
+    uint64_t retransmitted_tiles = 0;
+    for(SCHC_GW_Bench_Sender& sender : _senders)
+    {
+        ack_reqs            = ack_reqs + sender.get_ack_reqs();
+        retransmitted_tiles = retransmitted_tiles + sender.get_retransmitted_tiles();
+    }
+
+    std::sort(ack_latency_ns.begin(), ack_latency_ns.end());
+    auto percentile_us = [&](double p) { return ack_latency_ns.empty() ? 0.0 : ack_latency_ns[static_cast<size_t>(p * (ack_latency_ns.size() - 1))] / 1e3; };
+
+    fmt::print("{:>8} {:>8} {:>6} {:>9.3f} {:>12.0f} {:>10.1f} {:>9} {:>9} {:>9} {:>10.1f} {:>10.1f} {:>9.1f} {:>9.1f}\n",
+        n_devices, _done, _failed, elapsed_s,
+        _uplinks / elapsed_s, _done / elapsed_s,
+        stack.get_downlinks(), ack_reqs, retransmitted_tiles,
+        percentile_us(0.50), percentile_us(0.99),
+        rss_kb / 1024.0, hwm_kb / 1024.0);
+    fflush(stdout);
+
+    frag.stop();
+    return _failed == 0 && _done == n_devices ? 0 : 1;
+}
+
+/* ---------------------------------------------------------------------------------- */
+/* Micro benchmarks                                                                    */
+/* ---------------------------------------------------------------------------------- */
+
+static volatile uint64_t bench_sink;    // evita que el compilador elimine el trabajo medido
+
+template<typename Function>
+static void measure(const std::string& name, int iterations, int bytes, Function function)
+{
+    for(int i=0; i<iterations/10; i++)
+        function(i);            // calentamiento
+
+    int64_t start = now_ns();
+    for(int i=0; i<iterations; i++)
+        function(i);
+    double ns = double(now_ns() - start) / iterations;
+
+    if(bytes > 0)
+        fmt::print("{:<40} {:>10.1f} ns/op {:>10.1f} MB/s\n", name, ns, bytes / ns * 1e3);
+    else
+        fmt::print("{:<40} {:>10.1f} ns/op\n", name, ns);
+    fflush(stdout);
+}
+
+/* Version anterior de SCHC_GW_ThreadSafeQueue (std::queue protegida por un mutex), como referencia */
+class SCHC_GW_Bench_Locked_Queue
+{
+    public:
+        typedef SCHC_GW_ThreadSafeQueue::machine_ptr    machine_ptr;
+        typedef std::queue<SCHC_GW_ThreadSafeQueue::entry_t>    batch_t;
+        bool push(machine_ptr machine, SCHC_GW_Fragment&& frag)
+        {
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                _queue.emplace(std::move(machine), std::move(frag), std::chrono::steady_clock::now());
+            }
+            _cond.notify_one();
+            return true;
+        }
+        bool wait_and_pop_all(batch_t& batch)
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _cond.wait(lock, [this]{ return !_queue.empty(); });
+            std::swap(_queue, batch);
+            return !batch.empty();
+        }
+    private:
+        batch_t                 _queue;
+        std::mutex              _mutex;
+        std::condition_variable _cond;
+};
+
+/* Version anterior de la asociacion (unordered_map por device id con un solo mutex), como referencia */
+class SCHC_GW_Bench_Locked_Map
+{
+    public:
+        int find(const std::string& device)
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            auto it = _map.find(device);
+            return it == _map.end() ? -1 : it->second;
+        }
+        bool insert(const std::string& device, int session_id)
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            return _map.insert({device, session_id}).second;
+        }
+    private:
+        std::unordered_map<std::string, int>    _map;
+        std::mutex                              _mutex;
+};
+
+/* n_threads hilos ejecutan function al mismo tiempo. Se reporta el tiempo total dividido por las operaciones de todos los hilos */
+template<typename Function>
+static void measure_concurrent(const std::string& name, int n_threads, int iterations, Function function)
+{
+    std::atomic<bool>           go{false};
+    std::vector<std::thread>    threads;
+    int                         per_thread = iterations / n_threads;
+    for(int t=0; t<n_threads; t++)
+    {
+        threads.emplace_back([&, t]()
+        {
+            while(!go.load())
+                std::this_thread::yield();
+            uint64_t sum = 0;
+            for(int i=0; i<per_thread; i++)
+                sum = sum + function(t * per_thread + i);
+            bench_sink = sum;
+        });
+    }
+
+    int64_t start = now_ns();
+    go.store(true);
+    for(auto& thread : threads)
+        thread.join();
+    double ns = double(now_ns() - start) / (size_t(per_thread) * n_threads);
+
+    fmt::print("{:<40} {:>10.1f} ns/op\n", name, ns);
+    fflush(stdout);
+}
+
+static size_t drain_batch(SCHC_GW_Bench_Locked_Queue::batch_t& batch)
+{
+    size_t n = batch.size();
+    while(!batch.empty())
+        batch.pop();
+    return n;
+}
+
+static size_t drain_batch(SCHC_GW_ThreadSafeQueue::batch_t& batch)
+{
+    size_t n = batch.size();
+    batch.clear();
+    return n;
+}
+
+/* n_producers hilos encolan messages mensajes en total y el hilo actual los extrae por lotes, como un worker */
+template<typename Queue>
+static void measure_queue(const std::string& name, int n_producers, int messages)
+{
+    Queue                       queue;
+    typename Queue::batch_t     batch;
+    std::atomic<bool>           go{false};
+    std::vector<std::thread>    producers;
+    int                         per_producer = messages / n_producers;
+    for(int p=0; p<n_producers; p++)
+    {
+        producers.emplace_back([&]()
+        {
+            while(!go.load())
+                std::this_thread::yield();
+            for(int i=0; i<per_producer; i++)
+            {
+                /* Regular fragment con 5 tiles */
+                SCHC_GW_Fragment frag;
+                memset(frag.allocate(51), 0, 51);
+                frag.set_size(51);
+                frag.set_rule_id(SCHC_FRAG_UPDIR_RULE_ID);
+                queue.push(nullptr, std::move(frag));
+            }
+        });
+    }
+
+    int64_t start = now_ns();
+    go.store(true);
+    size_t received = 0;
+    size_t total    = size_t(per_producer) * n_producers;
+    while(received < total)
+    {
+        if(queue.wait_and_pop_all(batch))
+            received = received + drain_batch(batch);
+    }
+    double ns = double(now_ns() - start) / total;
+    for(auto& producer : producers)
+        producer.join();
+
+    fmt::print("{:<40} {:>10.1f} ns/op\n", name, ns);
+    fflush(stdout);
+}
+
+static void run_micro()
+{
+    fmt::print("CPU implementations in use: crc32={} base64={}\n",
+        SCHC_GW_CRC32::get_impl_name(SCHC_GW_CRC32::get_impl()), SCHC_GW_Base64::get_impl_name(SCHC_GW_Base64::get_impl()));
+
+    /* RCS de un paquete de 4 ventanas */
+    std::vector<char> packet(SCHC_GW_BENCH_MAX_PACKET);
+    for(size_t i=0; i<packet.size(); i++)
+        packet[i] = static_cast<char>(i * 131 + 7);
+    for(uint8_t impl=0; impl<SCHC_CRC32_N_IMPL; impl++)
+    {
+        if(!SCHC_GW_CRC32::is_supported(impl))
+            continue;
+        measure(fmt::format("crc32 {} ({} B)", SCHC_GW_CRC32::get_impl_name(impl), packet.size()), impl == SCHC_CRC32_BITWISE ? 2000 : 200000, packet.size(), [&](int)
+        {
+            bench_sink = SCHC_GW_CRC32::update_with(impl, SCHC_GW_CRC32::init(), packet.data(), packet.size());
+        });
+    }
+
+    /* frm_payload maximo de LoRaWAN */
+    char payload[SCHC_GW_DOWNLINK_MAX_LEN];
+    char encoded[SCHC_GW_BENCH_JSON_MAX_LEN];
+    char decoded[SCHC_GW_FRAGMENT_INLINE_SIZE];
+    memcpy(payload, packet.data(), sizeof(payload));
+    int encoded_len = SCHC_GW_Base64::encode(payload, sizeof(payload), encoded);
+    for(uint8_t impl=0; impl<SCHC_BASE64_N_IMPL; impl++)
+    {
+        if(!SCHC_GW_Base64::is_supported(impl))
+            continue;
+        measure(fmt::format("base64 encode {} ({} B)", SCHC_GW_Base64::get_impl_name(impl), sizeof(payload)), 1000000, sizeof(payload), [&](int)
+        {
+            bench_sink = SCHC_GW_Base64::encode_with(impl, payload, sizeof(payload), encoded);
+        });
+        measure(fmt::format("base64 decode {} ({} B)", SCHC_GW_Base64::get_impl_name(impl), sizeof(payload)), 1000000, sizeof(payload), [&](int)
+        {
+            int len;
+            SCHC_GW_Base64::decode_with(impl, encoded, encoded_len, decoded, sizeof(decoded), len);
+            bench_sink = len;
+        });
+    }
+
+    /* Uplink de TTN con un fragmento regular de 5 tiles */
+    SCHC_GW_Bench_Sender sender;
+    sender.initialize(0, 2400, 5, ACK_MODE_ACK_END_WIN, 0);
+    int b64_len = SCHC_GW_Base64::encode(payload, 51, encoded);
+    std::string uplink = fmt::format(
+        "{{\"end_device_ids\":{{\"device_id\":\"{}\",\"application_ids\":{{\"application_id\":\"schc-bench\"}},\"dev_eui\":\"70B3D57ED0000000\"}},"
+        "\"received_at\":\"2024-11-05T10:00:00.000000Z\",\"uplink_message\":{{\"session_key_id\":\"AZLq2f8cXhE1vN0wqTgQ4A==\",\"f_port\":{},\"f_cnt\":1,"
+        "\"frm_payload\":\"{}\",\"rx_metadata\":[{{\"gateway_ids\":{{\"gateway_id\":\"schc-bench\"}},\"rssi\":-70,\"snr\":9.5}}],"
+        "\"settings\":{{\"data_rate\":{{\"lora\":{{\"bandwidth\":125000,\"spreading_factor\":7}}}},\"frequency\":\"904300000\"}}}}}}",
+        sender.get_device_id(), SCHC_FRAG_UPDIR_RULE_ID, fmt::string_view(encoded, b64_len));
+    std::vector<char> uplink_buffer(uplink.begin(), uplink.end());
+    uplink_buffer.push_back('\0');
+    measure(fmt::format("ttn parser ({} B json)", uplink.size()), 1000000, uplink.size(), [&](int)
+    {
+        SCHC_GW_TTN_Parser parser;
+        bench_sink = parser.initialize_parser(uplink_buffer.data());
+    });
+
+    /* Downlink con un ACK de 9 bytes */
+    char json[SCHC_GW_DOWNLINK_JSON_MAX_LEN];
+    measure("downlink json (9 B ACK)", 1000000, 0, [&](int)
+    {
+        bench_sink = SCHC_GW_TTN_MQTT_Stack::format_downlink_json(SCHC_FRAG_UPDIR_RULE_ID, payload, 9, json);
+    });
+
+    /* device id -> handle -> session id con 1M dispositivos */
+    const int n_ids = 1000000;
+    std::vector<std::string>    ids(n_ids);
+    std::vector<uint32_t>       devices(n_ids);
+    for(int i=0; i<n_ids; i++)
+        ids[i] = SCHC_GW_Bench_Stack::get_device_id(i);
+    size_t  table_bytes = SCHC_GW_Device_Table::get_memory_usage();
+    size_t  table_size  = SCHC_GW_Device_Table::size();
+    uint64_t rss_kb     = get_proc_status_kb("VmRSS");
+    int64_t start       = now_ns();
+    for(int i=0; i<n_ids; i++)
+        devices[i] = SCHC_GW_Device_Table::intern(ids[i].data(), ids[i].size());
+    fmt::print("{:<40} {:>10.1f} ns/op\n", "device table insert (1M ids)", double(now_ns() - start) / n_ids);
+    fmt::print("{:<40} {:>10.1f} B/device {:>7.1f} B/device rss\n", "device table memory (1M ids)",
+        double(SCHC_GW_Device_Table::get_memory_usage() - table_bytes) / (SCHC_GW_Device_Table::size() - table_size),
+        double(get_proc_status_kb("VmRSS") - rss_kb) * 1024 / n_ids);
+    measure("device table hash", 1000000, 0, [&](int i)
+    {
+        const std::string& id = ids[(uint64_t(i) * 7919) % n_ids];
+        bench_sink = SCHC_GW_Device_Table::hash_device_id(id.data(), id.size());
+    });
+    measure("device table intern (1M ids)", 1000000, 0, [&](int i)
+    {
+        const std::string& id = ids[(uint64_t(i) * 7919) % n_ids];
+        bench_sink = SCHC_GW_Device_Table::intern(id.data(), id.size());
+    });
+    measure("device table get_device_id (1M ids)", 1000000, 0, [&](int i)
+    {
+        bench_sink = SCHC_GW_Device_Table::get_device_id(devices[(uint64_t(i) * 7919) % n_ids]).size();
+    });
+
+    SCHC_GW_Bench_Locked_Map locked_map;
+    SCHC_GW_Association_Map map;
+    for(int i=0; i<n_ids; i++)
+    {
+        locked_map.insert(ids[i], i);
+        map.insert(devices[i], i);
+    }
+    for(int n_threads : {1, 2, 4})
+    {
+        measure_concurrent(fmt::format("association map mutex ({} threads)", n_threads), n_threads, 1000000, [&](int i)
+        {
+            return locked_map.find(ids[(uint64_t(i) * 7919) % n_ids]);
+        });
+        measure_concurrent(fmt::format("association map sharded ({} threads)", n_threads), n_threads, 1000000, [&](int i)
+        {
+            return map.find(devices[(uint64_t(i) * 7919) % n_ids]);
+        });
+    }
+
+    /* Run queue de un worker: varios hilos de despacho y un worker */
+    for(int n_producers : {1, 2, 4})
+    {
+        measure_queue<SCHC_GW_Bench_Locked_Queue>(fmt::format("worker queue mutex ({} producers)", n_producers), n_producers, 1000000);
+        measure_queue<SCHC_GW_ThreadSafeQueue>(fmt::format("worker queue ring ({} producers)", n_producers), n_producers, 1000000);
+    }
+}
+
+/* ---------------------------------------------------------------------------------- */
+/* Fuzzing diferencial de base64                                                       */
+/* ---------------------------------------------------------------------------------- */
+
+static bool guard_intact(const char* guard)
+{
+    for(int i=0; i<SCHC_GW_BENCH_FUZZ_GUARD; i++)
+    {
+        if(static_cast<uint8_t>(guard[i]) != 0xA5)
+            return false;
+    }
+    return true;
+}
+
+/* La salida de cada implementacion se compara con la escalar: encode de datos aleatorios y
+decode de esa salida tal cual, sin padding, truncada, con un caracter fuera del alfabeto o
+con un out_cap menor al necesario. Ninguna implementacion debe escribir despues de su buffer */
+static int run_base64_fuzz(int iterations)
+{
+    const char              invalid[]   = "=!-_ .\n\r\t\0@[`{\x7f\x80\xff";
+    std::mt19937_64         rng(SCHC_GW_BENCH_FUZZ_SEED);
+    std::vector<char>       data(SCHC_GW_BENCH_FUZZ_MAX_LEN);
+    std::vector<char>       ref(SCHC_GW_Base64::encoded_len(SCHC_GW_BENCH_FUZZ_MAX_LEN));
+    std::vector<char>       out(ref.size() + SCHC_GW_BENCH_FUZZ_GUARD);
+    std::vector<char>       decoded_ref(SCHC_GW_BENCH_FUZZ_MAX_LEN + 3);
+    std::vector<char>       decoded(decoded_ref.size() + SCHC_GW_BENCH_FUZZ_GUARD);
+    std::string             input;
+
+    std::string impls;
+    for(uint8_t impl=1; impl<SCHC_BASE64_N_IMPL; impl++)
+    {
+        if(SCHC_GW_Base64::is_supported(impl))
+            impls = impls + " " + SCHC_GW_Base64::get_impl_name(impl);
+    }
+    fmt::print("base64 fuzz: {} iterations, seed {:#x}, compared with scalar:{}\n", iterations, SCHC_GW_BENCH_FUZZ_SEED, impls.empty() ? " none" : impls);
+    fflush(stdout);
+
+    for(int it=0; it<iterations; it++)
+    {
+        int len = rng() % (SCHC_GW_BENCH_FUZZ_MAX_LEN + 1);
+        for(int i=0; i<len; i++)
+            data[i] = static_cast<char>(rng());
+        int ref_len = SCHC_GW_Base64::encode_with(SCHC_BASE64_SCALAR, data.data(), len, ref.data());
+
+        /* Entrada del decode */
+        input.assign(ref.data(), ref_len);
+        switch(rng() % 4)
+        {
+            case 1:
+                while(!input.empty() && input.back() == '=')
+                    input.pop_back();
+                break;
+            case 2:
+                input.resize(rng() % (input.size() + 1));
+                break;
+            case 3:
+                if(!input.empty())
+                    input[rng() % input.size()] = invalid[rng() % (sizeof(invalid) - 1)];
+                break;
+        }
+        int out_cap = rng() % 4 == 0 ? int(rng() % (len + 1)) : len + 3;
+        int ref_decoded_len = 0;
+        uint8_t ref_status = SCHC_GW_Base64::decode_with(SCHC_BASE64_SCALAR, input.data(), input.size(), decoded_ref.data(), out_cap, ref_decoded_len);
+
+        for(uint8_t impl=1; impl<SCHC_BASE64_N_IMPL; impl++)
+        {
+            if(!SCHC_GW_Base64::is_supported(impl))
+                continue;
+
+            memset(out.data(), 0xA5, out.size());
+            int out_len = SCHC_GW_Base64::encode_with(impl, data.data(), len, out.data());
+            if(out_len != ref_len || memcmp(out.data(), ref.data(), ref_len) != 0 || !guard_intact(out.data() + ref_len))
+            {
+                fmt::print("base64 fuzz: encode {} differs from scalar at iteration {} ({} B)\n", SCHC_GW_Base64::get_impl_name(impl), it, len);
+                return 1;
+            }
+
+            memset(decoded.data(), 0xA5, decoded.size());
+            int decoded_len = 0;
+            uint8_t status = SCHC_GW_Base64::decode_with(impl, input.data(), input.size(), decoded.data(), out_cap, decoded_len);
+            if(status != ref_status || (status == 0 && (decoded_len != ref_decoded_len || memcmp(decoded.data(), decoded_ref.data(), decoded_len) != 0))
+               || !guard_intact(decoded.data() + out_cap))
+            {
+                fmt::print("base64 fuzz: decode {} differs from scalar at iteration {} ({} chars, out_cap {}): status {} / {}, len {} / {}\n",
+                    SCHC_GW_Base64::get_impl_name(impl), it, input.size(), out_cap, status, ref_status, decoded_len, ref_decoded_len);
+                return 1;
+            }
+        }
+    }
+
+    fmt::print("base64 fuzz: no differences\n");
+    return 0;
+}
+
+/* ---------------------------------------------------------------------------------- */
+
+static uint8_t parse_options(int argc, char** argv, SCHC_GW_Bench_Options& options)
+{
+    for(int i=1; i<argc; i++)
+    {
+        std::string option = argv[i];
+        if(option == "--micro")
+        {
+            options.micro = true;
+            continue;
+        }
+        if(i + 1 >= argc)
+            return 1;
+        std::string value = argv[++i];
+
+        if(option == "--devices")
+        {
+            options.devices.clear();
+            size_t pos = 0;
+            while(pos < value.size())
+            {
+                size_t comma = value.find(',', pos);
+                if(comma == std::string::npos)
+                    comma = value.size();
+                options.devices.push_back(std::stoi(value.substr(pos, comma - pos)));
+                pos = comma + 1;
+            }
+        }
+        else if(option == "--packet")           options.packet_size         = std::stoi(value);
+        else if(option == "--tiles")            options.tiles_per_fragment  = std::stoi(value);
+        else if(option == "--ack-mode")         options.ack_mode            = std::stoi(value);
+        else if(option == "--loss")             options.loss                = value;
+        else if(option == "--workers")          options.n_workers           = std::stoi(value);
+        else if(option == "--active")           options.active              = std::stoi(value);
+        else if(option == "--ack-timeout-ms")   options.ack_timeout_ms      = std::stoi(value);
+        else if(option == "--max-ack-req")      options.max_ack_req         = std::stoi(value);
+        else if(option == "--grace-ms")         options.grace_period_ms     = std::stoi(value);
+        else if(option == "--timeout-s")        options.run_timeout_s       = std::stoi(value);
+        else if(option == "--log-level")        options.log_level           = value;
+        else if(option == "--fuzz-base64")      options.fuzz_base64         = std::stoi(value);
+        else
+            return 1;
+    }
+    if(options.ack_mode < ACK_MODE_ACK_END_WIN || options.ack_mode > ACK_MODE_COMPOUND_ACK)
+        return 1;
+    return 0;
+}
+
+int main(int argc, char** argv)
+{
+    SCHC_GW_Bench_Options options;
+    if(parse_options(argc, argv, options) != 0)
+    {
+        fmt::print(stderr, "Usage: {} [--devices 10,1000,100000] [--packet 2400] [--tiles 5] [--ack-mode 1|2|3] [--loss none]\n"
+                           "       [--workers 4] [--active 10000] [--ack-timeout-ms 1000] [--max-ack-req 8] [--grace-ms 1000]\n"
+                           "       [--timeout-s 600] [--log-level error]\n"
+                           "       {} --micro\n"
+                           "       {} --fuzz-base64 1000000\n", argv[0], argv[0], argv[0]);
+        return 1;
+    }
+
+    if(options.micro)
+    {
+        run_micro();
+        return 0;
+    }
+    if(options.fuzz_base64 > 0)
+    {
+        return run_base64_fuzz(options.fuzz_base64);
+    }
+
+    fmt::print("packet={} B, tiles/fragment={}, ack mode={}, loss={}, workers={}, active={}, ack timeout={} ms\n",
+        options.packet_size, options.tiles_per_fragment, options.ack_mode, options.loss, options.n_workers, options.active, options.ack_timeout_ms);
+    fmt::print("{:>8} {:>8} {:>6} {:>9} {:>12} {:>10} {:>9} {:>9} {:>9} {:>10} {:>10} {:>9} {:>9}\n",
+        "devices", "done", "failed", "time(s)", "fragments/s", "sessions/s", "acks", "ack_reqs", "retx_tile", "p50(us)", "p99(us)", "rss(MB)", "hwm(MB)");
+    fflush(stdout);
+
+    /* Un proceso por escala: el RSS y el HWM de cada fila no dependen de las anteriores */
+    int result = 0;
+    for(int n_devices : options.devices)
+    {
+        pid_t pid = fork();
+        if(pid < 0)
+        {
+            perror("fork");
+            return 1;
+        }
+        if(pid == 0)
+        {
+            auto console_logger = spdlog::stdout_color_mt("console");
+            spdlog::set_default_logger(console_logger);
+            spdlog::set_pattern("[%H:%M:%S.%e][%^%L%$][%t][%-8!s][%-8!!] %v");
+            spdlog::set_level(spdlog::level::from_str(options.log_level));
+
+            SCHC_GW_Bench_Runner runner;
+            _exit(runner.run(options, n_devices));
+        }
+
+        int status = 0;
+        waitpid(pid, &status, 0);
+        if(!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+            result = 1;
+    }
+    return result;
+}
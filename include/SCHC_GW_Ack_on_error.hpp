@@ -4,9 +4,13 @@
 #include "SCHC_GW_Macros.hpp"
 #include "SCHC_GW_State_Machine.hpp"
 #include "SCHC_GW_Message.hpp"
-#include "SCHC_GW_ThreadSafeQueue.hpp"
+#include "SCHC_GW_CRC32.hpp"
+#include "SCHC_GW_Trace.hpp"
+#include "SCHC_GW_Metrics.hpp"
 
+#ifndef SPDLOG_ACTIVE_LEVEL
 #define SPDLOG_ACTIVE_LEVEL SPDLOG_LEVEL_TRACE
+#endif
 #include <spdlog/spdlog.h>
 #include <spdlog/sinks/stdout_color_sinks.h>
 
@@ -14,38 +18,41 @@
 #include <cstdint>
 #include <vector>
 #include <map>
-#include <thread>
 #include <functional>
+#include <atomic>
+#include <cstring>
+#include <new>
 
 using namespace std;
 
-class SCHC_GW_Ack_on_error: public SCHC_GW_State_Machine, public enable_shared_from_this<SCHC_GW_Ack_on_error>
+class SCHC_GW_Ack_on_error: public SCHC_GW_State_Machine
 {
     public:
         SCHC_GW_Ack_on_error();
         ~SCHC_GW_Ack_on_error();
-        uint8_t                 init(string dev_id, uint8_t ruleID, uint8_t dTag, uint8_t windowSize, uint8_t tileSize, uint8_t n, uint8_t m, uint8_t ackMode, SCHC_GW_Stack_L2* stack_ptr, int retTimer, uint8_t ackReqAttempts) override;
+        uint8_t                 init(uint32_t device, uint8_t ruleID, uint8_t dTag, uint8_t windowSize, uint8_t tileSize, uint8_t n, uint8_t m, uint8_t ackMode, SCHC_GW_Stack_L2* stack_ptr, int retTimer, uint8_t ackReqAttempts) override;
         uint8_t                 execute_machine(int rule_id=0, char *msg=NULL, int len=0) override;
-        uint8_t                 queue_message(int rule_id, char* msg, int len) override;
-        void                    message_reception_loop() override;
         bool                    is_processing() override;
         void                    set_end_callback(function<void()> callback) override;
-        void                    set_error_prob(uint8_t error_prob) override;
+        void                    set_loss_pattern(const SCHC_GW_Loss_Pattern& loss_pattern, uint64_t seed) override;
     private: 
         uint8_t                 RX_INIT_recv_fragments(int rule_id, char *msg, int len);
         uint8_t                 RX_RCV_WIN_recv_fragments(int rule_id, char *msg, int len);
         uint8_t                 RX_END_end_session(int rule_id = 0, char *msg=nullptr, int len=0);
         uint8_t                 RX_WAIT_x_MISSING_FRAGS_recv_fragments(int rule_id, char *msg, int len);
-        string                  get_bitmap_array_str(uint8_t window);
-        vector<uint8_t>         get_bitmap_array_vec(uint8_t window);
+        SCHC_GW_Bitmap          get_bitmap(uint8_t window);
         uint8_t                 get_c_from_bitmap(uint8_t window);
+        void                    set_bitmap_bit(uint8_t window, int pos);
+        bool                    get_bitmap_bit(uint8_t window, int pos);
         bool                    check_rcs(uint32_t rcs);
-        uint32_t                calculate_crc32(const char *data, size_t length);
+        bool                    end_session_if_complete(uint8_t dtag);
+        void                    update_rcs_prefix();
         int                     get_tile_ptr(uint8_t window, uint8_t fcn);
         int                     get_bitmap_ptr(uint8_t fcn);
         void                    print_tail_array_hex();
         void                    print_bitmap_array_str();
-        static void             thread_entry_point(shared_ptr<SCHC_GW_Ack_on_error> instance);
+        char*                   get_tile(int tile);
+        void                    free_reassembly();
         
         
         /* Static SCHC parameters */
@@ -59,37 +66,35 @@ class SCHC_GW_Ack_on_error: public SCHC_GW_State_Machine, public enable_shared_f
         uint8_t         _ackMode;       // Modes defined in SCHC_GW_Macros.hpp
         uint32_t        _retransTimer;
         uint8_t         _maxAckReq;
-        string          _dev_id;
+        uint32_t        _device;        // handle de SCHC_GW_Device_Table
+        char*           _reassembly = nullptr;  // arena contigua de la sesion: bitmaps, tiles y ultimo tile
         char*           _last_tile;     // almacena el ultimo tile
-        char**          _tilesArray;
-        uint8_t**       _bitmapArray;
+        char*           _tilesArray;    // _nTotalTiles tiles contiguos. El tile i esta en _tilesArray + i*_tileSize
+        uint64_t*       _bitmapArray;   // un bitmap de 64 bits por ventana. El tile i de la ventana w es el bit (63 - i) de _bitmapArray[w]
         int             _last_window;   // almacena el numero de la ultima ventana
         uint32_t        _rcs;
-        uint8_t         _error_prob;
+        SCHC_GW_Loss_Pattern    _loss_pattern;  // perdidas simuladas de fragmentos regulares
 
 
         /* Dynamic SCHC parameters */
         uint8_t         _currentState;
         int             _currentTile_ptr;
+        uint32_t        _rcs_prefix_crc;        // CRC parcial (sin finalizar) de los tiles [0, _rcs_prefix_tiles)
+        int             _rcs_prefix_tiles;      // largo del prefijo contiguo de tiles recibidos incluido en el CRC
         uint8_t         _last_confirmed_window;
 
         /* Static LoRaWAN parameters*/
         int                 _current_L2_MTU;
         SCHC_GW_Stack_L2*   _stack;
 
-        /* Thread and Queue Message*/
-        SCHC_GW_ThreadSafeQueue    _queue;
-        atomic<bool>       _processing;            // atomic flag for the thread
-        string             _name;                  // thread name
-        thread             _process_thread;        // thread
+        /* Session end */
+        atomic<bool>       _processing;            // "false" cuando la sesion termina. El worker descarta los mensajes pendientes
         function<void()>   _end_callback;
 
         /* Flags */
         bool                    _wait_pull_ack_req_flag;    // "true": si llega un ACK REQ lo considera un PULL ACK REQ (descarta el ACK REQ y no envía nada). "false": si llega un ACK REQ responde con un ACK.
         bool                    _first_ack_sent_flag;       // "true": si se envió el primer ACK para una ventana.
-        
-        /* Counters */
-        int _counter;       // counter for select the messages that are dropped.
+        bool                    _all1_received_flag;        // "true": se recibió el All-1 y _rcs es válido.
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,18 @@
+#ifndef SCHC_GW_Alloc_Counter_hpp
+#define SCHC_GW_Alloc_Counter_hpp
+
+#include <cstdint>
+
+/* Contador de reservas de memoria en el heap. Solo cuenta cuando se compila con
+SCHC_GW_COUNT_ALLOCS (opcion de CMake del mismo nombre), que reemplaza el operator
+new global. Sin la opcion, is_enabled() retorna false y los contadores quedan en 0. */
+
+class SCHC_GW_Alloc_Counter
+{
+    public:
+        static bool     is_enabled();
+        static uint64_t get_allocs();           // reservas de todos los hilos
+        static uint64_t get_thread_allocs();    // reservas del hilo que llama
+};
+
+#endif
\ No newline at end of file
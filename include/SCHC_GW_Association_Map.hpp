@@ -0,0 +1,36 @@
+#ifndef SCHC_GW_Association_Map_hpp
+#define SCHC_GW_Association_Map_hpp
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
+
+/* Asociacion dispositivo -> session id dividida en SCHC_GW_ASSOCIATION_SHARDS shards.
+Cada shard tiene su propio shared_mutex, por lo que las busquedas (hilo de ingreso)
+solo toman un lock de lectura y no compiten con las escrituras de otros shards.
+La clave es el handle de SCHC_GW_Device_Table: los handles son consecutivos, por lo
+que los bits bajos reparten los dispositivos entre los shards sin calcular un hash. */
+
+#define SCHC_GW_ASSOCIATION_SHARDS 64       // potencia de 2
+
+class SCHC_GW_Association_Map
+{
+    public:
+        int         find(uint32_t device);
+        bool        insert(uint32_t device, int session_id);
+        bool        erase(uint32_t device);
+        bool        erase_if_equal(uint32_t device, int session_id);
+        size_t      size();
+    private:
+        struct alignas(64) Shard
+        {
+            std::shared_mutex                   mutex;
+            std::unordered_map<uint32_t, int>   map;
+        };
+        Shard&      get_shard(uint32_t device);
+        Shard       _shards[SCHC_GW_ASSOCIATION_SHARDS];
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,39 @@
+#ifndef SCHC_GW_Base64_hpp
+#define SCHC_GW_Base64_hpp
+
+#include <cstddef>
+#include <cstdint>
+
+/* Codificador/decodificador base64 (RFC 4648, alfabeto estandar con padding '=')
+usado para el frm_payload de los mensajes de TTN. La salida se escribe en un buffer
+del llamador. Existen varias implementaciones y encode()/decode() usan la mas rapida
+soportada por la CPU, elegida en tiempo de ejecucion:
+    - SCHC_BASE64_SCALAR:   tablas de busqueda, 4 caracteres por iteracion (referencia)
+    - SCHC_BASE64_SSE41:    16 caracteres por iteracion con PSHUFB (x86-64)
+    - SCHC_BASE64_AVX2:     32 caracteres por iteracion (x86-64)
+    - SCHC_BASE64_NEON:     64 caracteres por iteracion con TBL (aarch64)
+El decodificador se detiene en el primer caracter fuera del alfabeto (por ejemplo
+el padding '=') y decodifica los caracteres anteriores. */
+
+#define SCHC_BASE64_SCALAR      0
+#define SCHC_BASE64_SSE41       1
+#define SCHC_BASE64_AVX2        2
+#define SCHC_BASE64_NEON        3
+#define SCHC_BASE64_N_IMPL      4
+
+class SCHC_GW_Base64
+{
+    public:
+        static int          encoded_len(int len);
+        static int          encode(const char* data, int len, char* out);     // out: encoded_len(len) bytes. Retorna el largo escrito
+        static uint8_t      decode(const char* encoded, int len, char* out, int out_cap, int& out_len);    // 0 si la salida cabe en out_cap
+
+        static int          encode_with(uint8_t impl, const char* data, int len, char* out);
+        static uint8_t      decode_with(uint8_t impl, const char* encoded, int len, char* out, int out_cap, int& out_len);
+        static bool         is_supported(uint8_t impl);
+        static uint8_t      get_impl();
+        static uint8_t      set_impl(uint8_t impl);     // 0 si la implementacion esta soportada
+        static const char*  get_impl_name(uint8_t impl);
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,39 @@
+#ifndef SCHC_GW_CRC32_hpp
+#define SCHC_GW_CRC32_hpp
+
+#include <cstddef>
+#include <cstdint>
+
+/* CRC32 (polinomio 0x04C11DB7 reflejado, el mismo de Ethernet/zlib) usado como RCS.
+La API es incremental: crc = init(); crc = update(crc, ...); rcs = finalize(crc).
+Existen varias implementaciones y update() usa la mas rapida soportada por la CPU,
+elegida en tiempo de ejecucion:
+    - SCHC_CRC32_BITWISE:   bit a bit, 8 iteraciones por byte (referencia)
+    - SCHC_CRC32_TABLE:     tabla de 256 entradas, un byte por iteracion
+    - SCHC_CRC32_SLICING8:  slicing-by-8, 8 bytes por iteracion
+    - SCHC_CRC32_PCLMUL:    folding con PCLMULQDQ (x86-64)
+    - SCHC_CRC32_ARMV8:     instrucciones CRC32 de ARMv8 (aarch64) */
+
+#define SCHC_CRC32_BITWISE      0
+#define SCHC_CRC32_TABLE        1
+#define SCHC_CRC32_SLICING8     2
+#define SCHC_CRC32_PCLMUL       3
+#define SCHC_CRC32_ARMV8        4
+#define SCHC_CRC32_N_IMPL       5
+
+class SCHC_GW_CRC32
+{
+    public:
+        static uint32_t     init();
+        static uint32_t     update(uint32_t crc, const char* data, size_t len);
+        static uint32_t     finalize(uint32_t crc);
+        static uint32_t     calculate(const char* data, size_t len);
+
+        static uint32_t     update_with(uint8_t impl, uint32_t crc, const char* data, size_t len);
+        static bool         is_supported(uint8_t impl);
+        static uint8_t      get_impl();
+        static uint8_t      set_impl(uint8_t impl);     // 0 si la implementacion esta soportada
+        static const char*  get_impl_name(uint8_t impl);
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,38 @@
+#ifndef SCHC_GW_Device_Table_hpp
+#define SCHC_GW_Device_Table_hpp
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+/* Tabla de dispositivos del gateway: asigna a cada device id un handle de 32 bits
+(0, 1, 2, ...) la primera vez que el parser lo encuentra. Desde ahi el camino de los
+mensajes (fragmento, sesion, maquina de estado, outbox de downlinks) solo lleva el
+handle; el device id se reconstruye con get_device_id() para el topic y los logs.
+
+Los handles no se reutilizan. Los nombres se copian una sola vez a bloques de
+SCHC_GW_DEVICE_ARENA_CHUNK bytes (largo, caracteres y '\0') y el indice handle ->
+nombre es un arreglo por bloques, por lo que get_device_id() no toma locks.
+La busqueda device id -> handle esta dividida en SCHC_GW_DEVICE_SHARDS shards con
+direccionamiento abierto; cada slot guarda 32 bits del hash y el handle (8 bytes),
+y los shards crecen sin volver a recorrer los nombres. */
+
+#define SCHC_GW_DEVICE_INVALID          0xFFFFFFFF
+#define SCHC_GW_DEVICE_ID_MAX_LEN       64          // TTN: device ids de hasta 36 caracteres
+#define SCHC_GW_DEVICE_SHARDS           64          // potencia de 2
+#define SCHC_GW_DEVICE_BLOCK_SIZE       65536       // handles por bloque del indice handle -> nombre
+#define SCHC_GW_DEVICE_MAX_BLOCKS       4096        // hasta 2^28 dispositivos
+#define SCHC_GW_DEVICE_ARENA_CHUNK      65536       // bytes por bloque de nombres
+
+class SCHC_GW_Device_Table
+{
+    public:
+        static uint64_t         hash_device_id(const char* dev_id, size_t len);
+        static uint32_t         intern(const char* dev_id, size_t len);     // crea el handle si no existe. SCHC_GW_DEVICE_INVALID si el id es vacio o demasiado largo
+        static uint32_t         find(const char* dev_id, size_t len);       // SCHC_GW_DEVICE_INVALID si no existe
+        static std::string_view get_device_id(uint32_t device);             // terminado en '\0'. Valido mientras exista el proceso
+        static size_t           size();
+        static size_t           get_memory_usage();                         // bytes reservados por la tabla
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,53 @@
+#ifndef SCHC_GW_Fragment_hpp
+#define SCHC_GW_Fragment_hpp
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+
+/* Fragmento SCHC recibido: payload decodificado, rule id, dispositivo y instante de
+recepcion. Es el unico dueño del payload y solo se mueve (parser -> sesion -> cola del
+worker -> worker), por lo que el payload se libera en cualquier camino que descarte el
+mensaje.
+
+Los payloads de hasta SCHC_GW_FRAGMENT_INLINE_SIZE bytes (el MTU de LoRaWAN) se guardan
+dentro del objeto: crear, encolar y ejecutar un fragmento no usa el heap. Solo un payload
+mas grande se reserva en el heap. Mover un fragmento copia size() bytes, no el buffer
+completo. */
+
+#define SCHC_GW_FRAGMENT_INLINE_SIZE    256     // LoRaWAN: frm_payload de hasta 242 bytes
+
+class SCHC_GW_Fragment
+{
+    public:
+        typedef std::chrono::steady_clock::time_point   time_point;
+
+        SCHC_GW_Fragment() = default;
+        SCHC_GW_Fragment(SCHC_GW_Fragment&& other) noexcept;
+        SCHC_GW_Fragment& operator=(SCHC_GW_Fragment&& other) noexcept;
+        SCHC_GW_Fragment(const SCHC_GW_Fragment&) = delete;
+        SCHC_GW_Fragment& operator=(const SCHC_GW_Fragment&) = delete;
+
+        char*       allocate(int capacity);     // buffer para escribir hasta capacity bytes. Descarta el payload anterior
+        void        set_size(int len)               { _len = len; }
+        void        set_device(uint32_t device)     { _device = device; }
+        void        set_rule_id(uint8_t rule_id)    { _rule_id = rule_id; }
+        void        set_rx_time(time_point rx_time) { _rx_time = rx_time; }
+        char*       data()                          { return _heap ? _heap.get() : _inline; }
+        const char* data() const                    { return _heap ? _heap.get() : _inline; }
+        int         size() const                    { return _len; }
+        uint32_t    get_device() const              { return _device; }
+        uint8_t     get_rule_id() const             { return _rule_id; }
+        time_point  get_rx_time() const             { return _rx_time; }
+        bool        is_inline() const               { return !_heap; }
+        void        reset();                    // libera el payload
+    private:
+        std::unique_ptr<char[]> _heap;          // solo si el payload no cabe en _inline
+        int                     _len        = 0;
+        uint32_t                _device     = 0;
+        uint8_t                 _rule_id    = 0;
+        time_point              _rx_time;
+        char                    _inline[SCHC_GW_FRAGMENT_INLINE_SIZE];
+};
+
+#endif
\ No newline at end of file
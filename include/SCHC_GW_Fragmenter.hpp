@@ -5,12 +5,19 @@
 #include "SCHC_GW_Stack_L2.hpp"
 #include "SCHC_GW_TTN_MQTT_Stack.hpp"
 #include "SCHC_GW_Session.hpp"
+#include "SCHC_GW_Session_Table.hpp"
+#include "SCHC_GW_Timer_Wheel.hpp"
+#include "SCHC_GW_Association_Map.hpp"
+#include "SCHC_GW_Device_Table.hpp"
+#include "SCHC_GW_Loss_Pattern.hpp"
 #include <cstdint>
+#ifndef SPDLOG_ACTIVE_LEVEL
 #define SPDLOG_ACTIVE_LEVEL SPDLOG_LEVEL_TRACE
+#endif
 #include <spdlog/spdlog.h>
 #include <spdlog/sinks/stdout_color_sinks.h>
 #include <mosquitto.h>
-#include "SCHC_GW_ThreadSafeQueue.hpp"
+#include "SCHC_GW_Worker_Pool.hpp"
 #include "SCHC_GW_TTN_Parser.hpp"
 #include <random>
 
@@ -18,19 +25,27 @@ class SCHC_GW_Fragmenter
 {
     public:
         uint8_t     set_mqtt_stack(mosquitto* mosqStack);
-        uint8_t     initialize(uint8_t protocol, uint8_t ack_mode, uint8_t error_prob = 0);
+        uint8_t     set_stack(SCHC_GW_Stack_L2* stack);     // stack L2 propio en lugar del TTN MQTT stack (p. ej. schc_bench). Antes de initialize()
+        uint8_t     initialize(uint8_t protocol, uint8_t ack_mode, const SCHC_GW_Loss_Pattern& loss_pattern = SCHC_GW_Loss_Pattern(), int n_workers = 4, int max_sessions = 10000, size_t session_mem_budget = 0, int grace_period_ms = 10000);
         uint8_t     listen_messages(char *buffer);
-        uint8_t     disassociate_session_id(std::string deviceId);      
+        void        stop();
+        bool        is_idle();      // true si los workers no tienen mensajes pendientes
+        uint8_t     disassociate_session_id(uint32_t device, int sessionId);
     private:
         int         get_free_session_id(uint8_t direction);
-        uint8_t     associate_session_id(std::string deviceId, int sessionId);
-        int         get_session_id(std::string deviceId);
+        uint8_t     associate_session_id(uint32_t device, int sessionId);
+        int         get_session_id(uint32_t device);
+        void        release_session_id(uint32_t device, int sessionId);
+        bool        is_first_fragment(int rule_id, char* msg, int len);
         uint8_t                                 _protocol;
-        SCHC_GW_Session                         _uplinkSessionPool[_SESSION_POOL_SIZE];
-        SCHC_GW_Session                         _downlinkSessionPool[_SESSION_POOL_SIZE];
-        SCHC_GW_Stack_L2*                          _stack;
-        std::unordered_map<std::string, int>    _associationMap;
+        SCHC_GW_Session_Table                   _uplinkSessionTable;
+        SCHC_GW_Session_Table                   _downlinkSessionTable;
+        SCHC_GW_Stack_L2*                       _stack = nullptr;
+        SCHC_GW_Association_Map                 _associationMap;    // handle del dispositivo -> session id (mqtt, workers y timer wheel)
+        SCHC_GW_Timer_Wheel                     _timerWheel;        // libera las sesiones retiradas al terminar el grace period
+        int                                     _grace_period_ms;   // tiempo que una sesion terminada descarta fragmentos tardios
+        SCHC_GW_Worker_Pool                     _workerPool;        // se destruye primero: los workers usan _timerWheel
         struct mosquitto*                       _mosq;
-        uint8_t                                 _error_prob;
+        SCHC_GW_Loss_Pattern                    _loss_pattern;      // perdidas simuladas, copiadas por cada maquina de estado
 };
 #endif  // SCHC_GW_Fragmenter_hpp
\ No newline at end of file
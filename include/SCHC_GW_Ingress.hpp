@@ -0,0 +1,73 @@
+#ifndef SCHC_GW_Ingress_hpp
+#define SCHC_GW_Ingress_hpp
+
+#include "SCHC_GW_Fragmenter.hpp"
+#include "SCHC_GW_Device_Table.hpp"
+#include "SCHC_GW_MPSC_Ring.hpp"
+#ifndef SPDLOG_ACTIVE_LEVEL
+#define SPDLOG_ACTIVE_LEVEL SPDLOG_LEVEL_TRACE
+#endif
+#include <spdlog/spdlog.h>
+#include <spdlog/sinks/stdout_color_sinks.h>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+/* Etapa de ingreso de los mensajes MQTT. El callback de mosquitto solo copia el
+payload en el ring del decoder que corresponde al dispositivo (hash del device id
+del topic) y retorna. Un pool de hilos decoder hace el parseo del JSON, la
+decodificacion base64 y el despacho a las sesiones (SCHC_GW_Fragmenter::listen_messages).
+Como cada dispositivo va siempre al mismo decoder, sus mensajes se procesan en orden.
+
+Cada ring es un SCHC_GW_MPSC_Ring con slots de tamaño fijo. Un mensaje mas grande que
+un slot se copia al heap y el slot solo guarda el puntero. Cuando un ring esta lleno el mensaje se descarta,
+o, si block_when_full esta activo, el hilo de mosquitto espera a que el decoder libere
+un slot (backpressure hacia el broker). */
+
+class SCHC_GW_Ingress
+{
+    public:
+        ~SCHC_GW_Ingress();
+        uint8_t     initialize(SCHC_GW_Fragmenter* frag, int n_decoders, int ring_size, int slot_size, bool block_when_full);
+        void        stop();
+        uint8_t     push(const char* topic, const char* payload, int len);    // 0 si el mensaje fue encolado
+        int         get_n_decoders();
+        uint64_t    get_received();
+        uint64_t    get_decoded();
+        uint64_t    get_dropped_full();
+        uint64_t    get_oversize();
+        uint64_t    get_backpressure_waits();
+        size_t      get_depth();
+        std::string to_string();
+    private:
+        struct Slot
+        {
+            int                     len;
+            char*                   data;
+            std::unique_ptr<char[]> heap;       // mensajes mas grandes que el slot
+        };
+        struct Ring
+        {
+            SCHC_GW_MPSC_Ring<Slot>         slots;
+            std::unique_ptr<char[]>         storage;    // ring_size * slot_size bytes
+        };
+        bool        try_push(Ring& ring, const char* payload, int len, std::unique_ptr<char[]>& heap);
+        int         get_decoder_id(const char* topic);
+        void        decoder_loop(int decoder_id);
+        SCHC_GW_Fragmenter*                 _frag = nullptr;
+        std::vector<std::unique_ptr<Ring>>  _rings;
+        std::vector<std::thread>            _threads;
+        int                                 _slot_size;
+        bool                                _block_when_full;
+        std::atomic<bool>                   _running{false};
+        std::atomic<uint64_t>               _received{0};           // mensajes encolados para los decoders (los descartados no se cuentan)
+        std::atomic<uint64_t>               _decoded{0};            // mensajes procesados por los decoders
+        std::atomic<uint64_t>               _dropped_full{0};       // descartados por ring lleno
+        std::atomic<uint64_t>               _oversize{0};           // copiados al heap por ser mas grandes que un slot
+        std::atomic<uint64_t>               _backpressure_waits{0}; // veces que el callback espero por un slot libre
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,36 @@
+#ifndef SCHC_GW_Latency_Histogram_hpp
+#define SCHC_GW_Latency_Histogram_hpp
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+/* Histograma de latencias con buckets en potencias de 2 (en nanosegundos).
+El bucket i acumula las muestras en el rango [2^(i-1), 2^i) ns. Las operaciones
+son atomicas, por lo que varios hilos pueden registrar muestras a la vez. */
+
+#define SCHC_GW_HISTOGRAM_BUCKETS 48
+
+class SCHC_GW_Latency_Histogram
+{
+    public:
+        SCHC_GW_Latency_Histogram();
+        void        record(uint64_t ns);
+        uint64_t    get_count();
+        uint64_t    get_mean_ns();
+        uint64_t    get_sum_ns();
+        uint64_t    get_max_ns();
+        uint64_t    get_percentile_ns(double p);
+        uint64_t    get_bucket_count(int bucket);
+        static uint64_t get_bucket_upper_ns(int bucket);
+        std::string to_string();
+        void        merge(SCHC_GW_Latency_Histogram& other);    // suma las muestras de other
+        void        reset();
+    private:
+        std::atomic<uint64_t>   _buckets[SCHC_GW_HISTOGRAM_BUCKETS];
+        std::atomic<uint64_t>   _count;
+        std::atomic<uint64_t>   _sum_ns;
+        std::atomic<uint64_t>   _max_ns;
+};
+
+#endif
@@ -0,0 +1,117 @@
+#ifndef SCHC_GW_Log_Format_hpp
+#define SCHC_GW_Log_Format_hpp
+
+#include <cstdint>
+#include <fmt/format.h>
+
+/* Vistas para los argumentos de diagnostico de los logs (volcados hex y bitmaps). Solo
+guardan punteros y largos: el texto se genera en el formatter de fmt, es decir, solo
+cuando spdlog decide escribir el mensaje. Si el nivel no esta activo no cuestan nada, y
+con la opcion de CMake SCHC_GW_STRIP_DIAGNOSTICS las macros SPDLOG_TRACE/SPDLOG_DEBUG
+que las usan se eliminan en compilacion.
+
+    SPDLOG_TRACE("Payload: {}", SCHC_GW_Hex(buffer, len));       // "0a 1b 2c"
+    SPDLOG_WARN("Tiles: {:X}", SCHC_GW_Hex(buffer, len));        // "0A1B2C"
+    SPDLOG_DEBUG("Bitmap: {}", SCHC_GW_Bitmap(bitmap, 63));      // "1110...1" */
+
+struct SCHC_GW_Hex
+{
+    SCHC_GW_Hex(const char* data, int len) : data(data), len(len) {}
+    const char* data;
+    int         len;
+};
+
+/* Bitmap de una ventana: el tile i esta en el bit (63 - i) */
+struct SCHC_GW_Bitmap
+{
+    SCHC_GW_Bitmap(uint64_t bitmap, uint8_t win_size) : bitmap(bitmap), win_size(win_size) {}
+    uint64_t    bitmap;
+    uint8_t     win_size;
+};
+
+/* Bitmaps de las ventanas de win_mask, como en un compound ACK */
+struct SCHC_GW_Compound_Bitmap
+{
+    SCHC_GW_Compound_Bitmap(uint8_t win_mask, const uint64_t* bitmaps, uint8_t win_size) : win_mask(win_mask), bitmaps(bitmaps), win_size(win_size) {}
+    uint8_t         win_mask;
+    const uint64_t* bitmaps;
+    uint8_t         win_size;
+};
+
+template<>
+struct fmt::formatter<SCHC_GW_Hex>
+{
+    bool upper = false;     // {:X}: mayusculas y sin separador
+
+    constexpr auto parse(format_parse_context& ctx) -> decltype(ctx.begin())
+    {
+        auto it = ctx.begin();
+        if(it != ctx.end() && *it == 'X')
+        {
+            upper = true;
+            ++it;
+        }
+        return it;
+    }
+
+    template<typename FormatContext>
+    auto format(const SCHC_GW_Hex& hex, FormatContext& ctx) const -> decltype(ctx.out())
+    {
+        const char* digits = upper ? "0123456789ABCDEF" : "0123456789abcdef";
+        auto out = ctx.out();
+        for(int i=0; i<hex.len; i++)
+        {
+            uint8_t byte = static_cast<uint8_t>(hex.data[i]);
+            if(!upper && i > 0)
+                *out++ = ' ';
+            *out++ = digits[byte >> 4];
+            *out++ = digits[byte & 0x0F];
+        }
+        return out;
+    }
+};
+
+template<>
+struct fmt::formatter<SCHC_GW_Bitmap>
+{
+    constexpr auto parse(format_parse_context& ctx) -> decltype(ctx.begin())
+    {
+        return ctx.begin();
+    }
+
+    template<typename FormatContext>
+    auto format(const SCHC_GW_Bitmap& bitmap, FormatContext& ctx) const -> decltype(ctx.out())
+    {
+        auto out = ctx.out();
+        for(int i=0; i<bitmap.win_size; i++)
+            *out++ = ((bitmap.bitmap >> (63 - i)) & 1) ? '1' : '0';
+        return out;
+    }
+};
+
+template<>
+struct fmt::formatter<SCHC_GW_Compound_Bitmap>
+{
+    constexpr auto parse(format_parse_context& ctx) -> decltype(ctx.begin())
+    {
+        return ctx.begin();
+    }
+
+    template<typename FormatContext>
+    auto format(const SCHC_GW_Compound_Bitmap& compound, FormatContext& ctx) const -> decltype(ctx.out())
+    {
+        auto    out     = ctx.out();
+        uint8_t pending = compound.win_mask;
+        bool    first   = true;
+        while(pending != 0)
+        {
+            uint8_t w   = __builtin_ctz(pending);
+            pending     = pending & (pending - 1);
+            out         = fmt::format_to(out, "{}W={} - Bitmap:{}", first ? "" : ", ", w, SCHC_GW_Bitmap(compound.bitmaps[w], compound.win_size));
+            first       = false;
+        }
+        return out;
+    }
+};
+
+#endif
\ No newline at end of file
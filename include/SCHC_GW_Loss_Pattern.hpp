@@ -0,0 +1,52 @@
+#ifndef SCHC_GW_Loss_Pattern_hpp
+#define SCHC_GW_Loss_Pattern_hpp
+
+#include <cstdint>
+#include <string>
+
+/* Perdidas simuladas de fragmentos regulares en la recepcion de una sesion, para
+probar las retransmisiones de Ack-on-Error sin un enlace LoRaWAN con perdidas. Se
+configura con un texto ([schc] loss_pattern en config.ini, --loss en schc_bench):
+
+    none                sin perdidas
+    list:2,4,5          descarta los fragmentos regulares 2, 4 y 5 de cada sesion (el primero es el 1)
+    random:5            descarta cada fragmento regular con probabilidad 5 %
+    burst:20,3          descarta 3 fragmentos seguidos de cada 20
+    gilbert:2,30        Gilbert-Elliott: 2 % de pasar al estado malo, 30 % de volver al
+                        bueno. En el estado malo se descartan todos los fragmentos
+
+Cada maquina de estado tiene su propia copia y reset() la reinicia con una semilla
+(el hash del device id), por lo que las perdidas de un dispositivo son reproducibles.
+El ACK REQ y el All-1 nunca se descartan. */
+
+#define SCHC_GW_LOSS_NONE           0
+#define SCHC_GW_LOSS_LIST           1
+#define SCHC_GW_LOSS_RANDOM         2
+#define SCHC_GW_LOSS_BURST          3
+#define SCHC_GW_LOSS_GILBERT        4
+
+#define SCHC_GW_LOSS_MAX_LIST       16      // largo maximo de list:
+
+class SCHC_GW_Loss_Pattern
+{
+    public:
+        static uint8_t  parse(const std::string& spec, SCHC_GW_Loss_Pattern& pattern);     // 0 si spec es valido
+        void            reset(uint64_t seed);
+        bool            drop();             // true si el siguiente fragmento regular se descarta
+        bool            is_enabled() const;
+        std::string     to_string() const;
+    private:
+        uint32_t        next_random();
+        uint8_t         _type       = SCHC_GW_LOSS_NONE;
+        uint32_t        _list[SCHC_GW_LOSS_MAX_LIST];
+        uint8_t         _list_len   = 0;
+        uint32_t        _p          = 0;    // random y gilbert (good -> bad): probabilidad en 1/2^32. burst: periodo
+        uint32_t        _r          = 0;    // gilbert (bad -> good): probabilidad en 1/2^32. burst: largo
+        double          _p_percent  = 0;    // valores originales para to_string()
+        double          _r_percent  = 0;
+        uint32_t        _counter    = 0;    // fragmentos regulares recibidos
+        uint64_t        _rng        = 0;
+        bool            _bad        = false;
+};
+
+#endif
\ No newline at end of file
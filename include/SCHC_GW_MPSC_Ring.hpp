@@ -0,0 +1,160 @@
+#ifndef SCHC_GW_MPSC_Ring_hpp
+#define SCHC_GW_MPSC_Ring_hpp
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+
+/* Buffer circular acotado y lock-free para varios productores y un consumidor (MPSC).
+Cada entrada tiene un numero de secuencia que indica si esta libre (== pos) o si el
+consumidor todavia no la procesa (== pos + 1). Los productores reservan una entrada con
+CAS sobre head y la llenan en su lugar; el consumidor la procesa en su lugar y la libera
+con pop(). Cuando el ring esta vacio el consumidor duerme en wait() y los productores
+solo toman el mutex si el consumidor esta durmiendo.
+
+Lo usan el ingreso de los mensajes MQTT (SCHC_GW_Ingress) y el outbox de downlinks
+(SCHC_GW_TTN_MQTT_Stack). */
+
+template<typename T>
+class SCHC_GW_MPSC_Ring
+{
+    public:
+        void        initialize(size_t size);                // size se redondea a una potencia de 2
+        size_t      get_capacity();
+        size_t      get_size();                             // entradas encoladas que el consumidor aun no libera
+        T&          get_entry(size_t i);                    // para inicializar las entradas antes de usar el ring
+        template<typename Fill>
+        bool        try_push(Fill&& fill);                  // false si el ring esta lleno. fill(T&) llena la entrada reservada
+        T*          front();                                // solo el consumidor. nullptr si el ring esta vacio
+        void        pop();                                  // solo el consumidor. Libera la entrada de front()
+        void        wait(int timeout_ms, const std::atomic<bool>& running);
+        void        notify_all();
+    private:
+        struct Cell
+        {
+            std::atomic<uint64_t>   sequence;
+            T                       value;
+        };
+        std::unique_ptr<Cell[]>             _cells;
+        uint64_t                            _mask = 0;
+        alignas(64) std::atomic<uint64_t>   _head{0};       // proxima posicion a escribir (productores)
+        alignas(64) std::atomic<uint64_t>   _tail{0};       // proxima posicion a leer (solo el consumidor la escribe)
+        std::atomic<bool>                   _sleeping{false};
+        std::mutex                          _mutex;
+        std::condition_variable             _cond;
+};
+
+template<typename T>
+void SCHC_GW_MPSC_Ring<T>::initialize(size_t size)
+{
+    uint64_t n_cells = 2;
+    while(n_cells < size)
+        n_cells = n_cells * 2;
+
+    _cells  = std::make_unique<Cell[]>(n_cells);
+    _mask   = n_cells - 1;
+    for(uint64_t i=0; i<n_cells; i++)
+        _cells[i].sequence.store(i, std::memory_order_relaxed);
+    _head.store(0, std::memory_order_relaxed);
+    _tail.store(0, std::memory_order_relaxed);
+}
+
+template<typename T>
+size_t SCHC_GW_MPSC_Ring<T>::get_capacity()
+{
+    return _mask + 1;
+}
+
+template<typename T>
+size_t SCHC_GW_MPSC_Ring<T>::get_size()
+{
+    uint64_t tail = _tail.load(std::memory_order_relaxed);
+    return _head.load(std::memory_order_relaxed) - tail;
+}
+
+template<typename T>
+T& SCHC_GW_MPSC_Ring<T>::get_entry(size_t i)
+{
+    return _cells[i & _mask].value;
+}
+
+template<typename T>
+template<typename Fill>
+bool SCHC_GW_MPSC_Ring<T>::try_push(Fill&& fill)
+{
+    uint64_t pos = _head.load(std::memory_order_relaxed);
+    Cell*    cell;
+    while(true)
+    {
+        cell            = &_cells[pos & _mask];
+        uint64_t seq    = cell->sequence.load(std::memory_order_acquire);
+        int64_t  diff   = static_cast<int64_t>(seq) - static_cast<int64_t>(pos);
+        if(diff == 0)
+        {
+            if(_head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                break;
+        }
+        else if(diff < 0)
+        {
+            return false;   // ring lleno
+        }
+        else
+        {
+            pos = _head.load(std::memory_order_relaxed);
+        }
+    }
+
+    fill(cell->value);
+    cell->sequence.store(pos + 1, std::memory_order_release);
+
+    /* Despierta al consumidor solo si esta durmiendo */
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if(_sleeping.load(std::memory_order_relaxed))
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _cond.notify_one();
+    }
+    return true;
+}
+
+template<typename T>
+T* SCHC_GW_MPSC_Ring<T>::front()
+{
+    uint64_t tail = _tail.load(std::memory_order_relaxed);
+    Cell&    cell = _cells[tail & _mask];
+    if(cell.sequence.load(std::memory_order_acquire) != tail + 1)
+        return nullptr;
+    return &cell.value;
+}
+
+template<typename T>
+void SCHC_GW_MPSC_Ring<T>::pop()
+{
+    uint64_t tail = _tail.load(std::memory_order_relaxed);
+    _cells[tail & _mask].sequence.store(tail + _mask + 1, std::memory_order_release);     // libre para la siguiente vuelta
+    _tail.store(tail + 1, std::memory_order_relaxed);
+}
+
+template<typename T>
+void SCHC_GW_MPSC_Ring<T>::wait(int timeout_ms, const std::atomic<bool>& running)
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    _sleeping.store(true, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    _cond.wait_for(lock, std::chrono::milliseconds(timeout_ms), [&]{
+        return front() != nullptr || !running.load();
+    });
+    _sleeping.store(false, std::memory_order_relaxed);
+}
+
+template<typename T>
+void SCHC_GW_MPSC_Ring<T>::notify_all()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _cond.notify_all();
+}
+
+#endif
\ No newline at end of file
@@ -1,7 +1,9 @@
 #ifndef SCHC_Macros_hpp
 #define SCHC_Macros_hpp
 
-#define _SESSION_POOL_SIZE 10   // Sessions numbers
+#define _SESSION_SLAB_SIZE 64   // Sessions created each time the session table grows
+#define SCHC_REASSEMBLY_ALIGN 64    // Alignment (cache line) of the reassembly arena of each session
+#define SCHC_ACK_MAX_LEN 64         // Bytes reserved on the stack for an encoded SCHC ACK (compound ACK of 4 windows: 33 bytes)
 
 /* Fragmentation traffic direction */
 #define SCHC_FRAG_UP 1
@@ -0,0 +1,65 @@
+#ifndef SCHC_GW_Metrics_hpp
+#define SCHC_GW_Metrics_hpp
+
+#include "SCHC_GW_Latency_Histogram.hpp"
+#ifndef SPDLOG_ACTIVE_LEVEL
+#define SPDLOG_ACTIVE_LEVEL SPDLOG_LEVEL_TRACE
+#endif
+#include <spdlog/spdlog.h>
+#include <spdlog/sinks/stdout_color_sinks.h>
+#include <cstdint>
+#include <functional>
+#include <string>
+
+/* Registro de metricas del gateway, exportadas en formato de texto de Prometheus por un
+servidor HTTP local (GET /metrics).
+
+Los contadores y los histogramas de latencia del camino de los mensajes se escriben en un
+bloque por hilo (alineado a una linea de cache), que se crea en el primer uso y nunca se
+libera. add() y record() no comparten lineas de cache entre hilos ni toman locks; render()
+suma los bloques de todos los hilos.
+
+Los valores que ya llevan los componentes (profundidad de las colas, sesiones activas,
+contadores del ingress, del outbox y de la traza) se registran como callbacks con
+add_callback(), que se leen solo al exportar. Cada componente quita sus callbacks con
+remove_callbacks(owner) antes de destruirse. */
+
+/* Contadores. Los mensajes recibidos usan el tipo de get_msg_type() como indice */
+#define SCHC_GW_METRIC_RX_MSG               0       // + SCHC_REGULAR_FRAGMENT_MSG ... SCHC_RECEIVER_ABORT_MSG
+#define SCHC_GW_METRIC_RX_UNKNOWN           6
+#define SCHC_GW_METRIC_ACKS_SENT            7
+#define SCHC_GW_METRIC_TILES_LOST           8
+#define SCHC_GW_METRIC_FRAGMENTS_DROPPED    9
+#define SCHC_GW_METRIC_RCS_FAILURES         10
+#define SCHC_GW_METRIC_SESSIONS_STARTED     11
+#define SCHC_GW_METRIC_SESSIONS_ENDED       12
+#define SCHC_GW_METRIC_COUNTERS             13
+
+/* Histogramas de latencia */
+#define SCHC_GW_METRIC_QUEUE_LATENCY        0       // SCHC_GW_Worker_Pool::post() -> execute_machine()
+#define SCHC_GW_METRIC_DOWNLINK_LATENCY     1       // send_downlink_frame() -> on_publish()
+#define SCHC_GW_METRIC_HISTOGRAMS           2
+
+/* Tipos de los callbacks */
+#define SCHC_GW_METRIC_COUNTER              0
+#define SCHC_GW_METRIC_GAUGE                1
+
+class SCHC_GW_Metrics
+{
+    public:
+        static void         add(int counter, uint64_t n = 1);
+        static void         add_received(uint8_t msg_type);
+        static void         record(int histogram, uint64_t ns);
+        static uint64_t     get_counter(int counter);
+        static void         get_histogram(int histogram, SCHC_GW_Latency_Histogram& out);
+        static void         add_callback(const void* owner, uint8_t type, const char* name, const std::string& labels, const char* help, std::function<double()> value);
+        static void         remove_callbacks(const void* owner);
+        static std::string  render();
+        static uint8_t      start_server(const std::string& bind_address, int port);
+        static void         stop_server();
+    private:
+        static void         server_loop(int listen_fd);
+        static void         serve(int fd);
+};
+
+#endif
\ No newline at end of file
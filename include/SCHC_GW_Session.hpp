@@ -5,8 +5,11 @@
 #include "SCHC_GW_Ack_on_error.hpp"
 #include "SCHC_GW_State_Machine.hpp"
 #include "SCHC_GW_Stack_L2.hpp"
-#include "SCHC_GW_ThreadSafeQueue.hpp"
+#include "SCHC_GW_Worker_Pool.hpp"
+#include "SCHC_GW_Device_Table.hpp"
+#ifndef SPDLOG_ACTIVE_LEVEL
 #define SPDLOG_ACTIVE_LEVEL SPDLOG_LEVEL_TRACE
+#endif
 #include <spdlog/spdlog.h>
 #include <spdlog/sinks/stdout_color_sinks.h>
 #include <mosquitto.h>
@@ -18,15 +21,16 @@ class SCHC_GW_Fragmenter;
 class SCHC_GW_Session
 {
     public:
-        uint8_t initialize(SCHC_GW_Fragmenter* frag, uint8_t protocol, uint8_t direction, uint8_t session_id, SCHC_GW_Stack_L2* stack_ptr, uint8_t ack_mode, uint8_t error_prob);
-        void    process_message(std::string dev_id, int rule_id, char* msg, int len);
+        uint8_t initialize(SCHC_GW_Fragmenter* frag, uint8_t protocol, uint8_t direction, int session_id, SCHC_GW_Stack_L2* stack_ptr, SCHC_GW_Worker_Pool* pool, uint8_t ack_mode, const SCHC_GW_Loss_Pattern* loss_pattern);
+        void    process_message(SCHC_GW_Fragment&& frag);
         bool    is_running();
         void    set_running(bool status);
         bool    is_first_msg();
         void    set_is_first_msg(bool status);
         void    destroyStateMachine();
+        static size_t get_memory_footprint(uint8_t protocol, uint8_t direction);     // memoria maxima usada por una sesion activa
     private:
-        uint8_t                 _session_id;
+        int                     _session_id;
         uint8_t                 _protocol;
         uint8_t                 _direction;
         uint8_t                 _tileSize;              // tile size in bytes
@@ -44,9 +48,11 @@ class SCHC_GW_Session
         std::shared_ptr<SCHC_GW_State_Machine> _stateMachine;
         SCHC_GW_Stack_L2*          _stack;
         SCHC_GW_Fragmenter*     _frag;
-        std::string             _dev_id;
+        SCHC_GW_Worker_Pool*    _pool;                  // pool que ejecuta la maquina de estado
+        int                     _worker_id;             // worker asignado al dispositivo de la sesion
+        uint32_t                _device;                // handle de SCHC_GW_Device_Table
         uint8_t                 _ack_mode;
-        uint8_t                 _error_prob;
+        const SCHC_GW_Loss_Pattern* _loss_pattern;      // del fragmenter. Cada maquina de estado tiene su copia
 
         std::atomic<bool>       _is_running;            // controla si la sesion está siendo usada o puede ser destruida
         std::atomic<bool>       _is_first_msg;          // controla si la sesion ha recibido antes algun mensaje
@@ -0,0 +1,51 @@
+#ifndef SCHC_GW_Session_Table_hpp
+#define SCHC_GW_Session_Table_hpp
+
+#include "SCHC_GW_Macros.hpp"
+#include "SCHC_GW_Session.hpp"
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/* Tabla de sesiones que crece bajo demanda en slabs de _SESSION_SLAB_SIZE sesiones.
+Los slabs nunca se mueven ni se liberan mientras la tabla existe, por lo que el
+session id (slab * _SESSION_SLAB_SIZE + indice) es estable durante toda la vida de
+la sesion y get_session() no necesita lock. Las sesiones libres se mantienen en
+una free list, por lo que allocate() y release() son O(1). Cada session id tiene
+un flag de uso, asi release() rechaza un id que ya fue liberado. */
+
+class SCHC_GW_Session_Table
+{
+    public:
+        ~SCHC_GW_Session_Table();
+        uint8_t             initialize(SCHC_GW_Fragmenter* frag, uint8_t protocol, uint8_t direction, SCHC_GW_Stack_L2* stack_ptr, SCHC_GW_Worker_Pool* pool, uint8_t ack_mode, const SCHC_GW_Loss_Pattern* loss_pattern, int max_sessions, size_t mem_budget);
+        int                 allocate();
+        uint8_t             release(int session_id);
+        SCHC_GW_Session&    get_session(int session_id);
+        int                 get_active_sessions();
+        int                 get_capacity();
+        int                 get_max_sessions();
+    private:
+        bool                grow();
+        std::unique_ptr<std::atomic<SCHC_GW_Session*>[]>    _slabs;         // punteros a los slabs, reservados para _max_slabs
+        int                                                 _max_slabs;
+        int                                                 _n_slabs;
+        int                                                 _max_sessions;  // limite efectivo (max_sessions y mem_budget)
+        int                                                 _active;
+        std::vector<int>                                    _free_list;
+        std::vector<bool>                                   _in_use;        // un flag por session id, crece con cada slab
+        std::mutex                                          _mutex;
+
+        /* Parametros para inicializar las sesiones de cada slab nuevo */
+        SCHC_GW_Fragmenter*                                 _frag;
+        uint8_t                                             _protocol;
+        uint8_t                                             _direction;
+        SCHC_GW_Stack_L2*                                   _stack;
+        SCHC_GW_Worker_Pool*                                _pool;
+        uint8_t                                             _ack_mode;
+        const SCHC_GW_Loss_Pattern*                         _loss_pattern;
+};
+
+#endif
\ No newline at end of file
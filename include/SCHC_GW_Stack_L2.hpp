@@ -9,7 +9,10 @@ class SCHC_GW_Stack_L2
 {
 public:
     virtual uint8_t initialize_stack(void) = 0;
-    virtual uint8_t send_downlink_frame(std::string dev_id, uint8_t ruleID, char* msg, int len) = 0;
+    virtual void    stop_stack(void) = 0;
+    virtual uint8_t send_downlink_frame(uint32_t device, uint8_t ruleID, char* msg, int len) = 0;     // device: handle de SCHC_GW_Device_Table
+    virtual void    open_device(uint32_t) {}            // empieza una sesion del dispositivo
+    virtual void    close_device(uint32_t) {}           // la ultima sesion del dispositivo fue liberada
     virtual int     getMtu(bool consider_Fopt) = 0;
 };
 
@@ -2,29 +2,114 @@
 #define SCHC_TTN_Stack_hpp
 
 #include "SCHC_GW_Stack_L2.hpp"
+#include "SCHC_GW_Base64.hpp"
+#include "SCHC_GW_Device_Table.hpp"
+#include "SCHC_GW_MPSC_Ring.hpp"
+#include "SCHC_GW_Metrics.hpp"
 #include <cstdint>
+#ifndef SPDLOG_ACTIVE_LEVEL
 #define SPDLOG_ACTIVE_LEVEL SPDLOG_LEVEL_TRACE
+#endif
 #include <spdlog/spdlog.h>
 #include <spdlog/sinks/stdout_color_sinks.h>
 #include "SimpleIni.h"
-#include <nlohmann/json.hpp>
-using json = nlohmann::json;
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/* Los downlinks no se publican desde los hilos de las sesiones. send_downlink_frame()
+copia el mensaje en un outbox acotado (SCHC_GW_MPSC_Ring) y retorna sin bloquear; si el
+outbox esta lleno el downlink se descarta y la sesion lo recupera con el siguiente ACK REQ.
+Un unico hilo publisher vacia el outbox por lotes y es el unico que llama a
+mosquitto_publish(). La red la atiende el loop de mosquitto del hilo principal
+(mosquitto_threaded_set), y on_publish() informa cuando cada mid fue entregado al broker.
+
+El topic de cada dispositivo se arma una sola vez, en open_device() al empezar su sesion,
+y se guarda en un cache indexado por el handle del dispositivo hasta que close_device()
+lo quita al liberar la sesion. El publisher solo lee el cache; los topics quitados los
+libera el mismo publisher entre dos lotes, cuando no esta usando ninguno. Si un downlink
+no encuentra su topic en el cache, se arma sobre _topic. El JSON es una plantilla fija
+donde solo se insertan el f_port y el payload en base64. No hay reservas de heap por
+downlink. */
+
+#define SCHC_GW_DOWNLINK_MAX_LEN        242     // maximo payload de un downlink LoRaWAN
+#define SCHC_GW_DOWNLINK_JSON_MAX_LEN   512     // plantilla + f_port + base64 de SCHC_GW_DOWNLINK_MAX_LEN bytes
 
 class SCHC_GW_TTN_MQTT_Stack: public SCHC_GW_Stack_L2
 {
     public:
+        ~SCHC_GW_TTN_MQTT_Stack();
         uint8_t     initialize_stack(void);
-        uint8_t     send_downlink_frame(std::string dev_id, uint8_t ruleID, char* msg, int len);
+        void        stop_stack(void);
+        uint8_t     send_downlink_frame(uint32_t device, uint8_t ruleID, char* msg, int len);  // 0 si el downlink fue encolado
+        void        open_device(uint32_t device);       // arma el topic del dispositivo
+        void        close_device(uint32_t device);      // quita el topic del dispositivo del cache
         int         getMtu(bool consider_Fopt);
         uint8_t     set_mqtt_stack(mosquitto* mosqStack);
         void        set_application_id(std::string app);
         void        set_tenant_id(std::string tenant);
-        std::string base64_encode(const char* buffer, int len);
+        void        set_dry_run(bool dry_run);          // arma los downlinks pero no llama a mosquitto_publish() (replay sin broker)
+        static void on_publish(struct mosquitto* mosq, void* obj, int mid);
+        static int  format_downlink_json(uint8_t f_port, const char* payload, int len, char* out);      // out de SCHC_GW_DOWNLINK_JSON_MAX_LEN bytes
+        uint64_t    get_enqueued();
+        uint64_t    get_published();
+        uint64_t    get_completed();
+        uint64_t    get_dropped();
+        uint64_t    get_publish_errors();
+        size_t      get_depth();
+        uint64_t    get_cached_topics();
+        uint64_t    get_topic_misses();
+        double      get_allocs_per_downlink();
+        std::string to_string();
     private:
-        struct mosquitto*   _mosq;
-        std::string         _application_id;
-        std::string         _tenant_id;
-        const char*         _mqqt_username;
+        struct Downlink
+        {
+            uint32_t                                device;         // handle de SCHC_GW_Device_Table
+            uint8_t                                 rule_id;
+            int                                     len;
+            char                                    payload[SCHC_GW_DOWNLINK_MAX_LEN];
+            std::chrono::steady_clock::time_point   enqueued_at;
+        };
+        struct In_Flight
+        {
+            std::atomic<uint64_t>   tag{0};             // (mid << 1) | 1 si lo escribio el publisher, (mid << 1) si lo escribio on_publish
+            std::atomic<int64_t>    enqueued_ns{0};
+        };
+        void        publisher_loop();
+        void        publish(Downlink& downlink);
+        void        complete(int mid);
+        std::atomic<char*>* get_topic_slot(uint32_t device, bool create);
+        void        free_retired_topics();
+        struct mosquitto*                   _mosq;
+        std::string                         _application_id;
+        std::string                         _tenant_id;
+        std::string                         _mqqt_username;
+        SCHC_GW_MPSC_Ring<Downlink>         _outbox;
+        std::unique_ptr<In_Flight[]>        _in_flight;         // indexado por mid, para medir enqueue -> on_publish
+        size_t                              _in_flight_mask = 0;
+        int                                 _batch_size = 32;
+        std::thread                         _publisher;
+        std::atomic<bool>                   _running{false};
+        bool                                _dry_run = false;
+        std::atomic<uint64_t>               _enqueued{0};
+        std::atomic<uint64_t>               _published{0};      // aceptados por mosquitto_publish()
+        std::atomic<uint64_t>               _completed{0};      // confirmados por on_publish()
+        std::atomic<uint64_t>               _dropped{0};        // outbox lleno o downlink demasiado grande
+        std::atomic<uint64_t>               _publish_errors{0};
+        std::atomic<uint64_t>               _allocs{0};         // reservas de heap del publisher (SCHC_GW_COUNT_ALLOCS)
+        std::string                         _topic_prefix;      // "v3/{username}/devices/"
+        std::string                         _topic;             // _topic_prefix + device id + "/down/push", para los downlinks sin topic en el cache
+        std::atomic<std::atomic<char*>*>    _topic_blocks[SCHC_GW_DEVICE_MAX_BLOCKS] = {};     // handle -> topic ('\0' al final) o nullptr
+        std::mutex                          _topics_mutex;      // creacion de bloques y _retired_topics
+        std::vector<char*>                  _retired_topics;    // quitados del cache, pendientes de liberar por el publisher
+        std::atomic<bool>                   _has_retired_topics{false};
+        std::atomic<uint64_t>               _cached_topics{0};
+        std::atomic<uint64_t>               _topic_misses{0};
+        char                                _json[SCHC_GW_DOWNLINK_JSON_MAX_LEN];
 };
 
 
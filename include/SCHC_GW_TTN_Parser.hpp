@@ -2,33 +2,52 @@
 #define SCHC_GW_TTN_Parser_hpp
 
 #include <cstdint>
-#include <nlohmann/json.hpp>
 #include <string>
 
+#ifndef SPDLOG_ACTIVE_LEVEL
 #define SPDLOG_ACTIVE_LEVEL SPDLOG_LEVEL_TRACE
+#endif
 #include <spdlog/spdlog.h>
 #include <spdlog/sinks/stdout_color_sinks.h>
 
 #include <iostream>
 #include "SCHC_GW_Message.hpp"
+#include "SCHC_GW_Fragment.hpp"
+#include "SCHC_GW_Device_Table.hpp"
+#include "SCHC_GW_Base64.hpp"
 
-using json = nlohmann::json;
+/* Objetos del JSON de uplink de TTN que el scanner recorre */
+#define SCHC_GW_TTN_JSON_ROOT           0
+#define SCHC_GW_TTN_JSON_END_DEVICE_IDS 1
+#define SCHC_GW_TTN_JSON_UPLINK_MESSAGE 2
 
 class SCHC_GW_TTN_Parser
 {
     public:
         int         initialize_parser(char *buffer);
         char*       get_decoded_payload();
+        SCHC_GW_Fragment take_fragment();       // cede el payload decodificado junto con el dispositivo, el rule id y el instante de recepcion
         int         get_payload_len();
-        std::string get_device_id();
+        uint32_t    get_device();           // handle de SCHC_GW_Device_Table
         int         get_rule_id();  
-        void        delete_decoded_payload();
+        void        release_decoded_payload();
     private:
-        uint8_t     base64_decode(std::string encoded, char*& decoded_buffer, int& len);
-        char*       _decoded_payload = nullptr;    // frm_payload decoded
-        int         _len;                       // frmPayload length
-        std::string _deviceId;                  // LoRaWAN deviceID
+        const char* scan_object(const char* p, const char* end, uint8_t object);
+        const char* scan_field(uint8_t object, const char* key, int key_len, const char* p, const char* end);
+        static const char*  scan_string(const char* p, const char* end, const char*& str, int& str_len, bool& escaped);
+        static const char*  skip_value(const char* p, const char* end);
+        static const char*  skip_ws(const char* p, const char* end);
+        SCHC_GW_Fragment    _fragment;          // frm_payload decoded
+        uint32_t    _device = SCHC_GW_DEVICE_INVALID;   // handle del LoRaWAN deviceID
         int         _rule_id;
+
+        /* Valores encontrados por el scanner. Apuntan dentro del buffer del mensaje MQTT */
+        const char* _json_device_id         = nullptr;
+        int         _json_device_id_len     = 0;
+        bool        _json_device_id_escaped = false;
+        const char* _json_frm_payload       = nullptr;
+        int         _json_frm_payload_len   = 0;
+        bool        _json_has_f_port        = false;
 };
 
 #endif
\ No newline at end of file
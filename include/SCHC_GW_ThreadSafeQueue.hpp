@@ -1,19 +1,47 @@
 #ifndef SCHC_GW_ThreadSafeQueue_hpp
 #define SCHC_GW_ThreadSafeQueue_hpp
 
-#include <iostream>
-#include <queue>
-#include <mutex>
-#include <thread>
+#include "SCHC_GW_State_Machine.hpp"
+#include "SCHC_GW_Fragment.hpp"
+#include "SCHC_GW_MPSC_Ring.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <tuple>
+#include <vector>
+
+/* Run queue de un worker. Varios productores (los hilos que despachan los uplinks a las
+sesiones) y un unico consumidor (el worker). Es un SCHC_GW_MPSC_Ring acotado, sin locks
+en push() ni en pop(): el consumidor solo toma el mutex del ring para dormir cuando la
+cola esta vacia.
+
+push() bloquea mientras la cola esta llena (backpressure hacia el ingreso) y try_push()
+retorna false. try_pop_batch() y wait_and_pop_all() mueven varias entradas a un batch
+que el worker reutiliza. Los fragmentos guardan el payload inline, por lo que encolar y
+extraer mensajes no usa el heap. */
+
+#define SCHC_GW_QUEUE_SIZE      4096    // entradas por worker (se redondea a una potencia de 2)
 
 class SCHC_GW_ThreadSafeQueue {
     public:
-        void push(uint8_t rule_id, char* mesg, int len);
-        bool pop(uint8_t& rule_id, char*& mesg, int& len);
+        typedef std::chrono::steady_clock::time_point               time_point;
+        typedef std::shared_ptr<SCHC_GW_State_Machine>              machine_ptr;
+        typedef std::tuple<machine_ptr, SCHC_GW_Fragment, time_point>  entry_t;    // time_point: instante en que se encolo
+        typedef std::vector<entry_t>                                batch_t;
+
+        explicit SCHC_GW_ThreadSafeQueue(size_t size = SCHC_GW_QUEUE_SIZE);
+        bool push(machine_ptr machine, SCHC_GW_Fragment&& frag);      // bloquea si la cola esta llena. false si la cola se cerro
+        bool try_push(machine_ptr& machine, SCHC_GW_Fragment& frag);   // false si la cola esta llena (los argumentos no se mueven)
+        bool pop(machine_ptr& machine, SCHC_GW_Fragment& frag);        // solo el consumidor
+        size_t try_pop_batch(batch_t& batch, size_t max_entries);  // solo el consumidor. Agrega hasta max_entries al final del batch
+        bool wait_and_pop_all(batch_t& batch);      // bloquea hasta que exista al menos un mensaje y extrae todos los disponibles
+        void close();                               // despierta a los hilos bloqueados en push() y wait_and_pop_all()
         bool empty();
         size_t size();
+        size_t get_capacity();
     private:
-        std::queue<std::tuple<uint8_t, char*, int>> _queue;
-        std::mutex _mutex;
+        SCHC_GW_MPSC_Ring<entry_t>  _ring;
+        std::atomic<bool>           _open{true};
 };
 #endif
\ No newline at end of file
@@ -0,0 +1,50 @@
+#ifndef SCHC_GW_Timer_Wheel_hpp
+#define SCHC_GW_Timer_Wheel_hpp
+
+#ifndef SPDLOG_ACTIVE_LEVEL
+#define SPDLOG_ACTIVE_LEVEL SPDLOG_LEVEL_TRACE
+#endif
+#include <spdlog/spdlog.h>
+#include <spdlog/sinks/stdout_color_sinks.h>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/* Timer wheel (hashed) con un solo hilo. Cada tick avanza una posicion de la rueda
+y ejecuta los timers vencidos de esa posicion. Los timers con un retardo mayor que
+una vuelta completa guardan el numero de vueltas que faltan. schedule() es O(1) y
+los callbacks se ejecutan en el hilo de la rueda, fuera del lock, por lo que no
+deben bloquear. */
+
+class SCHC_GW_Timer_Wheel
+{
+    public:
+        typedef std::function<void()>   callback_t;
+
+        ~SCHC_GW_Timer_Wheel();
+        uint8_t     initialize(int tick_ms, int n_slots);
+        void        schedule(int delay_ms, callback_t callback);
+        void        stop();
+        size_t      get_pending();
+    private:
+        struct Timer
+        {
+            int             rounds;     // vueltas completas que faltan para vencer
+            callback_t      callback;
+        };
+        void        run();
+        std::vector<std::vector<Timer>>     _slots;
+        int                                 _tick_ms;
+        int                                 _cursor;        // ultima posicion procesada
+        size_t                              _pending;
+        bool                                _running = false;
+        std::mutex                          _mutex;
+        std::condition_variable             _cond;
+        std::thread                         _thread;
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,75 @@
+#ifndef SCHC_GW_Trace_hpp
+#define SCHC_GW_Trace_hpp
+
+#include "SCHC_GW_MPSC_Ring.hpp"
+#ifndef SPDLOG_ACTIVE_LEVEL
+#define SPDLOG_ACTIVE_LEVEL SPDLOG_LEVEL_TRACE
+#endif
+#include <spdlog/spdlog.h>
+#include <spdlog/sinks/stdout_color_sinks.h>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+
+/* Traza de los mensajes SCHC (fragmentos, All-1, ACK REQ y ACKs) de todas las sesiones.
+Los hilos de las sesiones solo escriben un evento binario de tamaño fijo en un
+SCHC_GW_MPSC_Ring y retornan; un hilo de traza los formatea y los escribe con su propio
+logger ("schc_trace"), conservando la hora y el hilo de la sesion que los genero. Si el
+ring esta lleno el evento se descarta y se cuenta.
+
+La traza se desactiva en tiempo de ejecucion con set_enabled(false) (una lectura atomica
+por evento) o en compilacion con SCHC_GW_DISABLE_TRACE, que elimina las llamadas. */
+
+#define SCHC_GW_TRACE_FRAGMENT          0
+#define SCHC_GW_TRACE_ALL1              1
+#define SCHC_GW_TRACE_ACK_REQ           2
+#define SCHC_GW_TRACE_ACK               3
+#define SCHC_GW_TRACE_COMPOUND_ACK      4
+
+#define SCHC_GW_TRACE_MAX_WINDOWS       8       // ventanas de un compound ACK (ancho de la mascara)
+
+#if defined(SCHC_GW_DISABLE_TRACE)
+#define SCHC_GW_TRACE(event) do { } while(0)
+#else
+#define SCHC_GW_TRACE(event) do { if(SCHC_GW_Trace::is_enabled()) SCHC_GW_Trace::event; } while(0)
+#endif
+
+struct SCHC_GW_Trace_Event
+{
+    int64_t     time_ns;        // system_clock, el mismo reloj de spdlog
+    uint32_t    thread_id;
+    uint8_t     type;
+    uint8_t     w;
+    uint8_t     fcn;
+    uint8_t     c;
+    uint8_t     flag;           // All-1: integrity check ok. ACK REQ: pull ACK REQ descartado
+    uint8_t     win_size;
+    uint8_t     win_mask;       // ventanas del compound ACK
+    int16_t     value;          // tiles del fragmento o bits del ultimo tile
+    uint64_t    bitmaps[SCHC_GW_TRACE_MAX_WINDOWS];
+};
+
+class SCHC_GW_Trace
+{
+    public:
+        static uint8_t      initialize(size_t ring_size, bool enabled);
+        static void         stop();
+        static bool         is_enabled() { return _enabled.load(std::memory_order_relaxed); }
+        static void         set_enabled(bool enabled);
+        static void         fragment(uint8_t w, uint8_t fcn, int tiles);
+        static void         all1(uint8_t w, uint8_t fcn, int bits, bool rcs_ok);
+        static void         ack_req(uint8_t w, bool discarded);
+        static void         ack(uint8_t w, uint8_t c, uint64_t bitmap, uint8_t win_size);
+        static void         compound_ack(uint8_t c, uint8_t win_mask, const uint64_t* bitmaps, uint8_t win_size);
+        static uint64_t     get_recorded();
+        static uint64_t     get_dropped();
+    private:
+        static void         record(SCHC_GW_Trace_Event& event);
+        static void         trace_loop();
+        static void         write(const SCHC_GW_Trace_Event& event);
+        static inline std::atomic<bool>     _enabled{false};
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,47 @@
+#ifndef SCHC_GW_Worker_Pool_hpp
+#define SCHC_GW_Worker_Pool_hpp
+
+#include "SCHC_GW_State_Machine.hpp"
+#include "SCHC_GW_ThreadSafeQueue.hpp"
+#include "SCHC_GW_Metrics.hpp"
+#include "SCHC_GW_Fragment.hpp"
+#include "SCHC_GW_Alloc_Counter.hpp"
+#ifndef SPDLOG_ACTIVE_LEVEL
+#define SPDLOG_ACTIVE_LEVEL SPDLOG_LEVEL_TRACE
+#endif
+#include <spdlog/spdlog.h>
+#include <spdlog/sinks/stdout_color_sinks.h>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+/* Pool fijo de hilos que ejecutan las maquinas de estado de todas las sesiones.
+Cada sesion se asigna siempre al mismo worker (hash del device id), por lo que
+sus mensajes se ejecutan en orden y nunca en paralelo. La cantidad de hilos no
+depende de la cantidad de dispositivos. */
+
+class SCHC_GW_Worker_Pool
+{
+    public:
+        ~SCHC_GW_Worker_Pool();
+        uint8_t     initialize(int n_workers);
+        void        stop();
+        int         get_worker_id(uint32_t device);
+        void        post(int worker_id, std::shared_ptr<SCHC_GW_State_Machine> machine, SCHC_GW_Fragment&& frag);
+        int         get_n_workers();
+        double      get_allocs_per_message();
+        bool        is_idle();      // true si todos los mensajes recibidos por post() ya fueron ejecutados o descartados
+    private:
+        void        worker_loop(int worker_id);
+        std::vector<std::unique_ptr<SCHC_GW_ThreadSafeQueue>>  _queues;     // run queue de cada worker
+        std::vector<std::thread>                                _threads;
+        std::atomic<bool>                                       _running{false};
+        std::atomic<uint64_t>                                   _posted{0};         // mensajes recibidos por post()
+        std::atomic<uint64_t>                                   _finished{0};       // mensajes ejecutados o descartados por los workers
+        std::atomic<uint64_t>                                   _executed{0};       // mensajes ejecutados
+        std::atomic<uint64_t>                                   _allocs{0};         // reservas en el heap durante execute_machine()
+};
+
+#endif
\ No newline at end of file
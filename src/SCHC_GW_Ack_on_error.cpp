@@ -9,9 +9,10 @@ SCHC_GW_Ack_on_error::SCHC_GW_Ack_on_error()
 SCHC_GW_Ack_on_error::~SCHC_GW_Ack_on_error()
 {
     SPDLOG_DEBUG("Calling SCHC_GW_Ack_on_error destructor");
+    this->free_reassembly();
 }
 
-uint8_t SCHC_GW_Ack_on_error::init(string dev_id, uint8_t ruleID, uint8_t dTag, uint8_t windowSize, uint8_t tileSize, uint8_t n, uint8_t m, uint8_t ackMode, SCHC_GW_Stack_L2 *stack_ptr, int retTimer, uint8_t ackReqAttempts)
+uint8_t SCHC_GW_Ack_on_error::init(uint32_t device, uint8_t ruleID, uint8_t dTag, uint8_t windowSize, uint8_t tileSize, uint8_t n, uint8_t m, uint8_t ackMode, SCHC_GW_Stack_L2 *stack_ptr, int retTimer, uint8_t ackReqAttempts)
 {
     SPDLOG_TRACE("Entering the function");
 
@@ -27,7 +28,7 @@ uint8_t SCHC_GW_Ack_on_error::init(string dev_id, uint8_t ruleID, uint8_t dTag,
     _retransTimer       = retTimer;                 // in minutes. In LoRaWAN: 12*60*60 minutes
     _maxAckReq          = ackReqAttempts;           // in minutes. In LoRaWAN: 12*60*60 minutes
     _last_window        = 0;
-    _dev_id             = dev_id;
+    _device             = device;
     _processing.store(false);
     _rcs                = 0;
 
@@ -35,6 +36,8 @@ uint8_t SCHC_GW_Ack_on_error::init(string dev_id, uint8_t ruleID, uint8_t dTag,
     /* Dynamic SCHC parameters */
     _currentState           = STATE_RX_INIT;
     _currentTile_ptr        = 0;
+    _rcs_prefix_crc         = SCHC_GW_CRC32::init();
+    _rcs_prefix_tiles       = 0;
     _last_confirmed_window  = 0;
 
 
@@ -43,20 +46,17 @@ uint8_t SCHC_GW_Ack_on_error::init(string dev_id, uint8_t ruleID, uint8_t dTag,
     _stack = stack_ptr;
 
 
-    /* Thread and Queue Message*/
+    /* La maquina es ejecutada por un worker del SCHC_GW_Worker_Pool */
     _processing.store(true);
-    auto self       = shared_from_this();     // Crear un shared_ptr que apunta a este objeto
-    _process_thread = thread(&SCHC_GW_Ack_on_error::thread_entry_point, self);
-    _process_thread.detach();           // Desatachar el hilo para que sea independiente
 
 
     /* Flags */
     _wait_pull_ack_req_flag     = false;
     _first_ack_sent_flag        = false;
+    _all1_received_flag         = false;
 
 
-    /* Contador para saber que mensaje eliminar de forma manual*/
-    _counter = 1;
+    /* Las perdidas simuladas se reinician en set_loss_pattern() */
 
     SPDLOG_TRACE("Leaving the function");
 
@@ -69,6 +69,9 @@ uint8_t SCHC_GW_Ack_on_error::execute_machine(int rule_id, char *msg, int len)
 
     if(msg!=NULL)
     {
+        SCHC_GW_Message decoder;
+        SCHC_GW_Metrics::add_received(decoder.get_msg_type(SCHC_FRAG_LORAWAN, rule_id, msg, len));
+
         if(_currentState==STATE_RX_INIT)
         {
             SPDLOG_DEBUG("Calling to RX_INIT_recv_fragments() method");
@@ -112,70 +115,10 @@ uint8_t SCHC_GW_Ack_on_error::execute_machine(int rule_id, char *msg, int len)
     return 0;
 }
 
-uint8_t SCHC_GW_Ack_on_error::queue_message(int rule_id, char *msg, int len)
-{
-    _queue.push(rule_id, msg, len);
-    return 0;
-}
-
-void SCHC_GW_Ack_on_error::thread_entry_point(shared_ptr<SCHC_GW_Ack_on_error> instance)
+void SCHC_GW_Ack_on_error::set_loss_pattern(const SCHC_GW_Loss_Pattern& loss_pattern, uint64_t seed)
 {
-    if (instance)
-    {
-        instance->message_reception_loop();
-    }
-}
-
-void SCHC_GW_Ack_on_error::set_error_prob(uint8_t error_prob)
-{
-    this->_error_prob = error_prob;
-}
-
-void SCHC_GW_Ack_on_error::message_reception_loop()
-{
-    SPDLOG_INFO("Entering message_reception_loop()");
-    while(_processing.load())
-    {
-        if(_queue.size() != 0)
-        {
-            SPDLOG_DEBUG(">>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>");
-            SPDLOG_DEBUG("\033[32mExtracting message from the queue.\033[0m");
-            SPDLOG_DEBUG("Current queue size: {}", _queue.size());
-            char* msg = nullptr;
-            int len;
-            _queue.pop(_ruleID, msg, len);
-            this->execute_machine(_ruleID, msg, len);
-        }
-        
-        this_thread::sleep_for(chrono::milliseconds(100));
-    }
-
-    // Llamar al callback al finalizar
-    if (_end_callback)
-    {
-        SPDLOG_WARN("Releasing memory resources in the state machine");
-        /* Liberando memoria de _tailArray*/
-        for(int i = 0 ; i < _nTotalTiles ; i++ )
-        {
-            delete[] _tilesArray[i];
-        }
-        delete[] _tilesArray;
-
-        delete[] _last_tile;
-
-        /* Liberando memoria de _bitmapArray*/
-        for(int i = 0 ; i < _nMaxWindows ; i++)
-        {
-            delete[] _bitmapArray[i];
-        }
-        delete[] _bitmapArray;
-
-        _end_callback();
-    }
-
-    SPDLOG_WARN("\033[1mThread finished\033[0m");
-    SPDLOG_WARN("");
-    return;
+    _loss_pattern = loss_pattern;
+    _loss_pattern.reset(seed);
 }
 
 bool SCHC_GW_Ack_on_error::is_processing()
@@ -190,50 +133,19 @@ void SCHC_GW_Ack_on_error::set_end_callback(function<void()> callback)
 
 uint8_t SCHC_GW_Ack_on_error::RX_INIT_recv_fragments(int rule_id, char *msg, int len)
 {
-    /* memory allocated for pointers of each tile. */
-    _tilesArray = new char*[_nTotalTiles];          // * Liberada en SCHC_GW_Ack_on_error::destroy_machine()
-
-    /* memory allocated for the bytes for each tile. */  
-    for(int i = 0 ; i < _nTotalTiles ; i++ )
-    {
-        _tilesArray[i] = new char[_tileSize];       // * Liberada en SCHC_GW_Ack_on_error::destroy_machine()
-    }
-
-    /* Setting all tiles in 0x00 (for good printing in string format) */
-    for(int i = 0 ; i < _nTotalTiles ; i++ )
-    {
-        for(int j=0; j < _tileSize; j++)
-        {
-            _tilesArray[i][j] = 0x00;
-        }
-    }
-
-
-    /* memory allocated for the bytes for the last tile. */  
-    _last_tile = new char[_tileSize];       // * Liberada en SCHC_GW_Ack_on_error::destroy_machine()
-    for(int i=0; i < _tileSize; i++)
-        {
-            _last_tile[i] = 0x00;
-        }
-
+    /* Una sola reserva de memoria por sesion, alineada a la linea de cache:
+       [ bitmaps: _nMaxWindows*8 | tiles: _nTotalTiles*_tileSize | ultimo tile: _tileSize ]
+       Los bitmaps van primero para quedar alineados a 8 bytes. Los tiles quedan contiguos,
+       por lo que el paquete no se debe reconstruir al final */
+    size_t bitmaps_size = _nMaxWindows * sizeof(uint64_t);
+    size_t tiles_size   = _nTotalTiles * _tileSize;
+    size_t arena_size   = bitmaps_size + tiles_size + _tileSize;
+    _reassembly         = new (std::align_val_t(SCHC_REASSEMBLY_ALIGN)) char[arena_size];   // * Liberada en SCHC_GW_Ack_on_error::free_reassembly()
+    memset(_reassembly, 0x00, arena_size);  // tiles en 0x00 (para imprimirlos) y bitmaps en 0
 
-    /* memory allocated for pointers of each bitmap. */
-    _bitmapArray = new uint8_t*[_nMaxWindows];      // * Liberada en SCHC_GW_Ack_on_error::destroy_machine()
-
-    /* memory allocated for the 1s and 0s for each bitmap. */ 
-    for(int i = 0 ; i < _nMaxWindows ; i++ )
-    {
-        _bitmapArray[i] = new uint8_t[_windowSize]; // * Liberada en SCHC_GW_Ack_on_error::destroy_machine()
-    }
-
-    /* Setting all bitmaps in 0*/
-    for(int i=0; i<_nMaxWindows; i++)
-    {
-        for(int j = 0 ; j < _windowSize ; j++)
-        {
-            _bitmapArray[i][j] = 0;
-        }
-    }
+    _bitmapArray    = reinterpret_cast<uint64_t*>(_reassembly);
+    _tilesArray     = _reassembly + bitmaps_size;
+    _last_tile      = _reassembly + bitmaps_size + tiles_size;
 
 
     SPDLOG_INFO("Changing STATE: From STATE_RX_INIT --> STATE_RX_RCV_WINDOW");
@@ -259,19 +171,13 @@ uint8_t SCHC_GW_Ack_on_error::RX_RCV_WIN_recv_fragments(int rule_id, char *msg,
     {
         if(msg_type == SCHC_REGULAR_FRAGMENT_MSG)
         {
-            /* Codigo para poder eliminar mensajes de entrada */
-            // random_device rd;
-            // mt19937 gen(rd());
-            // uniform_int_distribution<int> dist(0, 100);
-            // int random_number = dist(gen);
-            // //if(random_number < _error_prob)
-            if(_counter == 2 || _counter == 4)
+            /* Perdidas simuladas de fragmentos (loss_pattern) */
+            if(_loss_pattern.drop())
             {
-                    SPDLOG_WARN("\033[31mMessage discarded due to error probability\033[0m");   
-                    _counter++;
+                    SPDLOG_WARN("\033[31mMessage discarded by the loss pattern\033[0m");
+                    SCHC_GW_Metrics::add(SCHC_GW_METRIC_FRAGMENTS_DROPPED);
                     return 0;
             }
-            _counter++;
             
 
             SPDLOG_DEBUG("Receiving a SCHC Regular fragment");
@@ -285,9 +191,8 @@ uint8_t SCHC_GW_Ack_on_error::RX_RCV_WIN_recv_fragments(int rule_id, char *msg,
             fcn             = decoder.get_fcn();
             w               = decoder.get_w();
 
-            /* Creacion de buffer para almacenar el schc payload del SCHC fragment */
-            char* payload   = new char[payload_len/8];          // * Liberada en linea 158
-            decoder.get_schc_payload(payload);                  // obtiene el SCHC payload
+            /* Los tiles se copian directamente desde el mensaje al _tilesArray */
+            const char* payload = decoder.get_schc_payload_view();
 
 
             /* Obteniendo la cantidad de tiles en el mensaje */
@@ -300,10 +205,13 @@ uint8_t SCHC_GW_Ack_on_error::RX_RCV_WIN_recv_fragments(int rule_id, char *msg,
 
             for(int i=0; i<tiles_in_payload; i++)
             {
-                memcpy(_tilesArray[tile_ptr + i], payload + (i*_tileSize), _tileSize);  // se almacenan los bytes de un tile recibido
-                _bitmapArray[w][bitmap_ptr + i] = 1;                                    // en el bitmap, se establece en 1 los correspondientes tiles recibidos
+                memcpy(get_tile(tile_ptr + i), payload + (i*_tileSize), _tileSize);  // se almacenan los bytes de un tile recibido
+                set_bitmap_bit(w, bitmap_ptr + i);                                    // en el bitmap, se establece en 1 los correspondientes tiles recibidos
             }
-            delete[] payload;
+
+            /* Los tiles entre el ultimo tile esperado y este fragmento se perdieron */
+            if(tile_ptr > _currentTile_ptr)
+                SCHC_GW_Metrics::add(SCHC_GW_METRIC_TILES_LOST, tile_ptr - _currentTile_ptr);
 
             /* Se almacena el puntero al siguiente tile esperado */
             if((tile_ptr + tiles_in_payload) > _currentTile_ptr)
@@ -315,12 +223,13 @@ uint8_t SCHC_GW_Ack_on_error::RX_RCV_WIN_recv_fragments(int rule_id, char *msg,
             {
                 SPDLOG_DEBUG("_currentTile_ptr is not updated. The previous value is kept {}", _currentTile_ptr);
             }
+
+            /* Se avanza el CRC sobre el prefijo contiguo de tiles recibidos */
+            this->update_rcs_prefix();
                 
             
             /* Se imprime mensaje de la llegada de un SCHC fragment*/
-            spdlog::set_pattern("[%H:%M:%S.%e][%^%L%$][%t] %v");
-            SPDLOG_WARN("|--- W={:<1}, FCN={:<2} --->| {:>2} tiles", w, fcn, tiles_in_payload);
-            spdlog::set_pattern("[%H:%M:%S.%e][%^%L%$][%t][%-8!s][%-8!!] %v");
+            SCHC_GW_TRACE(fragment(w, fcn, tiles_in_payload));
 
 
             /* Una forma de saber que la ventana de transmisión 
@@ -331,17 +240,13 @@ uint8_t SCHC_GW_Ack_on_error::RX_RCV_WIN_recv_fragments(int rule_id, char *msg,
                 SPDLOG_DEBUG("Sending SCHC ACK");
                 SCHC_GW_Message    encoder;
                 uint8_t c                   = this->get_c_from_bitmap(w);    // obtiene el valor de c en base al _bitmap_array
-                vector bitmap_vector   = this->get_bitmap_array_vec(w); // obtiene el bitmap expresado como un arreglo de char    
                 int len;
-                char* buffer                = nullptr;
-                encoder.create_schc_ack(_ruleID, dtag, w, c, bitmap_vector, buffer, len);
+                char buffer[SCHC_ACK_MAX_LEN];
+                encoder.create_schc_ack(_ruleID, dtag, w, c, _bitmapArray[w], _windowSize, buffer, len);
 
-                _stack->send_downlink_frame(_dev_id, SCHC_FRAG_UPDIR_RULE_ID, buffer, len);
-                delete[] buffer;
+                _stack->send_downlink_frame(_device, SCHC_FRAG_UPDIR_RULE_ID, buffer, len);
 
-                spdlog::set_pattern("[%H:%M:%S.%e][%^%L%$][%t] %v");
-                SPDLOG_WARN("|<-- ACK, W={:<1}, C={:<1} --| Bitmap:{}", w, c, get_bitmap_array_str(w));
-                spdlog::set_pattern("[%H:%M:%S.%e][%^%L%$][%t][%-8!s][%-8!!] %v");
+                SCHC_GW_TRACE(ack(w, c, _bitmapArray[w], _windowSize));
 
                 if(c==0)
                 {
@@ -359,9 +264,6 @@ uint8_t SCHC_GW_Ack_on_error::RX_RCV_WIN_recv_fragments(int rule_id, char *msg,
         }
         else if(msg_type == SCHC_ALL1_FRAGMENT_MSG)
         {
-            // SPDLOG_WARN("\033[31mMessage discarded due to error probability\033[0m");   
-            // return 0;
-
             /* Una forma de saber que la ventana de transmisión 
              ya ha finalizado es recibiendo un All-1. En ese caso 
              se debe enviar un ACK */
@@ -379,26 +281,20 @@ uint8_t SCHC_GW_Ack_on_error::RX_RCV_WIN_recv_fragments(int rule_id, char *msg,
 
             if(rcs_result)  // * Integrity check: success
             {
-                spdlog::set_pattern("[%H:%M:%S.%e][%^%L%$][%t] %v");
-                SPDLOG_WARN("|- W={:<1}, FCN={:<2}+RCS ->| {:>2} bits - Integrity check: success", w, fcn, _lastTileSize);
-                spdlog::set_pattern("[%H:%M:%S.%e][%^%L%$][%t][%-8!s][%-8!!] %v");
+                SCHC_GW_TRACE(all1(w, fcn, _lastTileSize, true));
 
-                _bitmapArray[w][_windowSize-1] = 1;
+                set_bitmap_bit(w, _windowSize-1);
 
                 SPDLOG_DEBUG("Sending SCHC ACK");
                 SCHC_GW_Message encoder;
                 uint8_t c                   = 1;                     // obtiene el valor de c en base al _bitmap_array
-                vector bitmap_vector   = this->get_bitmap_array_vec(w); // obtiene el bitmap expresado como un arreglo de char    
                 int len;
-                char* buffer                = nullptr;
-                encoder.create_schc_ack(_ruleID, dtag, w, c, bitmap_vector, buffer, len);
+                char buffer[SCHC_ACK_MAX_LEN];
+                encoder.create_schc_ack(_ruleID, dtag, w, c, _bitmapArray[w], _windowSize, buffer, len);
 
-                _stack->send_downlink_frame(_dev_id, SCHC_FRAG_UPDIR_RULE_ID, buffer, len);
-                delete[] buffer;
+                _stack->send_downlink_frame(_device, SCHC_FRAG_UPDIR_RULE_ID, buffer, len);
 
-                spdlog::set_pattern("[%H:%M:%S.%e][%^%L%$][%t] %v");
-                SPDLOG_WARN("|<-- ACK, W={:<1}, C={:<1} --| Bitmap:{}", w, c, get_bitmap_array_str(w));
-                spdlog::set_pattern("[%H:%M:%S.%e][%^%L%$][%t][%-8!s][%-8!!] %v");
+                SCHC_GW_TRACE(ack(w, c, _bitmapArray[w], _windowSize));
 
                 SPDLOG_INFO("Changing STATE: From STATE_RX_RCV_WINDOW --> STATE_RX_END");
                 _currentState = STATE_RX_END;
@@ -406,27 +302,22 @@ uint8_t SCHC_GW_Ack_on_error::RX_RCV_WIN_recv_fragments(int rule_id, char *msg,
             }
             else                // * Integrity check: failure
             {
-                spdlog::set_pattern("[%H:%M:%S.%e][%^%L%$][%t] %v");
-                SPDLOG_WARN("|- W={:<1}, FCN={:<2}+RCS ->| {:>2} bits - Integrity check: failure", w, fcn, _lastTileSize);
-                spdlog::set_pattern("[%H:%M:%S.%e][%^%L%$][%t][%-8!s][%-8!!] %v");
+                SCHC_GW_TRACE(all1(w, fcn, _lastTileSize, false));
+                SCHC_GW_Metrics::add(SCHC_GW_METRIC_RCS_FAILURES);
 
-                _bitmapArray[w][_windowSize-1] = 1;
+                set_bitmap_bit(w, _windowSize-1);
 
                 SPDLOG_DEBUG("Sending SCHC ACK");
                 SCHC_GW_Message         encoder;
                 int                     len;
                 uint8_t c               = 0;
-                vector bitmap_vector    = this->get_bitmap_array_vec(w); 
-                char* buffer            = nullptr;
+                char buffer[SCHC_ACK_MAX_LEN];
 
-                encoder.create_schc_ack(_ruleID, dtag, w, c, bitmap_vector, buffer, len, false);
+                encoder.create_schc_ack(_ruleID, dtag, w, c, _bitmapArray[w], _windowSize, buffer, len, false);
 
-                _stack->send_downlink_frame(_dev_id, SCHC_FRAG_UPDIR_RULE_ID, buffer, len);
-                delete[] buffer;
+                _stack->send_downlink_frame(_device, SCHC_FRAG_UPDIR_RULE_ID, buffer, len);
 
-                spdlog::set_pattern("[%H:%M:%S.%e][%^%L%$][%t] %v");
-                SPDLOG_WARN("|<-- ACK, W={:<1}, C={:<1} --| Bitmap:{}", w, c, get_bitmap_array_str(w));
-                spdlog::set_pattern("[%H:%M:%S.%e][%^%L%$][%t][%-8!s][%-8!!] %v");
+                SCHC_GW_TRACE(ack(w, c, _bitmapArray[w], _windowSize));
 
                 SPDLOG_INFO("Changing STATE: From STATE_RX_RCV_WINDOW --> STATE_RX_WAIT_x_MISSING_FRAGS");
                 _currentState = STATE_RX_WAIT_x_MISSING_FRAGS;
@@ -444,9 +335,7 @@ uint8_t SCHC_GW_Ack_on_error::RX_RCV_WIN_recv_fragments(int rule_id, char *msg,
                 decoder.decode_message(SCHC_FRAG_LORAWAN, rule_id, msg, len);
                 w               = decoder.get_w();
 
-                spdlog::set_pattern("[%H:%M:%S.%e][%^%L%$][%t] %v");
-                SPDLOG_WARN("|--- ACK REQ, W={:<1} -->| pull ACK REQ discarded", w);
-                spdlog::set_pattern("[%H:%M:%S.%e][%^%L%$][%t][%-8!s][%-8!!] %v");
+                SCHC_GW_TRACE(ack_req(w, true));
                 _wait_pull_ack_req_flag = false;
             }
             else
@@ -463,9 +352,7 @@ uint8_t SCHC_GW_Ack_on_error::RX_RCV_WIN_recv_fragments(int rule_id, char *msg,
                 decoder.decode_message(SCHC_FRAG_LORAWAN, rule_id, msg, len);
                 w = decoder.get_w();
 
-                spdlog::set_pattern("[%H:%M:%S.%e][%^%L%$][%t] %v");
-                SPDLOG_WARN("|--- ACK REQ, W={:<1} -->| ", w);
-                spdlog::set_pattern("[%H:%M:%S.%e][%^%L%$][%t][%-8!s][%-8!!] %v");
+                SCHC_GW_TRACE(ack_req(w, false));
 
                 if(_first_ack_sent_flag == true)
                 {
@@ -478,18 +365,14 @@ uint8_t SCHC_GW_Ack_on_error::RX_RCV_WIN_recv_fragments(int rule_id, char *msg,
                     SPDLOG_DEBUG("Sending SCHC ACK");
                     SCHC_GW_Message    encoder;
                     uint8_t c                   = 1;
-                    vector bitmap_vector   = this->get_bitmap_array_vec(w); // obtiene el bitmap expresado como un arreglo de char    
-                    char* buffer                = nullptr;
+                    char buffer[SCHC_ACK_MAX_LEN];
                     int len;
                     
-                    encoder.create_schc_ack(_ruleID, dtag, w, c, bitmap_vector, buffer, len);
+                    encoder.create_schc_ack(_ruleID, dtag, w, c, _bitmapArray[w], _windowSize, buffer, len);
 
-                    _stack->send_downlink_frame(_dev_id, SCHC_FRAG_UPDIR_RULE_ID, buffer, len);
-                    delete[] buffer;
+                    _stack->send_downlink_frame(_device, SCHC_FRAG_UPDIR_RULE_ID, buffer, len);
 
-                    spdlog::set_pattern("[%H:%M:%S.%e][%^%L%$][%t] %v");
-                    SPDLOG_WARN("|<-- ACK, W={:<1}, C={:<1} --| Bitmap:{}", w, c, get_bitmap_array_str(w));
-                    spdlog::set_pattern("[%H:%M:%S.%e][%^%L%$][%t][%-8!s][%-8!!] %v");
+                    SCHC_GW_TRACE(ack(w, c, _bitmapArray[w], _windowSize));
 
                     _wait_pull_ack_req_flag = true;
 
@@ -503,18 +386,14 @@ uint8_t SCHC_GW_Ack_on_error::RX_RCV_WIN_recv_fragments(int rule_id, char *msg,
                     SPDLOG_DEBUG("Sending SCHC ACK");
                     SCHC_GW_Message    encoder;
                     uint8_t c                   = 0;
-                    vector bitmap_vector   = this->get_bitmap_array_vec(w); // obtiene el bitmap expresado como un arreglo de char    
-                    char* buffer                = nullptr;
+                    char buffer[SCHC_ACK_MAX_LEN];
                     int len;
                     
-                    encoder.create_schc_ack(_ruleID, dtag, w, c, bitmap_vector, buffer, len);
+                    encoder.create_schc_ack(_ruleID, dtag, w, c, _bitmapArray[w], _windowSize, buffer, len);
 
-                    _stack->send_downlink_frame(_dev_id, SCHC_FRAG_UPDIR_RULE_ID, buffer, len);
-                    delete[] buffer;
+                    _stack->send_downlink_frame(_device, SCHC_FRAG_UPDIR_RULE_ID, buffer, len);
 
-                    spdlog::set_pattern("[%H:%M:%S.%e][%^%L%$][%t] %v");
-                    SPDLOG_WARN("|<-- ACK, W={:<1}, C={:<1} --| Bitmap:{}", w, c, get_bitmap_array_str(w));
-                    spdlog::set_pattern("[%H:%M:%S.%e][%^%L%$][%t][%-8!s][%-8!!] %v");
+                    SCHC_GW_TRACE(ack(w, c, _bitmapArray[w], _windowSize));
 
                     SPDLOG_INFO("Changing STATE: From STATE_RX_RCV_WINDOW --> STATE_RX_WAIT_x_MISSING_FRAGS");
                     _currentState = STATE_RX_WAIT_x_MISSING_FRAGS;
@@ -536,20 +415,13 @@ uint8_t SCHC_GW_Ack_on_error::RX_RCV_WIN_recv_fragments(int rule_id, char *msg,
         {
             SPDLOG_DEBUG("Receiving a SCHC Regular fragment");
 
-            /* Codigo para poder eliminar mensajes de entrada */
-            // random_device rd;
-            // mt19937 gen(rd());
-            // uniform_int_distribution<int> dist(0, 100);
-            // int random_number = dist(gen);
-            
-            //if(random_number < _error_prob)
-            // if(_counter == 4)
-            // {
-            //         SPDLOG_WARN("\033[31mMessage discarded due to error probability\033[0m");   
-            //         _counter++;
-            //         return 0;
-            // }
-            // _counter++;
+            /* Perdidas simuladas de fragmentos (loss_pattern) */
+            if(_loss_pattern.drop())
+            {
+                    SPDLOG_WARN("\033[31mMessage discarded by the loss pattern\033[0m");
+                    SCHC_GW_Metrics::add(SCHC_GW_METRIC_FRAGMENTS_DROPPED);
+                    return 0;
+            }
 
             /* Decoding el SCHC fragment */
             decoder.decode_message(SCHC_FRAG_LORAWAN, rule_id, msg, len);
@@ -560,9 +432,8 @@ uint8_t SCHC_GW_Ack_on_error::RX_RCV_WIN_recv_fragments(int rule_id, char *msg,
             if(w > _last_window)
                 _last_window    = w;    // aseguro que el ultimo fragmento recibido va a marcar cual es la ultima ventana recibida
 
-            /* Creacion de buffer para almacenar el schc payload del SCHC fragment */
-            char* payload   = new char[payload_len/8];          // * Liberada en linea 158
-            decoder.get_schc_payload(payload);                  // obtiene el SCHC payload
+            /* Los tiles se copian directamente desde el mensaje al _tilesArray */
+            const char* payload = decoder.get_schc_payload_view();
 
             /* Obteniendo la cantidad de tiles en el mensaje */
             int tiles_in_payload = (payload_len/8)/_tileSize;
@@ -573,20 +444,23 @@ uint8_t SCHC_GW_Ack_on_error::RX_RCV_WIN_recv_fragments(int rule_id, char *msg,
 
             for(int i=0; i<tiles_in_payload; i++)
             {
-                memcpy(_tilesArray[tile_ptr + i], payload + (i*_tileSize), _tileSize);  // se almacenan los bytes de un tile recibido
+                memcpy(get_tile(tile_ptr + i), payload + (i*_tileSize), _tileSize);  // se almacenan los bytes de un tile recibido
                 
                 if((bitmap_ptr + i) > (_windowSize - 1))
                 {
                     /* ha finalizado la ventana w y ha comenzado la ventana w+1*/
-                    _bitmapArray[w+1][bitmap_ptr + i - _windowSize] = 1;
+                    set_bitmap_bit(w+1, bitmap_ptr + i - _windowSize);
                 }
                 else
                 {
-                    _bitmapArray[w][bitmap_ptr + i] = 1;
+                    set_bitmap_bit(w, bitmap_ptr + i);
                 }
                 
             }
-            delete[] payload;
+
+            /* Los tiles entre el ultimo tile esperado y este fragmento se perdieron */
+            if(tile_ptr > _currentTile_ptr)
+                SCHC_GW_Metrics::add(SCHC_GW_METRIC_TILES_LOST, tile_ptr - _currentTile_ptr);
 
             /* Se almacena el puntero al siguiente tile esperado */
             if((tile_ptr + tiles_in_payload) > _currentTile_ptr)
@@ -599,17 +473,15 @@ uint8_t SCHC_GW_Ack_on_error::RX_RCV_WIN_recv_fragments(int rule_id, char *msg,
                 SPDLOG_DEBUG("_currentTile_ptr is not updated. The previous value is kept {}", _currentTile_ptr);
             }
 
+            /* Se avanza el CRC sobre el prefijo contiguo de tiles recibidos */
+            this->update_rcs_prefix();
+
             /* Se imprime mensaje de la llegada de un SCHC fragment*/
-            spdlog::set_pattern("[%H:%M:%S.%e][%^%L%$][%t] %v");
-            SPDLOG_WARN("|--- W={:<1}, FCN={:<2} --->| {:>2} tiles", w, fcn, tiles_in_payload);
-            spdlog::set_pattern("[%H:%M:%S.%e][%^%L%$][%t][%-8!s][%-8!!] %v");
+            SCHC_GW_TRACE(fragment(w, fcn, tiles_in_payload));
             
         }
         else if(msg_type == SCHC_ALL1_FRAGMENT_MSG) 
         { 
-            // SPDLOG_WARN("\033[31mMessage discarded due to error probability\033[0m"); 
-            // return 0;
-
             SPDLOG_DEBUG("Receiving a SCHC All-1 message");
             decoder.decode_message(SCHC_FRAG_LORAWAN, rule_id, msg, len);
 
@@ -617,6 +489,7 @@ uint8_t SCHC_GW_Ack_on_error::RX_RCV_WIN_recv_fragments(int rule_id, char *msg,
             w               = decoder.get_w();
             _last_window    = w;
             _rcs            = decoder.get_rcs();
+            _all1_received_flag = true;
             fcn             = decoder.get_fcn();
             decoder.get_schc_payload(_last_tile);           // obtiene el SCHC payload
 
@@ -624,26 +497,20 @@ uint8_t SCHC_GW_Ack_on_error::RX_RCV_WIN_recv_fragments(int rule_id, char *msg,
 
             if(rcs_result)    // * Integrity check: success
             {
-                spdlog::set_pattern("[%H:%M:%S.%e][%^%L%$][%t] %v");
-                SPDLOG_WARN("|- W={:<1}, FCN={:<2}+RCS ->| {:>2} bits - Integrity check: success", w, fcn, _lastTileSize);
-                spdlog::set_pattern("[%H:%M:%S.%e][%^%L%$][%t][%-8!s][%-8!!] %v");
+                SCHC_GW_TRACE(all1(w, fcn, _lastTileSize, true));
 
-                _bitmapArray[w][_windowSize-1] = 1;
+                set_bitmap_bit(w, _windowSize-1);
 
                 SPDLOG_DEBUG("Sending SCHC ACK");
 
                 SCHC_GW_Message    encoder;
-                uint8_t c                   = get_c_from_bitmap(w);                     // obtiene el valor de c en base al _bitmap_array
-                vector bitmap_vector   = this->get_bitmap_array_vec(w); // obtiene el bitmap expresado como un arreglo de char    
+                uint8_t c                   = 1;                                        // el RCS es correcto: no faltan tiles (RFC 8724, 8.4.3)
                 int len;
-                char* buffer                = nullptr;
-                encoder.create_schc_ack(_ruleID, dtag, w, c, bitmap_vector, buffer, len);
-                _stack->send_downlink_frame(_dev_id, SCHC_FRAG_UPDIR_RULE_ID, buffer, len);
-                delete[] buffer;
+                char buffer[SCHC_ACK_MAX_LEN];
+                encoder.create_schc_ack(_ruleID, dtag, w, c, _bitmapArray[w], _windowSize, buffer, len);
+                _stack->send_downlink_frame(_device, SCHC_FRAG_UPDIR_RULE_ID, buffer, len);
 
-                spdlog::set_pattern("[%H:%M:%S.%e][%^%L%$][%t] %v");
-                SPDLOG_WARN("|<-- ACK, W={:<1}, C={:<1} --| Bitmap:{}", w, c, get_bitmap_array_str(w));
-                spdlog::set_pattern("[%H:%M:%S.%e][%^%L%$][%t][%-8!s][%-8!!] %v"); 
+                SCHC_GW_TRACE(ack(w, c, _bitmapArray[w], _windowSize));
 
                 SPDLOG_INFO("Changing STATE: From STATE_RX_RCV_WINDOW --> STATE_RX_END");
                 _currentState = STATE_RX_END;
@@ -651,17 +518,16 @@ uint8_t SCHC_GW_Ack_on_error::RX_RCV_WIN_recv_fragments(int rule_id, char *msg,
             }
             else                        // * Integrity check: failure
             {
-                spdlog::set_pattern("[%H:%M:%S.%e][%^%L%$][%t] %v");
-                SPDLOG_WARN("|- W={:<1}, FCN={:<2}+RCS ->| {:>2} bits - Integrity check: failure", w, fcn, _lastTileSize);
-                spdlog::set_pattern("[%H:%M:%S.%e][%^%L%$][%t][%-8!s][%-8!!] %v");
+                SCHC_GW_TRACE(all1(w, fcn, _lastTileSize, false));
+                SCHC_GW_Metrics::add(SCHC_GW_METRIC_RCS_FAILURES);
 
-                _bitmapArray[w][_windowSize-1] = 1;
+                set_bitmap_bit(w, _windowSize-1);
 
                 /* Revisa cual ventana tiene errores y envia un ACK para esa ventana */
                 for(int i = _last_confirmed_window; i<_last_window; i++)
                 {
                     int len;
-                    char* buffer                = nullptr;
+                    char buffer[SCHC_ACK_MAX_LEN];
                     uint8_t c                   = get_c_from_bitmap(i);
                     if(c == 0)
                     {
@@ -669,16 +535,12 @@ uint8_t SCHC_GW_Ack_on_error::RX_RCV_WIN_recv_fragments(int rule_id, char *msg,
 
                         SCHC_GW_Message    encoder;
                         _last_confirmed_window      = i;
-                        vector bitmap_vector   = this->get_bitmap_array_vec(i);
 
-                        encoder.create_schc_ack(_ruleID, dtag, i, c, bitmap_vector, buffer, len);
+                        encoder.create_schc_ack(_ruleID, dtag, i, c, _bitmapArray[i], _windowSize, buffer, len);
 
-                        _stack->send_downlink_frame(_dev_id, SCHC_FRAG_UPDIR_RULE_ID, buffer, len);
-                        delete[] buffer;
+                        _stack->send_downlink_frame(_device, SCHC_FRAG_UPDIR_RULE_ID, buffer, len);
 
-                        spdlog::set_pattern("[%H:%M:%S.%e][%^%L%$][%t] %v");
-                        SPDLOG_WARN("|<-- ACK, W={:<1}, C={:<1} --| Bitmap:{}", i, c, get_bitmap_array_str(i));
-                        spdlog::set_pattern("[%H:%M:%S.%e][%^%L%$][%t][%-8!s][%-8!!] %v");
+                        SCHC_GW_TRACE(ack(i, c, _bitmapArray[i], _windowSize));
 
                         SPDLOG_INFO("Changing STATE: From STATE_RX_RCV_WINDOW --> STATE_RX_WAIT_x_MISSING_FRAGS");
                         _currentState = STATE_RX_WAIT_x_MISSING_FRAGS;   
@@ -697,18 +559,14 @@ uint8_t SCHC_GW_Ack_on_error::RX_RCV_WIN_recv_fragments(int rule_id, char *msg,
                 Por lo tanto la ventana con errores es la última.*/
                 SPDLOG_DEBUG("Sending SCHC ACK");
                 SCHC_GW_Message    encoder;
-                vector bitmap_vector   = this->get_bitmap_array_vec(_last_window); // obtiene el bitmap expresado como un arreglo de char    
                 int len;
-                char* buffer                = nullptr;
+                char buffer[SCHC_ACK_MAX_LEN];
                 int c                       = 0;
-                encoder.create_schc_ack(_ruleID, dtag, _last_window, c, bitmap_vector, buffer, len);
+                encoder.create_schc_ack(_ruleID, dtag, _last_window, c, _bitmapArray[_last_window], _windowSize, buffer, len);
 
-                _stack->send_downlink_frame(_dev_id, SCHC_FRAG_UPDIR_RULE_ID, buffer, len);
-                delete[] buffer;
+                _stack->send_downlink_frame(_device, SCHC_FRAG_UPDIR_RULE_ID, buffer, len);
 
-                spdlog::set_pattern("[%H:%M:%S.%e][%^%L%$][%t] %v");
-                SPDLOG_WARN("|<-- ACK, W={:<1}, C={:<1} --| Bitmap:{}", _last_window, c, get_bitmap_array_str(_last_window));
-                spdlog::set_pattern("[%H:%M:%S.%e][%^%L%$][%t][%-8!s][%-8!!] %v");
+                SCHC_GW_TRACE(ack(_last_window, c, _bitmapArray[_last_window], _windowSize));
                 _last_confirmed_window = _last_window; 
 
                 SPDLOG_INFO("Changing STATE: From STATE_RX_RCV_WINDOW --> STATE_RX_WAIT_x_MISSING_FRAGS");
@@ -726,9 +584,7 @@ uint8_t SCHC_GW_Ack_on_error::RX_RCV_WIN_recv_fragments(int rule_id, char *msg,
                 decoder.decode_message(SCHC_FRAG_LORAWAN, rule_id, msg, len);
                 w               = decoder.get_w();
 
-                spdlog::set_pattern("[%H:%M:%S.%e][%^%L%$][%t] %v");
-                SPDLOG_WARN("|--- ACK REQ, W={:<1} -->| pull ACK REQ discarded", w);
-                spdlog::set_pattern("[%H:%M:%S.%e][%^%L%$][%t][%-8!s][%-8!!] %v");
+                SCHC_GW_TRACE(ack_req(w, true));
 
                 _wait_pull_ack_req_flag = false;
             }
@@ -738,9 +594,7 @@ uint8_t SCHC_GW_Ack_on_error::RX_RCV_WIN_recv_fragments(int rule_id, char *msg,
                 decoder.decode_message(SCHC_FRAG_LORAWAN, rule_id, msg, len);
                 uint8_t w_received          = decoder.get_w();
 
-                spdlog::set_pattern("[%H:%M:%S.%e][%^%L%$][%t] %v");
-                SPDLOG_WARN("|--- ACK REQ, W={:<1} -->| ", w_received);
-                spdlog::set_pattern("[%H:%M:%S.%e][%^%L%$][%t][%-8!s][%-8!!] %v");
+                SCHC_GW_TRACE(ack_req(w_received, false));
 
                 if(w_received > _last_window)
                     _last_window    = w_received;    // aseguro que el ultimo fragmento recibido va a marcar cual es la ultima ventana recibida
@@ -751,7 +605,7 @@ uint8_t SCHC_GW_Ack_on_error::RX_RCV_WIN_recv_fragments(int rule_id, char *msg,
                 for(int i = _last_confirmed_window; i<_last_window; i++)
                 {
                     int len;
-                    char* buffer                = nullptr;
+                    char buffer[SCHC_ACK_MAX_LEN];
                     uint8_t c                   = get_c_from_bitmap(i);
                     if(c == 0)
                     {
@@ -759,16 +613,12 @@ uint8_t SCHC_GW_Ack_on_error::RX_RCV_WIN_recv_fragments(int rule_id, char *msg,
 
                         SCHC_GW_Message    encoder;
                         _last_confirmed_window      = i;
-                        vector bitmap_vector   = this->get_bitmap_array_vec(i);
 
-                        encoder.create_schc_ack(_ruleID, dtag, i, c, bitmap_vector, buffer, len);
+                        encoder.create_schc_ack(_ruleID, dtag, i, c, _bitmapArray[i], _windowSize, buffer, len);
 
-                        _stack->send_downlink_frame(_dev_id, SCHC_FRAG_UPDIR_RULE_ID, buffer, len);
-                        delete[] buffer;
+                        _stack->send_downlink_frame(_device, SCHC_FRAG_UPDIR_RULE_ID, buffer, len);
 
-                        spdlog::set_pattern("[%H:%M:%S.%e][%^%L%$][%t] %v");
-                        SPDLOG_WARN("|<-- ACK, W={:<1}, C={:<1} --| Bitmap:{}", i, c, get_bitmap_array_str(i));
-                        spdlog::set_pattern("[%H:%M:%S.%e][%^%L%$][%t][%-8!s][%-8!!] %v");
+                        SCHC_GW_TRACE(ack(i, c, _bitmapArray[i], _windowSize));
 
                         SPDLOG_INFO("Changing STATE: From STATE_RX_RCV_WINDOW --> STATE_RX_WAIT_x_MISSING_FRAGS");
                         _currentState = STATE_RX_WAIT_x_MISSING_FRAGS;   
@@ -787,18 +637,14 @@ uint8_t SCHC_GW_Ack_on_error::RX_RCV_WIN_recv_fragments(int rule_id, char *msg,
                 Por lo tanto la ventana con errores es la última.*/
                 SPDLOG_DEBUG("Sending SCHC ACK");
                 SCHC_GW_Message    encoder;
-                vector bitmap_vector   = this->get_bitmap_array_vec(_last_window); // obtiene el bitmap expresado como un arreglo de char    
                 int len;
-                char* buffer                = nullptr;
+                char buffer[SCHC_ACK_MAX_LEN];
                 int c                       = 0;
-                encoder.create_schc_ack(_ruleID, dtag, _last_window, c, bitmap_vector, buffer, len);
+                encoder.create_schc_ack(_ruleID, dtag, _last_window, c, _bitmapArray[_last_window], _windowSize, buffer, len);
 
-                _stack->send_downlink_frame(_dev_id, SCHC_FRAG_UPDIR_RULE_ID, buffer, len);
-                delete[] buffer;
+                _stack->send_downlink_frame(_device, SCHC_FRAG_UPDIR_RULE_ID, buffer, len);
 
-                spdlog::set_pattern("[%H:%M:%S.%e][%^%L%$][%t] %v");
-                SPDLOG_WARN("|<-- ACK, W={:<1}, C={:<1} --| Bitmap:{}", _last_window, c, get_bitmap_array_str(_last_window));
-                spdlog::set_pattern("[%H:%M:%S.%e][%^%L%$][%t][%-8!s][%-8!!] %v");
+                SCHC_GW_TRACE(ack(_last_window, c, _bitmapArray[_last_window], _windowSize));
                 _last_confirmed_window = _last_window; 
 
                 SPDLOG_INFO("Changing STATE: From STATE_RX_RCV_WINDOW --> STATE_RX_WAIT_x_MISSING_FRAGS");
@@ -820,19 +666,13 @@ uint8_t SCHC_GW_Ack_on_error::RX_RCV_WIN_recv_fragments(int rule_id, char *msg,
         {
             SPDLOG_DEBUG("Receiving a SCHC Regular fragment");
 
-            /* Codigo para poder eliminar mensajes de entrada */
-            // random_device rd;
-            // mt19937 gen(rd());
-            // uniform_int_distribution<int> dist(0, 100);
-            // int random_number = dist(gen);
-            //if(random_number < _error_prob)
-            if(_counter == 3 || _counter == 5)
+            /* Perdidas simuladas de fragmentos (loss_pattern) */
+            if(_loss_pattern.drop())
             {
-                    SPDLOG_WARN("\033[31mMessage discarded due to error probability\033[0m");   
-                    _counter++;
+                    SPDLOG_WARN("\033[31mMessage discarded by the loss pattern\033[0m");
+                    SCHC_GW_Metrics::add(SCHC_GW_METRIC_FRAGMENTS_DROPPED);
                     return 0;
             }
-            _counter++;
 
             /* Decoding el SCHC fragment */
             decoder.decode_message(SCHC_FRAG_LORAWAN, rule_id, msg, len);
@@ -843,9 +683,8 @@ uint8_t SCHC_GW_Ack_on_error::RX_RCV_WIN_recv_fragments(int rule_id, char *msg,
             if(w > _last_window)
                 _last_window    = w;    // aseguro que el ultimo fragmento recibido va a marcar cual es la ultima ventana recibida
 
-            /* Creacion de buffer para almacenar el schc payload del SCHC fragment */
-            char* payload   = new char[payload_len/8];          // * Liberada en linea 158
-            decoder.get_schc_payload(payload);                  // obtiene el SCHC payload
+            /* Los tiles se copian directamente desde el mensaje al _tilesArray */
+            const char* payload = decoder.get_schc_payload_view();
 
             /* Obteniendo la cantidad de tiles en el mensaje */
             int tiles_in_payload = (payload_len/8)/_tileSize;
@@ -856,20 +695,23 @@ uint8_t SCHC_GW_Ack_on_error::RX_RCV_WIN_recv_fragments(int rule_id, char *msg,
 
             for(int i=0; i<tiles_in_payload; i++)
             {
-                memcpy(_tilesArray[tile_ptr + i], payload + (i*_tileSize), _tileSize);  // se almacenan los bytes de un tile recibido
+                memcpy(get_tile(tile_ptr + i), payload + (i*_tileSize), _tileSize);  // se almacenan los bytes de un tile recibido
                 
                 if((bitmap_ptr + i) > (_windowSize - 1))
                 {
                     /* ha finalizado la ventana w y ha comenzado la ventana w+1*/
-                    _bitmapArray[w+1][bitmap_ptr + i - _windowSize] = 1;
+                    set_bitmap_bit(w+1, bitmap_ptr + i - _windowSize);
                 }
                 else
                 {
-                    _bitmapArray[w][bitmap_ptr + i] = 1;
+                    set_bitmap_bit(w, bitmap_ptr + i);
                 }
                 
             }
-            delete[] payload;
+
+            /* Los tiles entre el ultimo tile esperado y este fragmento se perdieron */
+            if(tile_ptr > _currentTile_ptr)
+                SCHC_GW_Metrics::add(SCHC_GW_METRIC_TILES_LOST, tile_ptr - _currentTile_ptr);
 
             /* Se almacena el puntero al siguiente tile esperado */
             if((tile_ptr + tiles_in_payload) > _currentTile_ptr)
@@ -882,17 +724,15 @@ uint8_t SCHC_GW_Ack_on_error::RX_RCV_WIN_recv_fragments(int rule_id, char *msg,
                 SPDLOG_DEBUG("_currentTile_ptr is not updated. The previous value is kept {}", _currentTile_ptr);
             }
 
+            /* Se avanza el CRC sobre el prefijo contiguo de tiles recibidos */
+            this->update_rcs_prefix();
+
             /* Se imprime mensaje de la llegada de un SCHC fragment*/
-            spdlog::set_pattern("[%H:%M:%S.%e][%^%L%$][%t] %v");
-            SPDLOG_WARN("|--- W={:<1}, FCN={:<2} --->| {:>2} tiles", w, fcn, tiles_in_payload);
-            spdlog::set_pattern("[%H:%M:%S.%e][%^%L%$][%t][%-8!s][%-8!!] %v");
+            SCHC_GW_TRACE(fragment(w, fcn, tiles_in_payload));
             
         }        
         else if(msg_type == SCHC_ALL1_FRAGMENT_MSG) 
         { 
-            SPDLOG_WARN("\033[31mMessage discarded due to error probability\033[0m"); 
-            return 0;
-
             SPDLOG_DEBUG("Receiving a SCHC All-1 message");
             decoder.decode_message(SCHC_FRAG_LORAWAN, rule_id, msg, len);
 
@@ -901,31 +741,26 @@ uint8_t SCHC_GW_Ack_on_error::RX_RCV_WIN_recv_fragments(int rule_id, char *msg,
             _last_window                    = w;
             _rcs                            = decoder.get_rcs();
             fcn                             = decoder.get_fcn();
-            _bitmapArray[w][_windowSize-1]  = 1;
+            set_bitmap_bit(w, _windowSize-1);
             decoder.get_schc_payload(_last_tile);           // obtiene el SCHC payload
             
 
             bool rcs_result = this->check_rcs(_rcs);
             if(rcs_result)    // * Integrity check: success
             {
-                spdlog::set_pattern("[%H:%M:%S.%e][%^%L%$][%t] %v");
-                SPDLOG_WARN("|- W={:<1}, FCN={:<2}+RCS ->| {:>2} bits - Integrity check: success", w, fcn, _lastTileSize);
-                spdlog::set_pattern("[%H:%M:%S.%e][%^%L%$][%t][%-8!s][%-8!!] %v");    
+                SCHC_GW_TRACE(all1(w, fcn, _lastTileSize, true));
 
                 SPDLOG_DEBUG("Sending SCHC Compound ACK");
 
                 SCHC_GW_Message    encoder;
                 int len;
-                char* buffer    = nullptr;
-                vector<uint8_t> windows_with_error;   // vector vacío
+                char buffer[SCHC_ACK_MAX_LEN];
+                uint8_t windows_with_error = 0;   // ninguna ventana con error
                 encoder.create_schc_ack_compound(_ruleID, dtag, _last_window, windows_with_error, _bitmapArray, _windowSize, buffer, len);
 
-                _stack->send_downlink_frame(_dev_id, SCHC_FRAG_UPDIR_RULE_ID, buffer, len);
-                delete[] buffer;
+                _stack->send_downlink_frame(_device, SCHC_FRAG_UPDIR_RULE_ID, buffer, len);
 
-                spdlog::set_pattern("[%H:%M:%S.%e][%^%L%$][%t] %v");
-                SPDLOG_WARN("|<-- ACK, C=1 -------| {}", encoder.get_compound_bitmap_str());
-                spdlog::set_pattern("[%H:%M:%S.%e][%^%L%$][%t][%-8!s][%-8!!] %v");
+                SCHC_GW_TRACE(compound_ack(1, windows_with_error, _bitmapArray, _windowSize));
 
                 SPDLOG_INFO("Changing STATE: From STATE_RX_RCV_WINDOW --> STATE_RX_END");
                 _currentState = STATE_RX_END;
@@ -933,35 +768,31 @@ uint8_t SCHC_GW_Ack_on_error::RX_RCV_WIN_recv_fragments(int rule_id, char *msg,
             }
             else              // * Integrity check: failure
             {
-                spdlog::set_pattern("[%H:%M:%S.%e][%^%L%$][%t] %v");
-                SPDLOG_WARN("|- W={:<1}, FCN={:<2}+RCS ->| {:>2} bits - Integrity check: failure", w, fcn, _lastTileSize);
-                spdlog::set_pattern("[%H:%M:%S.%e][%^%L%$][%t][%-8!s][%-8!!] %v");
+                SCHC_GW_TRACE(all1(w, fcn, _lastTileSize, false));
+                SCHC_GW_Metrics::add(SCHC_GW_METRIC_RCS_FAILURES);
 
 
                 SPDLOG_DEBUG("Sending SCHC Compound ACK");
 
                 /* Revisa si alguna ventana tiene tiles perdidos */
-                vector<uint8_t> windows_with_error;
+                uint8_t windows_with_error = 0;
                 for(int i=0; i < _last_window; i++)
                 {
                     int c = this->get_c_from_bitmap(i);
                     if(c == 0)
-                        windows_with_error.push_back(i);
+                        windows_with_error |= (1 << i);
                 }
-                windows_with_error.push_back(_last_window);
+                windows_with_error |= (1 << _last_window);
          
 
                 SCHC_GW_Message    encoder;
                 int len;
-                char* buffer    = nullptr;
+                char buffer[SCHC_ACK_MAX_LEN];
                 encoder.create_schc_ack_compound(_ruleID, dtag, _last_window, windows_with_error, _bitmapArray, _windowSize, buffer, len);
 
-                _stack->send_downlink_frame(_dev_id, SCHC_FRAG_UPDIR_RULE_ID, buffer, len);
-                delete[] buffer;
+                _stack->send_downlink_frame(_device, SCHC_FRAG_UPDIR_RULE_ID, buffer, len);
 
-                spdlog::set_pattern("[%H:%M:%S.%e][%^%L%$][%t] %v");
-                SPDLOG_WARN("|<-- ACK, C=0 -------| {}", encoder.get_compound_bitmap_str());
-                spdlog::set_pattern("[%H:%M:%S.%e][%^%L%$][%t][%-8!s][%-8!!] %v");
+                SCHC_GW_TRACE(compound_ack(0, windows_with_error, _bitmapArray, _windowSize));
 
                 SPDLOG_INFO("Changing STATE: From STATE_RX_RCV_WINDOW --> STATE_RX_WAIT_x_MISSING_FRAGS");
                 _currentState = STATE_RX_WAIT_x_MISSING_FRAGS; 
@@ -980,9 +811,7 @@ uint8_t SCHC_GW_Ack_on_error::RX_RCV_WIN_recv_fragments(int rule_id, char *msg,
                 decoder.decode_message(SCHC_FRAG_LORAWAN, rule_id, msg, len);
                 w               = decoder.get_w();
 
-                spdlog::set_pattern("[%H:%M:%S.%e][%^%L%$][%t] %v");
-                SPDLOG_WARN("|--- ACK REQ, W={:<1} -->| pull ACK REQ discarded", w);
-                spdlog::set_pattern("[%H:%M:%S.%e][%^%L%$][%t][%-8!s][%-8!!] %v");
+                SCHC_GW_TRACE(ack_req(w, true));
                 _wait_pull_ack_req_flag = false;
             }
             else
@@ -991,9 +820,7 @@ uint8_t SCHC_GW_Ack_on_error::RX_RCV_WIN_recv_fragments(int rule_id, char *msg,
                 decoder.decode_message(SCHC_FRAG_LORAWAN, rule_id, msg, len);
                 uint8_t w_received          = decoder.get_w();
 
-                spdlog::set_pattern("[%H:%M:%S.%e][%^%L%$][%t] %v");
-                SPDLOG_WARN("|--- ACK REQ, W={:<1} -->| ", w_received);
-                spdlog::set_pattern("[%H:%M:%S.%e][%^%L%$][%t][%-8!s][%-8!!] %v");
+                SCHC_GW_TRACE(ack_req(w_received, false));
 
                 if(w_received > _last_window)
                     _last_window    = w_received;    // aseguro que el ultimo fragmento recibido va a marcar cual es la ultima ventana recibida
@@ -1005,16 +832,13 @@ uint8_t SCHC_GW_Ack_on_error::RX_RCV_WIN_recv_fragments(int rule_id, char *msg,
                     SPDLOG_DEBUG("Sending SCHC Compound ACK");
                     SCHC_GW_Message    encoder;
                     int len;
-                    char* buffer    = nullptr;
-                    vector<uint8_t> windows_with_error;   // vector vacío
+                    char buffer[SCHC_ACK_MAX_LEN];
+                    uint8_t windows_with_error = 0;   // ninguna ventana con error
                     encoder.create_schc_ack_compound(_ruleID, dtag, _last_window, windows_with_error, _bitmapArray, _windowSize, buffer, len);
 
-                    _stack->send_downlink_frame(_dev_id, SCHC_FRAG_UPDIR_RULE_ID, buffer, len);
-                    delete[] buffer;
+                    _stack->send_downlink_frame(_device, SCHC_FRAG_UPDIR_RULE_ID, buffer, len);
 
-                    spdlog::set_pattern("[%H:%M:%S.%e][%^%L%$][%t] %v");
-                    SPDLOG_WARN("|<-- ACK, C=1 -------| {}", encoder.get_compound_bitmap_str());
-                    spdlog::set_pattern("[%H:%M:%S.%e][%^%L%$][%t][%-8!s][%-8!!] %v");
+                    SCHC_GW_TRACE(compound_ack(1, windows_with_error, _bitmapArray, _windowSize));
 
                     SPDLOG_INFO("Changing STATE: From STATE_RX_RCV_WINDOW --> STATE_RX_END");
                     _currentState = STATE_RX_END;
@@ -1024,26 +848,23 @@ uint8_t SCHC_GW_Ack_on_error::RX_RCV_WIN_recv_fragments(int rule_id, char *msg,
                 {
                     SPDLOG_DEBUG("Sending SCHC Compound ACK");
                     /* Revisa si alguna ventana tiene tiles perdidos */
-                    vector<uint8_t> windows_with_error;
+                    uint8_t windows_with_error = 0;
                     for(int i=0; i < _last_window; i++)
                     {
                         int c = this->get_c_from_bitmap(i);
                         if(c == 0)
-                            windows_with_error.push_back(i);
+                            windows_with_error |= (1 << i);
                     }
-                    windows_with_error.push_back(_last_window);                       
+                    windows_with_error |= (1 << _last_window);                       
  
                     SCHC_GW_Message    encoder;
                     int len;
-                    char* buffer    = nullptr;
+                    char buffer[SCHC_ACK_MAX_LEN];
                     encoder.create_schc_ack_compound(_ruleID, dtag, _last_window, windows_with_error, _bitmapArray, _windowSize, buffer, len);
 
-                    _stack->send_downlink_frame(_dev_id, SCHC_FRAG_UPDIR_RULE_ID, buffer, len);
-                    delete[] buffer;
+                    _stack->send_downlink_frame(_device, SCHC_FRAG_UPDIR_RULE_ID, buffer, len);
 
-                    spdlog::set_pattern("[%H:%M:%S.%e][%^%L%$][%t] %v");
-                    SPDLOG_WARN("|<-- ACK, C=0 -------| {}", encoder.get_compound_bitmap_str());
-                    spdlog::set_pattern("[%H:%M:%S.%e][%^%L%$][%t][%-8!s][%-8!!] %v");
+                    SCHC_GW_TRACE(compound_ack(0, windows_with_error, _bitmapArray, _windowSize));
 
                     SPDLOG_INFO("Changing STATE: From STATE_RX_RCV_WINDOW --> STATE_RX_WAIT_x_MISSING_FRAGS");
                     _currentState = STATE_RX_WAIT_x_MISSING_FRAGS; 
@@ -1080,20 +901,21 @@ uint8_t SCHC_GW_Ack_on_error::RX_END_end_session(int rule_id, char *msg, int len
             decoder.decode_message(SCHC_FRAG_LORAWAN, rule_id, msg, len);
             w               = decoder.get_w();
 
-            spdlog::set_pattern("[%H:%M:%S.%e][%^%L%$][%t] %v");
-            SPDLOG_WARN("|--- ACK REQ, W={:<1} -->| pull ACK REQ discarded", w);
-            spdlog::set_pattern("[%H:%M:%S.%e][%^%L%$][%t][%-8!s][%-8!!] %v");
+            SCHC_GW_TRACE(ack_req(w, true));
         }
     }
 
     SPDLOG_WARN("Ending Session...");
 
-    _processing.store(false);
+    _processing.store(false);   // el worker descarta los mensajes que lleguen despues de este punto
+
+    SPDLOG_WARN("Releasing memory resources in the state machine");
+    this->free_reassembly();
 
-    // Asegurar que el hilo finalice
-    if (_process_thread.joinable())
+    // Llamar al callback al finalizar
+    if (_end_callback)
     {
-        _process_thread.join();
+        _end_callback();
     }
 
     return 0;
@@ -1116,13 +938,13 @@ uint8_t SCHC_GW_Ack_on_error::RX_WAIT_x_MISSING_FRAGS_recv_fragments(int rule_id
     {
         if(msg_type == SCHC_REGULAR_FRAGMENT_MSG)
         {
-            if(_counter == 5)
+            /* Perdidas simuladas de fragmentos (loss_pattern) */
+            if(_loss_pattern.drop())
             {
-                    SPDLOG_WARN("\033[31mMessage discarded due to error probability\033[0m");   
-                    _counter++;
+                    SPDLOG_WARN("\033[31mMessage discarded by the loss pattern\033[0m");
+                    SCHC_GW_Metrics::add(SCHC_GW_METRIC_FRAGMENTS_DROPPED);
                     return 0;
             }
-            _counter++;
 
             SPDLOG_DEBUG("Receiving a SCHC Regular fragment");
 
@@ -1132,9 +954,8 @@ uint8_t SCHC_GW_Ack_on_error::RX_WAIT_x_MISSING_FRAGS_recv_fragments(int rule_id
             fcn             = decoder.get_fcn();
             w               = decoder.get_w();
 
-            /* Creacion de buffer para almacenar el schc payload del SCHC fragment */
-            char* payload   = new char[payload_len/8];          // * Liberada en linea 158
-            decoder.get_schc_payload(payload);                  // obtiene el SCHC payload
+            /* Los tiles se copian directamente desde el mensaje al _tilesArray */
+            const char* payload = decoder.get_schc_payload_view();
 
             /* Obteniendo la cantidad de tiles en el mensaje */
             int tiles_in_payload = (payload_len/8)/_tileSize;
@@ -1144,12 +965,15 @@ uint8_t SCHC_GW_Ack_on_error::RX_WAIT_x_MISSING_FRAGS_recv_fragments(int rule_id
             int bitmap_ptr  = this->get_bitmap_ptr(fcn);    // bitmap_ptr: posicion donde se debe comenzar escribiendo un 1 en el _bitmapArray.
             for(int i=0; i<tiles_in_payload; i++)
             {
-                memcpy(_tilesArray[tile_ptr + i], payload + (i*_tileSize), _tileSize);  // se almacenan los bytes de un tile recibido
-                _bitmapArray[w][bitmap_ptr + i] = 1;                                    // en el bitmap, se establece en 1 los correspondientes tiles recibidos
+                memcpy(get_tile(tile_ptr + i), payload + (i*_tileSize), _tileSize);  // se almacenan los bytes de un tile recibido
+                set_bitmap_bit(w, bitmap_ptr + i);                                    // en el bitmap, se establece en 1 los correspondientes tiles recibidos
             }
-            delete[] payload;
 
 
+            /* Los tiles entre el ultimo tile esperado y este fragmento se perdieron */
+            if(tile_ptr > _currentTile_ptr)
+                SCHC_GW_Metrics::add(SCHC_GW_METRIC_TILES_LOST, tile_ptr - _currentTile_ptr);
+
             /* Se almacena el puntero al siguiente tile esperado */
             if((tile_ptr + tiles_in_payload) > _currentTile_ptr)
             {
@@ -1161,10 +985,11 @@ uint8_t SCHC_GW_Ack_on_error::RX_WAIT_x_MISSING_FRAGS_recv_fragments(int rule_id
                 SPDLOG_DEBUG("_currentTile_ptr is not updated. The previous value is kept {}", _currentTile_ptr);
             }
 
+            /* Se avanza el CRC sobre el prefijo contiguo de tiles recibidos */
+            this->update_rcs_prefix();
+
             /* Se imprime mensaje de la llegada de un SCHC fragment*/
-            spdlog::set_pattern("[%H:%M:%S.%e][%^%L%$][%t] %v");
-            SPDLOG_WARN("|--- W={:<1}, FCN={:<2} --->| {:>2} tiles", w, fcn, tiles_in_payload);
-            spdlog::set_pattern("[%H:%M:%S.%e][%^%L%$][%t][%-8!s][%-8!!] %v");
+            SCHC_GW_TRACE(fragment(w, fcn, tiles_in_payload));
 
             /* Valida si se han recibido todos los tiles retransmitidos por el sender */
             uint8_t c       = this->get_c_from_bitmap(w);
@@ -1178,19 +1003,15 @@ uint8_t SCHC_GW_Ack_on_error::RX_WAIT_x_MISSING_FRAGS_recv_fragments(int rule_id
                 {
                     /* si valid_rcs == true, entonces era la ultima ventana */
                     SPDLOG_DEBUG("Sending SCHC ACK");
-                    vector bitmap_vector    = this->get_bitmap_array_vec(w); // obtiene el bitmap expresado como un arreglo de char    
-                    char* buffer            = nullptr;
+                    char buffer[SCHC_ACK_MAX_LEN];
                     c                       = 1;
                     int len;
 
-                    decoder.create_schc_ack(_ruleID, dtag, w, c, bitmap_vector, buffer, len);
+                    decoder.create_schc_ack(_ruleID, dtag, w, c, _bitmapArray[w], _windowSize, buffer, len);
 
-                    _stack->send_downlink_frame(_dev_id, SCHC_FRAG_UPDIR_RULE_ID, buffer, len);
-                    delete[] buffer;
+                    _stack->send_downlink_frame(_device, SCHC_FRAG_UPDIR_RULE_ID, buffer, len);
 
-                    spdlog::set_pattern("[%H:%M:%S.%e][%^%L%$][%t] %v");
-                    SPDLOG_WARN("|<-- ACK, W={:<1}, C={:<1} --| Bitmap:{}", w, c, get_bitmap_array_str(w));
-                    spdlog::set_pattern("[%H:%M:%S.%e][%^%L%$][%t][%-8!s][%-8!!] %v");
+                    SCHC_GW_TRACE(ack(w, c, _bitmapArray[w], _windowSize));
 
                     SPDLOG_INFO("Changing STATE: From STATE_RX_WAIT_x_MISSING_FRAGS --> STATE_RX_END");
                     _currentState = STATE_RX_END;
@@ -1204,18 +1025,14 @@ uint8_t SCHC_GW_Ack_on_error::RX_WAIT_x_MISSING_FRAGS_recv_fragments(int rule_id
 
                     SCHC_GW_Message encoder;
                     int             len;
-                    vector bitmap_vector    = this->get_bitmap_array_vec(w); // obtiene el bitmap expresado como un arreglo de char    
-                    char* buffer            = nullptr;
+                    char buffer[SCHC_ACK_MAX_LEN];
                     c                       = 1;
 
-                    encoder.create_schc_ack(_ruleID, dtag, w, c, bitmap_vector, buffer, len);
+                    encoder.create_schc_ack(_ruleID, dtag, w, c, _bitmapArray[w], _windowSize, buffer, len);
 
-                    _stack->send_downlink_frame(_dev_id, SCHC_FRAG_UPDIR_RULE_ID, buffer, len);
-                    delete[] buffer;
+                    _stack->send_downlink_frame(_device, SCHC_FRAG_UPDIR_RULE_ID, buffer, len);
 
-                    spdlog::set_pattern("[%H:%M:%S.%e][%^%L%$][%t] %v");
-                    SPDLOG_WARN("|<-- ACK, W={:<1}, C={:<1} --| Bitmap:{}", w, c, get_bitmap_array_str(w));
-                    spdlog::set_pattern("[%H:%M:%S.%e][%^%L%$][%t][%-8!s][%-8!!] %v");
+                    SCHC_GW_TRACE(ack(w, c, _bitmapArray[w], _windowSize));
 
                     SPDLOG_INFO("Changing STATE: From STATE_RX_WAIT_x_MISSING_FRAGS --> STATE_RX_RCV_WINDOW");
                     _currentState = STATE_RX_RCV_WINDOW;
@@ -1243,27 +1060,21 @@ uint8_t SCHC_GW_Ack_on_error::RX_WAIT_x_MISSING_FRAGS_recv_fragments(int rule_id
 
             if(rcs_result)  // * Integrity check: success
             {
-                spdlog::set_pattern("[%H:%M:%S.%e][%^%L%$][%t] %v");
-                SPDLOG_WARN("|- W={:<1}, FCN={:<2}+RCS ->| {:>2} bits - Integrity check: success", w, fcn, _lastTileSize);
-                spdlog::set_pattern("[%H:%M:%S.%e][%^%L%$][%t][%-8!s][%-8!!] %v");
+                SCHC_GW_TRACE(all1(w, fcn, _lastTileSize, true));
 
-                _bitmapArray[w][_windowSize-1] = 1;
+                set_bitmap_bit(w, _windowSize-1);
 
                 SPDLOG_DEBUG("Sending SCHC ACK");
                 SCHC_GW_Message         encoder;
                 int                     len;
                 uint8_t c               = 1;
-                vector bitmap_vector    = this->get_bitmap_array_vec(w); // obtiene el bitmap expresado como un arreglo de char    
-                char* buffer            = nullptr;
+                char buffer[SCHC_ACK_MAX_LEN];
 
-                encoder.create_schc_ack(_ruleID, dtag, w, c, bitmap_vector, buffer, len);
+                encoder.create_schc_ack(_ruleID, dtag, w, c, _bitmapArray[w], _windowSize, buffer, len);
 
-                _stack->send_downlink_frame(_dev_id, SCHC_FRAG_UPDIR_RULE_ID, buffer, len);
-                delete[] buffer;
+                _stack->send_downlink_frame(_device, SCHC_FRAG_UPDIR_RULE_ID, buffer, len);
 
-                spdlog::set_pattern("[%H:%M:%S.%e][%^%L%$][%t] %v");
-                SPDLOG_WARN("|<-- ACK, W={:<1}, C={:<1} --| Bitmap:{}", w, c, get_bitmap_array_str(w));
-                spdlog::set_pattern("[%H:%M:%S.%e][%^%L%$][%t][%-8!s][%-8!!] %v");
+                SCHC_GW_TRACE(ack(w, c, _bitmapArray[w], _windowSize));
 
                 SPDLOG_INFO("Changing STATE: From STATE_RX_RCV_WINDOW --> STATE_RX_END");
                 _currentState = STATE_RX_END;
@@ -1272,28 +1083,23 @@ uint8_t SCHC_GW_Ack_on_error::RX_WAIT_x_MISSING_FRAGS_recv_fragments(int rule_id
             }
             else            // * Integrity check: failure
             {
-                spdlog::set_pattern("[%H:%M:%S.%e][%^%L%$][%t] %v");
-                SPDLOG_WARN("|- W={:<1}, FCN={:<2}+RCS ->| {:>2} bits - Integrity check: failure", w, fcn, _lastTileSize);
-                spdlog::set_pattern("[%H:%M:%S.%e][%^%L%$][%t][%-8!s][%-8!!] %v");
+                SCHC_GW_TRACE(all1(w, fcn, _lastTileSize, false));
+                SCHC_GW_Metrics::add(SCHC_GW_METRIC_RCS_FAILURES);
 
-                _bitmapArray[w][_windowSize-1] = 1;
+                set_bitmap_bit(w, _windowSize-1);
 
                 SPDLOG_DEBUG("Sending SCHC ACK");
 
                 SCHC_GW_Message         encoder;
                 int                     len;
                 uint8_t c               = 0;
-                vector bitmap_vector    = this->get_bitmap_array_vec(w); // obtiene el bitmap expresado como un arreglo de char    
-                char* buffer            = nullptr;
+                char buffer[SCHC_ACK_MAX_LEN];
 
-                encoder.create_schc_ack(_ruleID, dtag, w, c, bitmap_vector, buffer, len, false);
+                encoder.create_schc_ack(_ruleID, dtag, w, c, _bitmapArray[w], _windowSize, buffer, len, false);
 
-                _stack->send_downlink_frame(_dev_id, SCHC_FRAG_UPDIR_RULE_ID, buffer, len);
-                delete[] buffer;
+                _stack->send_downlink_frame(_device, SCHC_FRAG_UPDIR_RULE_ID, buffer, len);
 
-                spdlog::set_pattern("[%H:%M:%S.%e][%^%L%$][%t] %v");
-                SPDLOG_WARN("|<-- ACK, W={:<1}, C={:<1} --| Bitmap:{}", w, c, get_bitmap_array_str(w));
-                spdlog::set_pattern("[%H:%M:%S.%e][%^%L%$][%t][%-8!s][%-8!!] %v");
+                SCHC_GW_TRACE(ack(w, c, _bitmapArray[w], _windowSize));
 
                 _wait_pull_ack_req_flag = true;
                 _first_ack_sent_flag    = true;
@@ -1308,9 +1114,7 @@ uint8_t SCHC_GW_Ack_on_error::RX_WAIT_x_MISSING_FRAGS_recv_fragments(int rule_id
                 decoder.decode_message(SCHC_FRAG_LORAWAN, rule_id, msg, len);
                 w = decoder.get_w();
 
-                spdlog::set_pattern("[%H:%M:%S.%e][%^%L%$][%t] %v");
-                SPDLOG_WARN("|--- ACK REQ, W={:<1} -->| pull ACK REQ discarded", w);
-                spdlog::set_pattern("[%H:%M:%S.%e][%^%L%$][%t][%-8!s][%-8!!] %v");
+                SCHC_GW_TRACE(ack_req(w, true));
 
                 _wait_pull_ack_req_flag = false;
             }
@@ -1335,26 +1139,20 @@ uint8_t SCHC_GW_Ack_on_error::RX_WAIT_x_MISSING_FRAGS_recv_fragments(int rule_id
                 decoder.decode_message(SCHC_FRAG_LORAWAN, rule_id, msg, len);
                 w = decoder.get_w();
 
-                spdlog::set_pattern("[%H:%M:%S.%e][%^%L%$][%t] %v");
-                SPDLOG_WARN("|--- ACK REQ, W={:<1} -->|", w);
-                spdlog::set_pattern("[%H:%M:%S.%e][%^%L%$][%t][%-8!s][%-8!!] %v");
+                SCHC_GW_TRACE(ack_req(w, false));
 
 
                 SPDLOG_DEBUG("Sending SCHC ACK");
                 SCHC_GW_Message         encoder;
                 int                     len;
                 uint8_t c               = 0;
-                vector bitmap_vector    = this->get_bitmap_array_vec(w); // obtiene el bitmap expresado como un arreglo de char    
-                char* buffer            = nullptr;
+                char buffer[SCHC_ACK_MAX_LEN];
                 
-                encoder.create_schc_ack(_ruleID, dtag, w, c, bitmap_vector, buffer, len);
+                encoder.create_schc_ack(_ruleID, dtag, w, c, _bitmapArray[w], _windowSize, buffer, len);
 
-                _stack->send_downlink_frame(_dev_id, SCHC_FRAG_UPDIR_RULE_ID, buffer, len);
-                delete[] buffer;
+                _stack->send_downlink_frame(_device, SCHC_FRAG_UPDIR_RULE_ID, buffer, len);
 
-                spdlog::set_pattern("[%H:%M:%S.%e][%^%L%$][%t] %v");
-                SPDLOG_WARN("|<-- ACK, W={:<1}, C={:<1} --| Bitmap:{}", w, c, get_bitmap_array_str(w));
-                spdlog::set_pattern("[%H:%M:%S.%e][%^%L%$][%t][%-8!s][%-8!!] %v");
+                SCHC_GW_TRACE(ack(w, c, _bitmapArray[w], _windowSize));
 
                 _wait_pull_ack_req_flag = true;
 
@@ -1372,6 +1170,14 @@ uint8_t SCHC_GW_Ack_on_error::RX_WAIT_x_MISSING_FRAGS_recv_fragments(int rule_id
         {
             SPDLOG_DEBUG("Receiving a SCHC Regular fragment");
 
+            /* Perdidas simuladas de fragmentos (loss_pattern) */
+            if(_loss_pattern.drop())
+            {
+                    SPDLOG_WARN("\033[31mMessage discarded by the loss pattern\033[0m");
+                    SCHC_GW_Metrics::add(SCHC_GW_METRIC_FRAGMENTS_DROPPED);
+                    return 0;
+            }
+
             /* Decoding el SCHC fragment */
             decoder.decode_message(SCHC_FRAG_LORAWAN, rule_id, msg, len);
             payload_len     = decoder.get_schc_payload_len();   // largo del payload SCHC. En bits
@@ -1382,9 +1188,8 @@ uint8_t SCHC_GW_Ack_on_error::RX_WAIT_x_MISSING_FRAGS_recv_fragments(int rule_id
                 _last_window    = w;    // aseguro que el ultimo fragmento recibido va a marcar cual es la ultima ventana recibida
 
 
-            /* Creacion de buffer para almacenar el schc payload del SCHC fragment */
-            char* payload   = new char[payload_len/8];          // * Liberada en linea 158
-            decoder.get_schc_payload(payload);                  // obtiene el SCHC payload
+            /* Los tiles se copian directamente desde el mensaje al _tilesArray */
+            const char* payload = decoder.get_schc_payload_view();
 
             /* Obteniendo la cantidad de tiles en el mensaje */
             int tiles_in_payload = (payload_len/8)/_tileSize;
@@ -1394,12 +1199,15 @@ uint8_t SCHC_GW_Ack_on_error::RX_WAIT_x_MISSING_FRAGS_recv_fragments(int rule_id
             int bitmap_ptr  = this->get_bitmap_ptr(fcn);    // bitmap_ptr: posicion donde se debe comenzar escribiendo un 1 en el _bitmapArray.
             for(int i=0; i<tiles_in_payload; i++)
             {
-                memcpy(_tilesArray[tile_ptr + i], payload + (i*_tileSize), _tileSize);  // se almacenan los bytes de un tile recibido
-                _bitmapArray[w][bitmap_ptr + i] = 1;                                    // en el bitmap, se establece en 1 los correspondientes tiles recibidos
+                memcpy(get_tile(tile_ptr + i), payload + (i*_tileSize), _tileSize);  // se almacenan los bytes de un tile recibido
+                set_bitmap_bit(w, bitmap_ptr + i);                                    // en el bitmap, se establece en 1 los correspondientes tiles recibidos
             }
-            delete[] payload;
 
 
+            /* Los tiles entre el ultimo tile esperado y este fragmento se perdieron */
+            if(tile_ptr > _currentTile_ptr)
+                SCHC_GW_Metrics::add(SCHC_GW_METRIC_TILES_LOST, tile_ptr - _currentTile_ptr);
+
             /* Se almacena el puntero al siguiente tile esperado */
             if((tile_ptr + tiles_in_payload) > _currentTile_ptr)
             {
@@ -1411,143 +1219,68 @@ uint8_t SCHC_GW_Ack_on_error::RX_WAIT_x_MISSING_FRAGS_recv_fragments(int rule_id
                 SPDLOG_DEBUG("_currentTile_ptr is not updated. The previous value is kept {}", _currentTile_ptr);
             }
 
+            /* Se avanza el CRC sobre el prefijo contiguo de tiles recibidos */
+            this->update_rcs_prefix();
+
             /* Se imprime mensaje de la llegada de un SCHC fragment*/
-            spdlog::set_pattern("[%H:%M:%S.%e][%^%L%$][%t] %v");
-            SPDLOG_WARN("|--- W={:<1}, FCN={:<2} --->| {:>2} tiles", w, fcn, tiles_in_payload);
-            spdlog::set_pattern("[%H:%M:%S.%e][%^%L%$][%t][%-8!s][%-8!!] %v");
+            SCHC_GW_TRACE(fragment(w, fcn, tiles_in_payload));
 
             /* Valida en el bitmap si se han recibido todos los tiles retransmitidos por el sender */
             uint8_t c = this->get_c_from_bitmap(w);
 
+            /* La ultima ventana casi nunca esta completa en el bitmap (c=0): el RCS decide si termino la sesion */
+            if(this->end_session_if_complete(dtag))
+                return 0;
+
             if(c==1 && w!=_last_window)
             {
-                int next_window = w + 1;
-                if(next_window == _last_window)
+                /* Se solicitan los tiles de la siguiente ventana con errores */
+                for(int i = w + 1; i<_last_window; i++)
                 {
                     int len;
-                    char* buffer        = nullptr;
-                    bool valid_rcs = this->check_rcs(_rcs);
-
-                    if(valid_rcs)
-                    {
-                        SPDLOG_DEBUG("Sending SCHC ACK");
-                        vector bitmap_vector   = this->get_bitmap_array_vec(next_window); // obtiene el bitmap expresado como un arreglo de char    
-                        int len;
-                        char* buffer                = nullptr;
-                        decoder.create_schc_ack(_ruleID, dtag, next_window, 1, bitmap_vector, buffer, len);
-
-                        _stack->send_downlink_frame(_dev_id, SCHC_FRAG_UPDIR_RULE_ID, buffer, len);
-                        delete[] buffer;
-
-                        spdlog::set_pattern("[%H:%M:%S.%e][%^%L%$][%t] %v");
-                        SPDLOG_WARN("|<-- ACK, W={:<1}, C={:<1} --| Bitmap:{}", next_window, 1, get_bitmap_array_str(next_window));
-                        spdlog::set_pattern("[%H:%M:%S.%e][%^%L%$][%t][%-8!s][%-8!!] %v");
-
-                        SPDLOG_INFO("Changing STATE: From STATE_RX_WAIT_x_MISSING_FRAGS --> STATE_RX_END");
-                        _currentState = STATE_RX_END;
-                    }
-                    else
+                    char buffer[SCHC_ACK_MAX_LEN];
+                    int c_i         = get_c_from_bitmap(i);
+                    if(c_i == 0)
                     {
                         SPDLOG_DEBUG("Sending SCHC ACK");
 
                         SCHC_GW_Message    encoder;
-                        vector bitmap_vector   = this->get_bitmap_array_vec(_last_window); // obtiene el bitmap expresado como un arreglo de char    
-                        int len;
-                        char* buffer                = nullptr;
-                        c                           = 0;
 
-                        encoder.create_schc_ack(_ruleID, dtag, _last_window, c, bitmap_vector, buffer, len);
+                        encoder.create_schc_ack(_ruleID, dtag, i, c_i, _bitmapArray[i], _windowSize, buffer, len);
 
-                        _stack->send_downlink_frame(_dev_id, SCHC_FRAG_UPDIR_RULE_ID, buffer, len);
-                        delete[] buffer;
+                        _stack->send_downlink_frame(_device, SCHC_FRAG_UPDIR_RULE_ID, buffer, len);
 
-                        spdlog::set_pattern("[%H:%M:%S.%e][%^%L%$][%t] %v");
-                        SPDLOG_WARN("|<-- ACK, W={:<1}, C={:<1} --| Bitmap:{}", _last_window, c, get_bitmap_array_str(_last_window));
-                        spdlog::set_pattern("[%H:%M:%S.%e][%^%L%$][%t][%-8!s][%-8!!] %v");
-                        _last_confirmed_window = _last_window; 
+                        SCHC_GW_TRACE(ack(i, c_i, _bitmapArray[i], _windowSize));
 
+                        _last_confirmed_window = i; 
                         _wait_pull_ack_req_flag = true;
+                        return 0;  
                     }
-                }
-                else
-                {
-                    for(int i = next_window; i<_last_window; i++)
+                    else
                     {
-                        int len;
-                        char* buffer    = nullptr;
-                        int c_i         = get_c_from_bitmap(i);
-                        if(c_i == 0)
-                        {
-                            SPDLOG_DEBUG("Sending SCHC ACK");
-
-                            SCHC_GW_Message    encoder;
-                            vector bitmap_vector   = this->get_bitmap_array_vec(i);
-
-                            encoder.create_schc_ack(_ruleID, dtag, i, c_i, bitmap_vector, buffer, len);
-
-                            _stack->send_downlink_frame(_dev_id, SCHC_FRAG_UPDIR_RULE_ID, buffer, len);
-                            delete[] buffer;
-
-                            spdlog::set_pattern("[%H:%M:%S.%e][%^%L%$][%t] %v");
-                            SPDLOG_WARN("|<-- ACK, W={:<1}, C={:<1} --| Bitmap:{}", i, c_i, get_bitmap_array_str(i));
-                            spdlog::set_pattern("[%H:%M:%S.%e][%^%L%$][%t][%-8!s][%-8!!] %v");
-
-                            _last_confirmed_window = i; 
-                            _wait_pull_ack_req_flag = true;
-                            break;  
-                        }
-                        else
-                        {
-                            SPDLOG_WARN("The SCHC gateway correctly received the tiles for window {}.", i);
-                        }
-
-                    }// cierre del for
-                }
-            }
-            else if(c==1 && w==_last_window)
-            {
-                int len;
-                char* buffer        = nullptr;
-                bool valid_rcs = this->check_rcs(_rcs);
-                if(valid_rcs)
-                {
-                    SPDLOG_DEBUG("Sending SCHC ACK");
-                    vector bitmap_vector   = this->get_bitmap_array_vec(_last_window); // obtiene el bitmap expresado como un arreglo de char    
-                    int len;
-                    char* buffer                = nullptr;
-                    decoder.create_schc_ack(_ruleID, dtag, _last_window, 1, bitmap_vector, buffer, len);
-
-                    _stack->send_downlink_frame(_dev_id, SCHC_FRAG_UPDIR_RULE_ID, buffer, len);
-                    delete[] buffer;
+                        SPDLOG_WARN("The SCHC gateway correctly received the tiles for window {}.", i);
+                    }
 
-                    spdlog::set_pattern("[%H:%M:%S.%e][%^%L%$][%t] %v");
-                    SPDLOG_WARN("|<-- ACK, W={:<1}, C={:<1} --| Bitmap:{}", _last_window, 1, get_bitmap_array_str(_last_window));
-                    spdlog::set_pattern("[%H:%M:%S.%e][%^%L%$][%t][%-8!s][%-8!!] %v");
+                }// cierre del for
+            }
 
-                    SPDLOG_INFO("Changing STATE: From STATE_RX_WAIT_x_MISSING_FRAGS --> STATE_RX_END");
-                    _currentState = STATE_RX_END;
-                }
-                else
-                {
-                    SPDLOG_DEBUG("Sending SCHC ACK");
+            if(c==1)
+            {
+                /* Ninguna ventana anterior tiene errores y el RCS no valida: faltan tiles de la ultima ventana */
+                SPDLOG_DEBUG("Sending SCHC ACK");
 
-                    SCHC_GW_Message    encoder;
-                    vector bitmap_vector   = this->get_bitmap_array_vec(_last_window); // obtiene el bitmap expresado como un arreglo de char    
-                    int len;
-                    char* buffer                = nullptr;
-                    c                           = 0;
-                    encoder.create_schc_ack(_ruleID, dtag, _last_window, c, bitmap_vector, buffer, len);
+                SCHC_GW_Message    encoder;
+                int len;
+                char buffer[SCHC_ACK_MAX_LEN];
+                c                           = 0;
+                encoder.create_schc_ack(_ruleID, dtag, _last_window, c, _bitmapArray[_last_window], _windowSize, buffer, len);
 
-                    _stack->send_downlink_frame(_dev_id, SCHC_FRAG_UPDIR_RULE_ID, buffer, len);
-                    delete[] buffer;
+                _stack->send_downlink_frame(_device, SCHC_FRAG_UPDIR_RULE_ID, buffer, len);
 
-                    spdlog::set_pattern("[%H:%M:%S.%e][%^%L%$][%t] %v");
-                    SPDLOG_WARN("|<-- ACK, W={:<1}, C={:<1} --| Bitmap:{}", _last_window, c, get_bitmap_array_str(_last_window));
-                    spdlog::set_pattern("[%H:%M:%S.%e][%^%L%$][%t][%-8!s][%-8!!] %v");
-                    _last_confirmed_window  = _last_window; 
+                SCHC_GW_TRACE(ack(_last_window, c, _bitmapArray[_last_window], _windowSize));
+                _last_confirmed_window  = _last_window; 
 
-                    _wait_pull_ack_req_flag = true;
-                }
+                _wait_pull_ack_req_flag = true;
             }
         }
         else if(msg_type == SCHC_ACK_REQ_MSG)
@@ -1559,9 +1292,7 @@ uint8_t SCHC_GW_Ack_on_error::RX_WAIT_x_MISSING_FRAGS_recv_fragments(int rule_id
                 decoder.decode_message(SCHC_FRAG_LORAWAN, rule_id, msg, len);
                 w               = decoder.get_w();
 
-                spdlog::set_pattern("[%H:%M:%S.%e][%^%L%$][%t] %v");
-                SPDLOG_WARN("|--- ACK REQ, W={:<1} -->| pull ACK REQ discarded", w);
-                spdlog::set_pattern("[%H:%M:%S.%e][%^%L%$][%t][%-8!s][%-8!!] %v");
+                SCHC_GW_TRACE(ack_req(w, true));
                 _wait_pull_ack_req_flag = false;
             }
             else
@@ -1571,16 +1302,17 @@ uint8_t SCHC_GW_Ack_on_error::RX_WAIT_x_MISSING_FRAGS_recv_fragments(int rule_id
                 decoder.decode_message(SCHC_FRAG_LORAWAN, rule_id, msg, len);
                 uint8_t w_received               = decoder.get_w();
 
-                spdlog::set_pattern("[%H:%M:%S.%e][%^%L%$][%t] %v");
-                SPDLOG_WARN("|--- ACK REQ, W={:<1} -->| ", w_received);
-                spdlog::set_pattern("[%H:%M:%S.%e][%^%L%$][%t][%-8!s][%-8!!] %v");
+                SCHC_GW_TRACE(ack_req(w_received, false));
 
+                /* Los tiles retransmitidos pueden haber completado la sesion */
+                if(this->end_session_if_complete(dtag))
+                    return 0;
 
                 /* Revisa cual ventana tiene errores y envia un ACK para esa ventana */
                 for(int i = _last_confirmed_window; i<_last_window; i++)
                 {
                     int len;
-                    char* buffer                = nullptr;
+                    char buffer[SCHC_ACK_MAX_LEN];
                     uint8_t c                   = get_c_from_bitmap(i);
                     if(c == 0)
                     {
@@ -1588,16 +1320,12 @@ uint8_t SCHC_GW_Ack_on_error::RX_WAIT_x_MISSING_FRAGS_recv_fragments(int rule_id
 
                         SCHC_GW_Message    encoder;
                         _last_confirmed_window      = i;
-                        vector bitmap_vector   = this->get_bitmap_array_vec(i);
 
-                        encoder.create_schc_ack(_ruleID, dtag, i, c, bitmap_vector, buffer, len);
+                        encoder.create_schc_ack(_ruleID, dtag, i, c, _bitmapArray[i], _windowSize, buffer, len);
 
-                        _stack->send_downlink_frame(_dev_id, SCHC_FRAG_UPDIR_RULE_ID, buffer, len);
-                        delete[] buffer;
+                        _stack->send_downlink_frame(_device, SCHC_FRAG_UPDIR_RULE_ID, buffer, len);
 
-                        spdlog::set_pattern("[%H:%M:%S.%e][%^%L%$][%t] %v");
-                        SPDLOG_WARN("|<-- ACK, W={:<1}, C={:<1} --| Bitmap:{}", i, c, get_bitmap_array_str(i));
-                        spdlog::set_pattern("[%H:%M:%S.%e][%^%L%$][%t][%-8!s][%-8!!] %v");
+                        SCHC_GW_TRACE(ack(i, c, _bitmapArray[i], _windowSize));
 
                         _wait_pull_ack_req_flag = true;
 
@@ -1613,18 +1341,14 @@ uint8_t SCHC_GW_Ack_on_error::RX_WAIT_x_MISSING_FRAGS_recv_fragments(int rule_id
                 Por lo tanto la ventana con errores es la última.*/
                 SPDLOG_DEBUG("Sending SCHC ACK");
                 SCHC_GW_Message    encoder;
-                vector bitmap_vector   = this->get_bitmap_array_vec(_last_window); // obtiene el bitmap expresado como un arreglo de char    
                 int len;
-                char* buffer                = nullptr;
+                char buffer[SCHC_ACK_MAX_LEN];
                 int c                       = 0;
-                encoder.create_schc_ack(_ruleID, dtag, _last_window, c, bitmap_vector, buffer, len);
+                encoder.create_schc_ack(_ruleID, dtag, _last_window, c, _bitmapArray[_last_window], _windowSize, buffer, len);
 
-                _stack->send_downlink_frame(_dev_id, SCHC_FRAG_UPDIR_RULE_ID, buffer, len);
-                delete[] buffer;
+                _stack->send_downlink_frame(_device, SCHC_FRAG_UPDIR_RULE_ID, buffer, len);
 
-                spdlog::set_pattern("[%H:%M:%S.%e][%^%L%$][%t] %v");
-                SPDLOG_WARN("|<-- ACK, W={:<1}, C={:<1} --| Bitmap:{}", _last_window, c, get_bitmap_array_str(_last_window));
-                spdlog::set_pattern("[%H:%M:%S.%e][%^%L%$][%t][%-8!s][%-8!!] %v");
+                SCHC_GW_TRACE(ack(_last_window, c, _bitmapArray[_last_window], _windowSize));
                 _last_confirmed_window = _last_window; 
 
                 _wait_pull_ack_req_flag = true;
@@ -1641,6 +1365,7 @@ uint8_t SCHC_GW_Ack_on_error::RX_WAIT_x_MISSING_FRAGS_recv_fragments(int rule_id
             w               = decoder.get_w();
             _last_window    = w;
             _rcs            = decoder.get_rcs();
+            _all1_received_flag = true;
             fcn             = decoder.get_fcn();
             decoder.get_schc_payload(_last_tile);           // obtiene el SCHC payload
 
@@ -1648,52 +1373,41 @@ uint8_t SCHC_GW_Ack_on_error::RX_WAIT_x_MISSING_FRAGS_recv_fragments(int rule_id
 
             if(rcs_result)  // * Integrity check: success
             {
-                spdlog::set_pattern("[%H:%M:%S.%e][%^%L%$][%t] %v");
-                SPDLOG_WARN("|- W={:<1}, FCN={:<2}+RCS ->| {:>2} bits - Integrity check: success", w, fcn, _lastTileSize);
-                spdlog::set_pattern("[%H:%M:%S.%e][%^%L%$][%t][%-8!s][%-8!!] %v");
+                SCHC_GW_TRACE(all1(w, fcn, _lastTileSize, true));
 
-                _bitmapArray[w][_windowSize-1] = 1;
+                set_bitmap_bit(w, _windowSize-1);
 
                 SPDLOG_DEBUG("Sending SCHC ACK");
-                uint8_t c                   = get_c_from_bitmap(w);                     // obtiene el valor de c en base al _bitmap_array
-                vector bitmap_vector   = this->get_bitmap_array_vec(w); // obtiene el bitmap expresado como un arreglo de char    
+                uint8_t c                   = 1;                                        // el RCS es correcto: no faltan tiles (RFC 8724, 8.4.3)
                 int len;
-                char* buffer                = nullptr;
-                decoder.create_schc_ack(_ruleID, dtag, w, c, bitmap_vector, buffer, len);
-                _stack->send_downlink_frame(_dev_id, SCHC_FRAG_UPDIR_RULE_ID, buffer, len);
-                delete[] buffer;
+                char buffer[SCHC_ACK_MAX_LEN];
+                decoder.create_schc_ack(_ruleID, dtag, w, c, _bitmapArray[w], _windowSize, buffer, len);
+                _stack->send_downlink_frame(_device, SCHC_FRAG_UPDIR_RULE_ID, buffer, len);
 
-                spdlog::set_pattern("[%H:%M:%S.%e][%^%L%$][%t] %v");
-                SPDLOG_WARN("|<-- ACK, W={:<1}, C={:<1} --| Bitmap:{}", w, c, get_bitmap_array_str(w));
-                spdlog::set_pattern("[%H:%M:%S.%e][%^%L%$][%t][%-8!s][%-8!!] %v");
+                SCHC_GW_TRACE(ack(w, c, _bitmapArray[w], _windowSize));
 
                 SPDLOG_INFO("Changing STATE: From STATE_RX_RCV_WINDOW --> STATE_RX_END");
                 _currentState = STATE_RX_END;
             }
             else            // * Integrity check: failure
             {
-                spdlog::set_pattern("[%H:%M:%S.%e][%^%L%$][%t] %v");
-                SPDLOG_WARN("|- W={:<1}, FCN={:<2}+RCS ->| {:>2} bits - Integrity check: failure", w, fcn, _lastTileSize);
-                spdlog::set_pattern("[%H:%M:%S.%e][%^%L%$][%t][%-8!s][%-8!!] %v");
+                SCHC_GW_TRACE(all1(w, fcn, _lastTileSize, false));
+                SCHC_GW_Metrics::add(SCHC_GW_METRIC_RCS_FAILURES);
 
-                _bitmapArray[w][_windowSize-1] = 1;
+                set_bitmap_bit(w, _windowSize-1);
 
                 SPDLOG_DEBUG("Sending SCHC ACK");
 
                 SCHC_GW_Message    encoder;
                 uint8_t c                   = 0;
-                vector bitmap_vector   = this->get_bitmap_array_vec(w); // obtiene el bitmap expresado como un arreglo de char    
                 int len;
-                char* buffer                = nullptr;
+                char buffer[SCHC_ACK_MAX_LEN];
 
-                encoder.create_schc_ack(_ruleID, dtag, w, c, bitmap_vector, buffer, len, false);
+                encoder.create_schc_ack(_ruleID, dtag, w, c, _bitmapArray[w], _windowSize, buffer, len, false);
 
-                _stack->send_downlink_frame(_dev_id, SCHC_FRAG_UPDIR_RULE_ID, buffer, len);
-                delete[] buffer;
+                _stack->send_downlink_frame(_device, SCHC_FRAG_UPDIR_RULE_ID, buffer, len);
 
-                spdlog::set_pattern("[%H:%M:%S.%e][%^%L%$][%t] %v");
-                SPDLOG_WARN("|<-- ACK, W={:<1}, C={:<1} --| Bitmap:{}", w, c, get_bitmap_array_str(w));
-                spdlog::set_pattern("[%H:%M:%S.%e][%^%L%$][%t][%-8!s][%-8!!] %v");
+                SCHC_GW_TRACE(ack(w, c, _bitmapArray[w], _windowSize));
 
                 SPDLOG_INFO("Changing STATE: From STATE_RX_RCV_WINDOW --> STATE_RX_WAIT_x_MISSING_FRAGS");
                 _currentState = STATE_RX_WAIT_x_MISSING_FRAGS;
@@ -1709,13 +1423,13 @@ uint8_t SCHC_GW_Ack_on_error::RX_WAIT_x_MISSING_FRAGS_recv_fragments(int rule_id
         {
             SPDLOG_DEBUG("Receiving a SCHC Regular fragment");
 
-            if(_counter == 6)
+            /* Perdidas simuladas de fragmentos (loss_pattern) */
+            if(_loss_pattern.drop())
             {
-                    SPDLOG_WARN("\033[31mMessage discarded due to error probability\033[0m");   
-                    _counter++;
+                    SPDLOG_WARN("\033[31mMessage discarded by the loss pattern\033[0m");
+                    SCHC_GW_Metrics::add(SCHC_GW_METRIC_FRAGMENTS_DROPPED);
                     return 0;
             }
-            _counter++;
 
 
             /* Decoding el SCHC fragment */
@@ -1728,9 +1442,8 @@ uint8_t SCHC_GW_Ack_on_error::RX_WAIT_x_MISSING_FRAGS_recv_fragments(int rule_id
                 _last_window    = w;    // aseguro que el ultimo fragmento recibido va a marcar cual es la ultima ventana recibida
 
 
-            /* Creacion de buffer para almacenar el schc payload del SCHC fragment */
-            char* payload   = new char[payload_len/8];          // * Liberada en linea 158
-            decoder.get_schc_payload(payload);                  // obtiene el SCHC payload
+            /* Los tiles se copian directamente desde el mensaje al _tilesArray */
+            const char* payload = decoder.get_schc_payload_view();
 
             /* Obteniendo la cantidad de tiles en el mensaje */
             int tiles_in_payload = (payload_len/8)/_tileSize;
@@ -1740,12 +1453,15 @@ uint8_t SCHC_GW_Ack_on_error::RX_WAIT_x_MISSING_FRAGS_recv_fragments(int rule_id
             int bitmap_ptr  = this->get_bitmap_ptr(fcn);    // bitmap_ptr: posicion donde se debe comenzar escribiendo un 1 en el _bitmapArray.
             for(int i=0; i<tiles_in_payload; i++)
             {
-                memcpy(_tilesArray[tile_ptr + i], payload + (i*_tileSize), _tileSize);  // se almacenan los bytes de un tile recibido
-                _bitmapArray[w][bitmap_ptr + i] = 1;                                    // en el bitmap, se establece en 1 los correspondientes tiles recibidos
+                memcpy(get_tile(tile_ptr + i), payload + (i*_tileSize), _tileSize);  // se almacenan los bytes de un tile recibido
+                set_bitmap_bit(w, bitmap_ptr + i);                                    // en el bitmap, se establece en 1 los correspondientes tiles recibidos
             }
-            delete[] payload;
 
 
+            /* Los tiles entre el ultimo tile esperado y este fragmento se perdieron */
+            if(tile_ptr > _currentTile_ptr)
+                SCHC_GW_Metrics::add(SCHC_GW_METRIC_TILES_LOST, tile_ptr - _currentTile_ptr);
+
             /* Se almacena el puntero al siguiente tile esperado */
             if((tile_ptr + tiles_in_payload) > _currentTile_ptr)
             {
@@ -1757,10 +1473,11 @@ uint8_t SCHC_GW_Ack_on_error::RX_WAIT_x_MISSING_FRAGS_recv_fragments(int rule_id
                 SPDLOG_DEBUG("_currentTile_ptr is not updated. The previous value is kept {}", _currentTile_ptr);
             }
 
+            /* Se avanza el CRC sobre el prefijo contiguo de tiles recibidos */
+            this->update_rcs_prefix();
+
             /* Se imprime mensaje de la llegada de un SCHC fragment*/
-            spdlog::set_pattern("[%H:%M:%S.%e][%^%L%$][%t] %v");
-            SPDLOG_WARN("|--- W={:<1}, FCN={:<2} --->| {:>2} tiles", w, fcn, tiles_in_payload);
-            spdlog::set_pattern("[%H:%M:%S.%e][%^%L%$][%t][%-8!s][%-8!!] %v");
+            SCHC_GW_TRACE(fragment(w, fcn, tiles_in_payload));
 
 
             bool rcs_result = this->check_rcs(_rcs);
@@ -1769,16 +1486,13 @@ uint8_t SCHC_GW_Ack_on_error::RX_WAIT_x_MISSING_FRAGS_recv_fragments(int rule_id
                 SPDLOG_DEBUG("Sending SCHC Compound ACK");
                 SCHC_GW_Message    encoder;
                 int len;
-                char* buffer                = nullptr;
-                vector<uint8_t>        windows_with_error;
+                char buffer[SCHC_ACK_MAX_LEN];
+                uint8_t windows_with_error = 0;
                 encoder.create_schc_ack_compound(_ruleID, dtag, _last_window, windows_with_error, _bitmapArray, _windowSize, buffer, len);
 
-                _stack->send_downlink_frame(_dev_id, SCHC_FRAG_UPDIR_RULE_ID, buffer, len);
-                delete[] buffer;
+                _stack->send_downlink_frame(_device, SCHC_FRAG_UPDIR_RULE_ID, buffer, len);
 
-                spdlog::set_pattern("[%H:%M:%S.%e][%^%L%$][%t] %v");
-                SPDLOG_WARN("|<-- ACK, C=1 -------| {}", encoder.get_compound_bitmap_str());
-                spdlog::set_pattern("[%H:%M:%S.%e][%^%L%$][%t][%-8!s][%-8!!] %v");
+                SCHC_GW_TRACE(compound_ack(1, windows_with_error, _bitmapArray, _windowSize));
 
                 SPDLOG_INFO("Changing STATE: From STATE_RX_RCV_WINDOW --> STATE_RX_END");
                 _currentState = STATE_RX_END;
@@ -1797,9 +1511,7 @@ uint8_t SCHC_GW_Ack_on_error::RX_WAIT_x_MISSING_FRAGS_recv_fragments(int rule_id
                 decoder.decode_message(SCHC_FRAG_LORAWAN, rule_id, msg, len);
                 w               = decoder.get_w();
 
-                spdlog::set_pattern("[%H:%M:%S.%e][%^%L%$][%t] %v");
-                SPDLOG_WARN("|--- ACK REQ, W={:<1} -->| pull ACK REQ discarded", w);
-                spdlog::set_pattern("[%H:%M:%S.%e][%^%L%$][%t][%-8!s][%-8!!] %v");
+                SCHC_GW_TRACE(ack_req(w, true));
                 _wait_pull_ack_req_flag = false;
             }
             else
@@ -1809,9 +1521,7 @@ uint8_t SCHC_GW_Ack_on_error::RX_WAIT_x_MISSING_FRAGS_recv_fragments(int rule_id
                 decoder.decode_message(SCHC_FRAG_LORAWAN, rule_id, msg, len);
                 w               = decoder.get_w();
 
-                spdlog::set_pattern("[%H:%M:%S.%e][%^%L%$][%t] %v");
-                SPDLOG_WARN("|--- ACK REQ, W={:<1} -->| ", w);
-                spdlog::set_pattern("[%H:%M:%S.%e][%^%L%$][%t][%-8!s][%-8!!] %v");
+                SCHC_GW_TRACE(ack_req(w, false));
 
 
                 bool rcs_result = this->check_rcs(_rcs);
@@ -1820,16 +1530,13 @@ uint8_t SCHC_GW_Ack_on_error::RX_WAIT_x_MISSING_FRAGS_recv_fragments(int rule_id
                     SPDLOG_DEBUG("Sending SCHC Compound ACK");
                     SCHC_GW_Message    encoder;
                     int len;
-                    char* buffer                = nullptr;
-                    vector<uint8_t> windows_with_error;
+                    char buffer[SCHC_ACK_MAX_LEN];
+                    uint8_t windows_with_error = 0;
                     encoder.create_schc_ack_compound(_ruleID, dtag, _last_window, windows_with_error, _bitmapArray, _windowSize, buffer, len);
 
-                    _stack->send_downlink_frame(_dev_id, SCHC_FRAG_UPDIR_RULE_ID, buffer, len);
-                    delete[] buffer;
+                    _stack->send_downlink_frame(_device, SCHC_FRAG_UPDIR_RULE_ID, buffer, len);
 
-                    spdlog::set_pattern("[%H:%M:%S.%e][%^%L%$][%t] %v");
-                    SPDLOG_WARN("|<-- ACK, C=1 -------| {}", encoder.get_compound_bitmap_str());
-                    spdlog::set_pattern("[%H:%M:%S.%e][%^%L%$][%t][%-8!s][%-8!!] %v");
+                    SCHC_GW_TRACE(compound_ack(1, windows_with_error, _bitmapArray, _windowSize));
 
                     SPDLOG_INFO("Changing STATE: From STATE_RX_RCV_WINDOW --> STATE_RX_END");
                     _currentState = STATE_RX_END;
@@ -1840,26 +1547,23 @@ uint8_t SCHC_GW_Ack_on_error::RX_WAIT_x_MISSING_FRAGS_recv_fragments(int rule_id
                 {
                     SPDLOG_DEBUG("Sending SCHC Compound ACK");
                     /* Revisa si alguna ventana tiene tiles perdidos. Si encuentra alguna, la almacena en un vector */
-                    vector<uint8_t> windows_with_error;
+                    uint8_t windows_with_error = 0;
                     for(int i=0; i < _last_window; i++)
                     {
                         int c = this->get_c_from_bitmap(i);
                         if(c == 0)
-                            windows_with_error.push_back(i);
+                            windows_with_error |= (1 << i);
                     }
-                    windows_with_error.push_back(_last_window);
+                    windows_with_error |= (1 << _last_window);
 
                     SCHC_GW_Message    encoder;
                     int len;
-                    char* buffer                = nullptr;
+                    char buffer[SCHC_ACK_MAX_LEN];
                     encoder.create_schc_ack_compound(_ruleID, dtag, _last_window, windows_with_error, _bitmapArray, _windowSize, buffer, len);
 
-                    _stack->send_downlink_frame(_dev_id, SCHC_FRAG_UPDIR_RULE_ID, buffer, len);
-                    delete[] buffer;
+                    _stack->send_downlink_frame(_device, SCHC_FRAG_UPDIR_RULE_ID, buffer, len);
 
-                    spdlog::set_pattern("[%H:%M:%S.%e][%^%L%$][%t] %v");
-                    SPDLOG_WARN("|<-- ACK, C=0 -------| {}", encoder.get_compound_bitmap_str());
-                    spdlog::set_pattern("[%H:%M:%S.%e][%^%L%$][%t][%-8!s][%-8!!] %v");
+                    SCHC_GW_TRACE(compound_ack(0, windows_with_error, _bitmapArray, _windowSize));
 
                     _wait_pull_ack_req_flag = true;
 
@@ -1884,60 +1588,50 @@ uint8_t SCHC_GW_Ack_on_error::RX_WAIT_x_MISSING_FRAGS_recv_fragments(int rule_id
 
             if(rcs_result)  // * Integrity check: success
             {
-                spdlog::set_pattern("[%H:%M:%S.%e][%^%L%$][%t] %v");
-                SPDLOG_WARN("|- W={:<1}, FCN={:<2}+RCS ->| {:>2} bits - Integrity check: success", w, fcn, _lastTileSize);
-                spdlog::set_pattern("[%H:%M:%S.%e][%^%L%$][%t][%-8!s][%-8!!] %v");
+                SCHC_GW_TRACE(all1(w, fcn, _lastTileSize, true));
 
-                _bitmapArray[w][_windowSize-1] = 1;
+                set_bitmap_bit(w, _windowSize-1);
 
                 SPDLOG_DEBUG("Sending SCHC ACK");
-                uint8_t c                   = get_c_from_bitmap(w);                     // obtiene el valor de c en base al _bitmap_array
-                vector bitmap_vector   = this->get_bitmap_array_vec(w); // obtiene el bitmap expresado como un arreglo de char    
+                uint8_t c                   = 1;                                        // el RCS es correcto: no faltan tiles (RFC 8724, 8.4.3)
                 int len;
-                char* buffer                = nullptr;
-                decoder.create_schc_ack(_ruleID, dtag, w, c, bitmap_vector, buffer, len);
-                _stack->send_downlink_frame(_dev_id, SCHC_FRAG_UPDIR_RULE_ID, buffer, len);
-                delete[] buffer;
+                char buffer[SCHC_ACK_MAX_LEN];
+                decoder.create_schc_ack(_ruleID, dtag, w, c, _bitmapArray[w], _windowSize, buffer, len);
+                _stack->send_downlink_frame(_device, SCHC_FRAG_UPDIR_RULE_ID, buffer, len);
 
-                spdlog::set_pattern("[%H:%M:%S.%e][%^%L%$][%t] %v");
-                SPDLOG_WARN("|<-- ACK, W={:<1}, C={:<1} --| Bitmap:{}", w, c, get_bitmap_array_str(w));
-                spdlog::set_pattern("[%H:%M:%S.%e][%^%L%$][%t][%-8!s][%-8!!] %v");
+                SCHC_GW_TRACE(ack(w, c, _bitmapArray[w], _windowSize));
 
                 SPDLOG_INFO("Changing STATE: From STATE_RX_RCV_WINDOW --> STATE_RX_END");
                 _currentState = STATE_RX_END;
             }
             else            // * Integrity check: failure
             {
-                spdlog::set_pattern("[%H:%M:%S.%e][%^%L%$][%t] %v");
-                SPDLOG_WARN("|- W={:<1}, FCN={:<2}+RCS ->| {:>2} bits - Integrity check: failure", w, fcn, _lastTileSize);
-                spdlog::set_pattern("[%H:%M:%S.%e][%^%L%$][%t][%-8!s][%-8!!] %v");
+                SCHC_GW_TRACE(all1(w, fcn, _lastTileSize, false));
+                SCHC_GW_Metrics::add(SCHC_GW_METRIC_RCS_FAILURES);
 
-                _bitmapArray[w][_windowSize-1] = 1;
+                set_bitmap_bit(w, _windowSize-1);
 
                 SPDLOG_DEBUG("Sending SCHC ACK");
 
                 /* Revisa si alguna ventana tiene tiles perdidos */
-                vector<uint8_t> windows_with_error;
+                uint8_t windows_with_error = 0;
                 for(int i=0; i < _last_window; i++)
                 {
                     int c = this->get_c_from_bitmap(i);
                     if(c == 0)
-                        windows_with_error.push_back(i);
+                        windows_with_error |= (1 << i);
                 }
-                windows_with_error.push_back(_last_window);
+                windows_with_error |= (1 << _last_window);
          
 
                 SCHC_GW_Message    encoder;
                 int len;
-                char* buffer    = nullptr;
+                char buffer[SCHC_ACK_MAX_LEN];
                 encoder.create_schc_ack_compound(_ruleID, dtag, _last_window, windows_with_error, _bitmapArray, _windowSize, buffer, len);
 
-                _stack->send_downlink_frame(_dev_id, SCHC_FRAG_UPDIR_RULE_ID, buffer, len);
-                delete[] buffer;
+                _stack->send_downlink_frame(_device, SCHC_FRAG_UPDIR_RULE_ID, buffer, len);
 
-                spdlog::set_pattern("[%H:%M:%S.%e][%^%L%$][%t] %v");
-                SPDLOG_WARN("|<-- ACK, C=0 -------| {}", encoder.get_compound_bitmap_str());
-                spdlog::set_pattern("[%H:%M:%S.%e][%^%L%$][%t][%-8!s][%-8!!] %v");
+                SCHC_GW_TRACE(compound_ack(0, windows_with_error, _bitmapArray, _windowSize));
 
                 _wait_pull_ack_req_flag = true;
             }
@@ -1951,83 +1645,82 @@ uint8_t SCHC_GW_Ack_on_error::get_c_from_bitmap(uint8_t window)
 {
     /* La funcion indica si faltan tiles para la ventana pasada como argumento.
     Retorna un 1 si no faltan tiles y 0 si faltan tiles */
-
-    for (int i=0; i<_windowSize; i++)
-    {
-        if(_bitmapArray[window][i] == 0)
-            return 0;
-    }
-
-    return 1;
+    uint64_t full_mask = ~uint64_t(0) << (64 - _windowSize);
+    return (_bitmapArray[window] & full_mask) == full_mask ? 1 : 0;
 }
 
-vector<uint8_t> SCHC_GW_Ack_on_error::get_bitmap_array_vec(uint8_t window)
+void SCHC_GW_Ack_on_error::set_bitmap_bit(uint8_t window, int pos)
 {
-    vector<uint8_t> bitmap_v;
-    for(int i=0; i<_windowSize; i++)
-    {
-        bitmap_v.push_back(_bitmapArray[window][i]);
-    }
+    _bitmapArray[window] |= uint64_t(1) << (63 - pos);
+}
 
-    return bitmap_v;
+bool SCHC_GW_Ack_on_error::get_bitmap_bit(uint8_t window, int pos)
+{
+    return (_bitmapArray[window] >> (63 - pos)) & 1;
 }
 
-bool SCHC_GW_Ack_on_error::check_rcs(uint32_t rcs)
+bool SCHC_GW_Ack_on_error::end_session_if_complete(uint8_t dtag)
 {
-    // Calcular el tamaño total necesario para el buffer de todos los tiles
-    int total_size = (_currentTile_ptr * _tileSize) + _lastTileSize/8;
+    // Solo para ACK_END_SES en STATE_RX_WAIT_x_MISSING_FRAGS. Sin el All-1 no se conoce el RCS.
+    // Un tile faltante antes de _currentTile_ptr haria fallar el RCS, por lo que no se calcula
+    if(!_all1_received_flag)
+        return false;
 
-    // Crear un buffer para almacenar todos los valores
-    char buffer[total_size];
+    this->update_rcs_prefix();
+    if(_rcs_prefix_tiles < _currentTile_ptr || !this->check_rcs(_rcs))
+        return false;
 
-    int k=0;
-    for(int i=0; i<_currentTile_ptr; i++)
-    {
-        for(int j=0; j<_tileSize; j++)
-        {
-            buffer[k] = _tilesArray[i][j];
-            k++;
-        } 
-    }
+    /* RCS correcto: no faltan tiles y se responde con C=1 (RFC 8724, 8.4.3) */
+    SPDLOG_DEBUG("Sending SCHC ACK");
+    SCHC_GW_Message    encoder;
+    int len;
+    char buffer[SCHC_ACK_MAX_LEN];
+    encoder.create_schc_ack(_ruleID, dtag, _last_window, 1, _bitmapArray[_last_window], _windowSize, buffer, len);
+
+    _stack->send_downlink_frame(_device, SCHC_FRAG_UPDIR_RULE_ID, buffer, len);
 
-    for(int i=0; i<_lastTileSize/8; i++)
+    SCHC_GW_TRACE(ack(_last_window, 1, _bitmapArray[_last_window], _windowSize));
+
+    SPDLOG_INFO("Changing STATE: From STATE_RX_WAIT_x_MISSING_FRAGS --> STATE_RX_END");
+    _currentState = STATE_RX_END;
+    return true;
+}
+
+bool SCHC_GW_Ack_on_error::check_rcs(uint32_t rcs)
+{
+    // Solo valida. Las fallas se cuentan donde se recibe el All-1, no cuando se consulta
+    // si la sesion termino tras una retransmision o un ACK REQ
+    // El CRC del prefijo contiguo ya fue calculado a medida que llegaron los tiles.
+    // Solo se procesa desde el primer tile faltante hasta _currentTile_ptr y el ultimo tile
+    this->update_rcs_prefix();
+    uint32_t crc = _rcs_prefix_crc;
+    for(int i=_rcs_prefix_tiles; i<_currentTile_ptr; i++)
     {
-            buffer[k] = _last_tile[i];
-            k++;
+        crc = SCHC_GW_CRC32::update(crc, get_tile(i), _tileSize);
     }
+    crc = SCHC_GW_CRC32::update(crc, _last_tile, _lastTileSize/8);
 
-    uint32_t rcs_calculed = this->calculate_crc32(buffer, total_size);
+    uint32_t rcs_calculed = SCHC_GW_CRC32::finalize(crc);
 
     SPDLOG_INFO("calculated RCS: {}", rcs_calculed);
     SPDLOG_INFO("  received RCS: {}", rcs);
 
-    if(rcs_calculed == rcs)
-        return true;
-    else
-        return false;
+    return rcs_calculed == rcs;
 }
 
-uint32_t SCHC_GW_Ack_on_error::calculate_crc32(const char *data, size_t length) 
+void SCHC_GW_Ack_on_error::update_rcs_prefix()
 {
-    // Polinomio CRC32 (reflejado)
-    const uint32_t polynomial = 0xEDB88320;
-    uint32_t crc = 0xFFFFFFFF;
-
-    // Procesar cada byte en el buffer
-    for (size_t i = 0; i < length; i++) {
-        crc ^= static_cast<uint8_t>(data[i]); // Asegúrate de que el dato sea tratado como uint8_t
-
-        // Procesar los 8 bits del byte
-        for (int j = 0; j < 8; j++) {
-            if (crc & 1) {
-                crc = (crc >> 1) ^ polynomial;
-            } else {
-                crc >>= 1;
-            }
-        }
+    // Agrega al CRC los tiles recibidos en orden desde el ultimo tile procesado.
+    // Se detiene en el primer tile faltante (bitmap en 0) o en _currentTile_ptr
+    while(_rcs_prefix_tiles < _currentTile_ptr)
+    {
+        int window  = _rcs_prefix_tiles / _windowSize;
+        int pos     = _rcs_prefix_tiles % _windowSize;
+        if(!get_bitmap_bit(window, pos))
+            break;
+        _rcs_prefix_crc = SCHC_GW_CRC32::update(_rcs_prefix_crc, get_tile(_rcs_prefix_tiles), _tileSize);
+        _rcs_prefix_tiles++;
     }
-
-    return crc ^ 0xFFFFFFFF;
 }
 
 int SCHC_GW_Ack_on_error::get_tile_ptr(uint8_t window, uint8_t fcn)
@@ -2051,6 +1744,19 @@ int SCHC_GW_Ack_on_error::get_tile_ptr(uint8_t window, uint8_t fcn)
     return -1;
 }
 
+char* SCHC_GW_Ack_on_error::get_tile(int tile)
+{
+    return _tilesArray + tile*_tileSize;
+}
+
+void SCHC_GW_Ack_on_error::free_reassembly()
+{
+    if(_reassembly == nullptr)
+        return;
+    ::operator delete[](_reassembly, std::align_val_t(SCHC_REASSEMBLY_ALIGN));
+    _reassembly = nullptr;
+}
+
 int SCHC_GW_Ack_on_error::get_bitmap_ptr(uint8_t fcn)
 {
     return (_windowSize - 1) - fcn;
@@ -2058,40 +1764,11 @@ int SCHC_GW_Ack_on_error::get_bitmap_ptr(uint8_t fcn)
 
 void SCHC_GW_Ack_on_error::print_tail_array_hex()
 {
-    // Calcular el tamaño total necesario para el buffer de todos los tiles
+    // Los tiles son contiguos en la arena de la sesion
     int len = _nTotalTiles * _tileSize;   // 2520 bytes
 
-    // Crear un buffer para almacenar todos los valores
-    char buffer[len];
-
-    int k=0;
-    for(int i=0; i<_nTotalTiles; i++)
-    {
-        for(int j=0; j<_tileSize; j++)
-        {
-            buffer[k] = _tilesArray[i][j];
-            k++;
-        } 
-    }
-
-    string resultado;
-
-    for (size_t i = 0; i < len; ++i) 
-    {
-        unsigned char valor = static_cast<unsigned char>(buffer[i]);
-        resultado += fmt::format("{:02X}", valor);
-    }
-
-    // Imprimir usando spdlog
-    SPDLOG_WARN("Tile Array (hex): {}", resultado);
-
-    string resultado2;
-    for (size_t i = 0; i < _tileSize; ++i) 
-    {
-        unsigned char valor = static_cast<unsigned char>(_last_tile[i]);
-        resultado2 += fmt::format("{:02X}", valor);
-    }
-    SPDLOG_WARN("Last Tile (hex): {}", resultado2);
+    SPDLOG_WARN("Tile Array (hex): {:X}", SCHC_GW_Hex(_tilesArray, len));
+    SPDLOG_WARN("Last Tile (hex): {:X}", SCHC_GW_Hex(_last_tile, _tileSize));
 
 
 }
@@ -2100,18 +1777,12 @@ void SCHC_GW_Ack_on_error::print_bitmap_array_str()
 {
     for(int i=0; i<_nMaxWindows; i++)
     {
-        ostringstream oss;
-        oss << "Bitmap window " + to_string(i) + ": " + get_bitmap_array_str(i);
-        SPDLOG_WARN("{}", oss.str());
+        SPDLOG_WARN("Bitmap window {}: {}", i, get_bitmap(i));
     }
 }
 
-string SCHC_GW_Ack_on_error::get_bitmap_array_str(uint8_t window)
+SCHC_GW_Bitmap SCHC_GW_Ack_on_error::get_bitmap(uint8_t window)
 {
-    string bitmap_str = "";
-    for(int i=0; i<_windowSize; i++)
-    {
-        bitmap_str = bitmap_str + to_string(_bitmapArray[window][i]);
-    }
-    return bitmap_str;
+    /* El string del bitmap se genera solo si el log se escribe */
+    return SCHC_GW_Bitmap(_bitmapArray[window], _windowSize);
 }
@@ -0,0 +1,80 @@
+#include "SCHC_GW_Alloc_Counter.hpp"
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#ifdef SCHC_GW_COUNT_ALLOCS
+
+static std::atomic<uint64_t>    g_allocs{0};
+static thread_local uint64_t    t_allocs = 0;
+
+void* operator new(std::size_t size)
+{
+    g_allocs.fetch_add(1, std::memory_order_relaxed);
+    t_allocs++;
+    if(size == 0)
+        size = 1;
+    void* ptr = std::malloc(size);
+    if(ptr == nullptr)
+        throw std::bad_alloc();
+    return ptr;
+}
+
+void* operator new[](std::size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void* ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr, std::size_t) noexcept
+{
+    std::free(ptr);
+}
+
+bool SCHC_GW_Alloc_Counter::is_enabled()
+{
+    return true;
+}
+
+uint64_t SCHC_GW_Alloc_Counter::get_allocs()
+{
+    return g_allocs.load(std::memory_order_relaxed);
+}
+
+uint64_t SCHC_GW_Alloc_Counter::get_thread_allocs()
+{
+    return t_allocs;
+}
+
+#else
+
+bool SCHC_GW_Alloc_Counter::is_enabled()
+{
+    return false;
+}
+
+uint64_t SCHC_GW_Alloc_Counter::get_allocs()
+{
+    return 0;
+}
+
+uint64_t SCHC_GW_Alloc_Counter::get_thread_allocs()
+{
+    return 0;
+}
+
+#endif
@@ -0,0 +1,53 @@
+#include "SCHC_GW_Association_Map.hpp"
+
+int SCHC_GW_Association_Map::find(uint32_t device)
+{
+    Shard& shard = get_shard(device);
+    std::shared_lock<std::shared_mutex> lock(shard.mutex);
+    auto it = shard.map.find(device);
+    if(it == shard.map.end())
+        return -1;
+    return it->second;
+}
+
+bool SCHC_GW_Association_Map::insert(uint32_t device, int session_id)
+{
+    Shard& shard = get_shard(device);
+    std::unique_lock<std::shared_mutex> lock(shard.mutex);
+    return shard.map.insert({device, session_id}).second;
+}
+
+bool SCHC_GW_Association_Map::erase(uint32_t device)
+{
+    Shard& shard = get_shard(device);
+    std::unique_lock<std::shared_mutex> lock(shard.mutex);
+    return shard.map.erase(device) == 1;
+}
+
+bool SCHC_GW_Association_Map::erase_if_equal(uint32_t device, int session_id)
+{
+    Shard& shard = get_shard(device);
+    std::unique_lock<std::shared_mutex> lock(shard.mutex);
+    auto it = shard.map.find(device);
+    if(it == shard.map.end() || it->second != session_id)
+        return false;
+    shard.map.erase(it);
+    return true;
+}
+
+size_t SCHC_GW_Association_Map::size()
+{
+    size_t size = 0;
+    for(int i=0; i<SCHC_GW_ASSOCIATION_SHARDS; i++)
+    {
+        std::shared_lock<std::shared_mutex> lock(_shards[i].mutex);
+        size += _shards[i].map.size();
+    }
+    return size;
+}
+
+SCHC_GW_Association_Map::Shard& SCHC_GW_Association_Map::get_shard(uint32_t device)
+{
+    /* Los bits bajos del handle eligen el shard */
+    return _shards[device & (SCHC_GW_ASSOCIATION_SHARDS - 1)];
+}
@@ -0,0 +1,488 @@
+#include "SCHC_GW_Base64.hpp"
+#include <array>
+#include <atomic>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SCHC_BASE64_HAVE_X86
+#endif
+
+#if defined(__aarch64__)
+#include <arm_neon.h>
+#define SCHC_BASE64_HAVE_NEON
+#endif
+
+typedef void (*base64_encode_fn)(const uint8_t* data, int len, uint8_t* out);
+typedef int  (*base64_decode_fn)(const uint8_t* encoded, int len, uint8_t* out, int out_cap);
+
+static const char BASE64_ALPHABET[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
+    "abcdefghijklmnopqrstuvwxyz"
+    "0123456789+/";
+
+/* Tabla de decodificacion: valor de 6 bits de cada caracter o 0xFF si no pertenece al alfabeto */
+static constexpr std::array<uint8_t, 256> make_decode_table()
+{
+    std::array<uint8_t, 256> table{};
+    for(int i=0; i<256; i++)
+    {
+        table[i] = 0xFF;
+    }
+    for(int i=0; i<64; i++)
+    {
+        table[static_cast<uint8_t>(BASE64_ALPHABET[i])] = i;
+    }
+    return table;
+}
+
+static constexpr std::array<uint8_t, 256> BASE64_DECODE_TABLE = make_decode_table();
+
+static void base64_encode_scalar(const uint8_t* data, int len, uint8_t* out)
+{
+    int i = 0;
+    while(i + 3 <= len)
+    {
+        uint32_t v = (uint32_t(data[i]) << 16) | (uint32_t(data[i+1]) << 8) | data[i+2];
+        out[0] = BASE64_ALPHABET[(v >> 18) & 0x3F];
+        out[1] = BASE64_ALPHABET[(v >> 12) & 0x3F];
+        out[2] = BASE64_ALPHABET[(v >> 6) & 0x3F];
+        out[3] = BASE64_ALPHABET[v & 0x3F];
+        out = out + 4;
+        i   = i + 3;
+    }
+
+    // ultimo grupo incompleto, completado con '='
+    if(len - i == 1)
+    {
+        uint32_t v = uint32_t(data[i]) << 16;
+        out[0] = BASE64_ALPHABET[(v >> 18) & 0x3F];
+        out[1] = BASE64_ALPHABET[(v >> 12) & 0x3F];
+        out[2] = '=';
+        out[3] = '=';
+    }
+    else if(len - i == 2)
+    {
+        uint32_t v = (uint32_t(data[i]) << 16) | (uint32_t(data[i+1]) << 8);
+        out[0] = BASE64_ALPHABET[(v >> 18) & 0x3F];
+        out[1] = BASE64_ALPHABET[(v >> 12) & 0x3F];
+        out[2] = BASE64_ALPHABET[(v >> 6) & 0x3F];
+        out[3] = '=';
+    }
+}
+
+static int base64_decode_scalar(const uint8_t* encoded, int len, uint8_t* out, int out_cap)
+{
+    /* Retorna el numero de bytes decodificados o -1 si no caben en out_cap */
+    int i = 0;
+    int o = 0;
+    while(i + 4 <= len)
+    {
+        uint32_t a = BASE64_DECODE_TABLE[encoded[i]];
+        uint32_t b = BASE64_DECODE_TABLE[encoded[i+1]];
+        uint32_t c = BASE64_DECODE_TABLE[encoded[i+2]];
+        uint32_t d = BASE64_DECODE_TABLE[encoded[i+3]];
+        if((a | b | c | d) & 0x80)      // algun caracter fuera del alfabeto (0xFF)
+            break;
+        if(o + 3 > out_cap)
+            return -1;
+        uint32_t v = (a << 18) | (b << 12) | (c << 6) | d;
+        out[o]      = uint8_t(v >> 16);
+        out[o+1]    = uint8_t(v >> 8);
+        out[o+2]    = uint8_t(v);
+        o = o + 3;
+        i = i + 4;
+    }
+
+    // ultimos caracteres validos (hasta 3, o hasta el primer caracter fuera del alfabeto)
+    uint32_t v = 0;
+    int      n = 0;
+    while(i < len && n < 4 && BASE64_DECODE_TABLE[encoded[i]] != 0xFF)
+    {
+        v = (v << 6) | BASE64_DECODE_TABLE[encoded[i]];
+        i++;
+        n++;
+    }
+    int n_bytes = (n * 6) / 8;
+    if(o + n_bytes > out_cap)
+        return -1;
+    if(n == 2)
+    {
+        out[o] = uint8_t(v >> 4);
+    }
+    else if(n == 3)
+    {
+        out[o]      = uint8_t(v >> 10);
+        out[o+1]    = uint8_t(v >> 2);
+    }
+    return o + n_bytes;
+}
+
+#ifdef SCHC_BASE64_HAVE_X86
+/* Implementaciones SIMD basadas en los algoritmos de W. Mula y D. Lemire
+("Faster Base64 Encoding and Decoding Using AVX2 Instructions", 2018) */
+
+__attribute__((target("ssse3,sse4.1")))
+static inline __m128i base64_encode_sse41_lookup(__m128i indices)
+{
+    // convierte valores de 6 bits a caracteres ASCII sumando un desplazamiento por rango
+    const __m128i shift_lut = _mm_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                            '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62,
+                                            '/' - 63, 'A', 0, 0);
+    __m128i result      = _mm_subs_epu8(indices, _mm_set1_epi8(51));
+    __m128i less        = _mm_cmpgt_epi8(_mm_set1_epi8(26), indices);
+    result              = _mm_or_si128(result, _mm_and_si128(less, _mm_set1_epi8(13)));
+    result              = _mm_shuffle_epi8(shift_lut, result);
+    return _mm_add_epi8(result, indices);
+}
+
+__attribute__((target("ssse3,sse4.1")))
+static void base64_encode_sse41(const uint8_t* data, int len, uint8_t* out)
+{
+    // 12 bytes de entrada -> 16 caracteres. Se leen 16 bytes, por lo que quedan 4 de margen
+    int i = 0;
+    while(i + 16 <= len)
+    {
+        __m128i in      = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        in              = _mm_shuffle_epi8(in, _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1));
+        __m128i t0      = _mm_and_si128(in, _mm_set1_epi32(0x0fc0fc00));
+        __m128i t1      = _mm_mulhi_epu16(t0, _mm_set1_epi32(0x04000040));
+        __m128i t2      = _mm_and_si128(in, _mm_set1_epi32(0x003f03f0));
+        __m128i t3      = _mm_mullo_epi16(t2, _mm_set1_epi32(0x01000010));
+        __m128i indices = _mm_or_si128(t1, t3);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out), base64_encode_sse41_lookup(indices));
+        out = out + 16;
+        i   = i + 12;
+    }
+    base64_encode_scalar(data + i, len - i, out);
+}
+
+__attribute__((target("ssse3,sse4.1")))
+static int base64_decode_sse41(const uint8_t* encoded, int len, uint8_t* out, int out_cap)
+{
+    // 16 caracteres -> 12 bytes. Se escriben 16 bytes, por lo que se necesitan 4 de margen
+    const __m128i lut_lo    = _mm_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+                                            0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+    const __m128i lut_hi    = _mm_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+                                            0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+    const __m128i lut_roll  = _mm_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+    const __m128i nibble    = _mm_set1_epi8(0x0F);
+    const __m128i slash     = _mm_set1_epi8(0x2F);
+    int i = 0;
+    int o = 0;
+    while(i + 16 <= len && o + 16 <= out_cap)
+    {
+        __m128i str         = _mm_loadu_si128(reinterpret_cast<const __m128i*>(encoded + i));
+        __m128i hi_nibbles  = _mm_and_si128(_mm_srli_epi32(str, 4), nibble);
+        __m128i lo_nibbles  = _mm_and_si128(str, nibble);
+        __m128i lo          = _mm_shuffle_epi8(lut_lo, lo_nibbles);
+        __m128i hi          = _mm_shuffle_epi8(lut_hi, hi_nibbles);
+        if(!_mm_testz_si128(lo, hi))
+            break;      // hay un caracter fuera del alfabeto: el resto lo procesa la version escalar
+
+        __m128i eq_slash    = _mm_cmpeq_epi8(str, slash);
+        __m128i roll        = _mm_shuffle_epi8(lut_roll, _mm_add_epi8(eq_slash, hi_nibbles));
+        __m128i values      = _mm_add_epi8(str, roll);
+
+        // empaqueta 4 valores de 6 bits en 3 bytes
+        __m128i merged      = _mm_maddubs_epi16(values, _mm_set1_epi32(0x01400140));
+        __m128i packed      = _mm_madd_epi16(merged, _mm_set1_epi32(0x00011000));
+        packed              = _mm_shuffle_epi8(packed, _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + o), packed);
+        o = o + 12;
+        i = i + 16;
+    }
+    int n = base64_decode_scalar(encoded + i, len - i, out + o, out_cap - o);
+    return (n < 0) ? -1 : o + n;
+}
+
+__attribute__((target("avx2")))
+static void base64_encode_avx2(const uint8_t* data, int len, uint8_t* out)
+{
+    // 24 bytes de entrada -> 32 caracteres. Cada mitad del registro lee 16 bytes y usa 12
+    const __m256i shuffle   = _mm256_setr_epi8(1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10,
+                                               1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10);
+    const __m256i shift_lut = _mm256_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                               '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62,
+                                               '/' - 63, 'A', 0, 0,
+                                               'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                               '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62,
+                                               '/' - 63, 'A', 0, 0);
+    int i = 0;
+    while(i + 28 <= len)
+    {
+        __m128i lo_half = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        __m128i hi_half = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i + 12));
+        __m256i in      = _mm256_inserti128_si256(_mm256_castsi128_si256(lo_half), hi_half, 1);
+        in              = _mm256_shuffle_epi8(in, shuffle);
+        __m256i t0      = _mm256_and_si256(in, _mm256_set1_epi32(0x0fc0fc00));
+        __m256i t1      = _mm256_mulhi_epu16(t0, _mm256_set1_epi32(0x04000040));
+        __m256i t2      = _mm256_and_si256(in, _mm256_set1_epi32(0x003f03f0));
+        __m256i t3      = _mm256_mullo_epi16(t2, _mm256_set1_epi32(0x01000010));
+        __m256i indices = _mm256_or_si256(t1, t3);
+
+        __m256i result  = _mm256_subs_epu8(indices, _mm256_set1_epi8(51));
+        __m256i less    = _mm256_cmpgt_epi8(_mm256_set1_epi8(26), indices);
+        result          = _mm256_or_si256(result, _mm256_and_si256(less, _mm256_set1_epi8(13)));
+        result          = _mm256_shuffle_epi8(shift_lut, result);
+        result          = _mm256_add_epi8(result, indices);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out), result);
+        out = out + 32;
+        i   = i + 24;
+    }
+    base64_encode_scalar(data + i, len - i, out);
+}
+
+__attribute__((target("avx2")))
+static int base64_decode_avx2(const uint8_t* encoded, int len, uint8_t* out, int out_cap)
+{
+    // 32 caracteres -> 24 bytes. Se escriben 32 bytes, por lo que se necesitan 8 de margen
+    const __m256i lut_lo    = _mm256_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+                                               0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A,
+                                               0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+                                               0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+    const __m256i lut_hi    = _mm256_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+                                               0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+                                               0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+                                               0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+    const __m256i lut_roll  = _mm256_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0,
+                                               0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+    const __m256i pack      = _mm256_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+                                               2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+    const __m256i nibble    = _mm256_set1_epi8(0x0F);
+    const __m256i slash     = _mm256_set1_epi8(0x2F);
+    int i = 0;
+    int o = 0;
+    while(i + 32 <= len && o + 32 <= out_cap)
+    {
+        __m256i str         = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(encoded + i));
+        __m256i hi_nibbles  = _mm256_and_si256(_mm256_srli_epi32(str, 4), nibble);
+        __m256i lo_nibbles  = _mm256_and_si256(str, nibble);
+        __m256i lo          = _mm256_shuffle_epi8(lut_lo, lo_nibbles);
+        __m256i hi          = _mm256_shuffle_epi8(lut_hi, hi_nibbles);
+        if(!_mm256_testz_si256(lo, hi))
+            break;      // hay un caracter fuera del alfabeto: el resto lo procesa la version escalar
+
+        __m256i eq_slash    = _mm256_cmpeq_epi8(str, slash);
+        __m256i roll        = _mm256_shuffle_epi8(lut_roll, _mm256_add_epi8(eq_slash, hi_nibbles));
+        __m256i values      = _mm256_add_epi8(str, roll);
+
+        // empaqueta 4 valores de 6 bits en 3 bytes y junta los 12 bytes de cada mitad
+        __m256i merged      = _mm256_maddubs_epi16(values, _mm256_set1_epi32(0x01400140));
+        __m256i packed      = _mm256_madd_epi16(merged, _mm256_set1_epi32(0x00011000));
+        packed              = _mm256_shuffle_epi8(packed, pack);
+        packed              = _mm256_permutevar8x32_epi32(packed, _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + o), packed);
+        o = o + 24;
+        i = i + 32;
+    }
+    int n = base64_decode_sse41(encoded + i, len - i, out + o, out_cap - o);
+    return (n < 0) ? -1 : o + n;
+}
+#endif
+
+#ifdef SCHC_BASE64_HAVE_NEON
+static inline uint8x16x4_t load_table_neon(const uint8_t* table)
+{
+    uint8x16x4_t t;
+    t.val[0] = vld1q_u8(table);
+    t.val[1] = vld1q_u8(table + 16);
+    t.val[2] = vld1q_u8(table + 32);
+    t.val[3] = vld1q_u8(table + 48);
+    return t;
+}
+
+static void base64_encode_neon(const uint8_t* data, int len, uint8_t* out)
+{
+    // 48 bytes de entrada -> 64 caracteres
+    const uint8x16x4_t  alphabet    = load_table_neon(reinterpret_cast<const uint8_t*>(BASE64_ALPHABET));
+    const uint8x16_t    mask        = vdupq_n_u8(0x3F);
+    int i = 0;
+    while(i + 48 <= len)
+    {
+        uint8x16x3_t in = vld3q_u8(data + i);
+        uint8x16x4_t chars;
+        chars.val[0] = vshrq_n_u8(in.val[0], 2);
+        chars.val[1] = vandq_u8(vorrq_u8(vshlq_n_u8(in.val[0], 4), vshrq_n_u8(in.val[1], 4)), mask);
+        chars.val[2] = vandq_u8(vorrq_u8(vshlq_n_u8(in.val[1], 2), vshrq_n_u8(in.val[2], 6)), mask);
+        chars.val[3] = vandq_u8(in.val[2], mask);
+        chars.val[0] = vqtbl4q_u8(alphabet, chars.val[0]);
+        chars.val[1] = vqtbl4q_u8(alphabet, chars.val[1]);
+        chars.val[2] = vqtbl4q_u8(alphabet, chars.val[2]);
+        chars.val[3] = vqtbl4q_u8(alphabet, chars.val[3]);
+        vst4q_u8(out, chars);
+        out = out + 64;
+        i   = i + 48;
+    }
+    base64_encode_scalar(data + i, len - i, out);
+}
+
+static int base64_decode_neon(const uint8_t* encoded, int len, uint8_t* out, int out_cap)
+{
+    // 64 caracteres -> 48 bytes. La tabla de decodificacion de 128 entradas se consulta en dos mitades
+    const uint8x16x4_t  table_lo    = load_table_neon(BASE64_DECODE_TABLE.data());
+    const uint8x16x4_t  table_hi    = load_table_neon(BASE64_DECODE_TABLE.data() + 64);
+    const uint8x16_t    offset      = vdupq_n_u8(64);
+    int i = 0;
+    int o = 0;
+    while(i + 64 <= len && o + 48 <= out_cap)
+    {
+        uint8x16x4_t str = vld4q_u8(encoded + i);
+        uint8x16x4_t values;
+        uint8x16_t   error = vdupq_n_u8(0);
+        for(int k=0; k<4; k++)
+        {
+            values.val[k]   = vqtbl4q_u8(table_lo, str.val[k]);
+            values.val[k]   = vqtbx4q_u8(values.val[k], table_hi, vsubq_u8(str.val[k], offset));
+            // los caracteres invalidos valen 0xFF y los no ASCII tienen el bit 7 en 1
+            error           = vorrq_u8(error, vorrq_u8(values.val[k], str.val[k]));
+        }
+        if(vmaxvq_u8(error) & 0x80)
+            break;      // hay un caracter fuera del alfabeto: el resto lo procesa la version escalar
+
+        uint8x16x3_t bytes;
+        bytes.val[0] = vorrq_u8(vshlq_n_u8(values.val[0], 2), vshrq_n_u8(values.val[1], 4));
+        bytes.val[1] = vorrq_u8(vshlq_n_u8(values.val[1], 4), vshrq_n_u8(values.val[2], 2));
+        bytes.val[2] = vorrq_u8(vshlq_n_u8(values.val[2], 6), values.val[3]);
+        vst3q_u8(out + o, bytes);
+        o = o + 48;
+        i = i + 64;
+    }
+    int n = base64_decode_scalar(encoded + i, len - i, out + o, out_cap - o);
+    return (n < 0) ? -1 : o + n;
+}
+#endif
+
+static base64_encode_fn get_encode_fn(uint8_t impl)
+{
+    switch(impl)
+    {
+        case SCHC_BASE64_SCALAR:    return base64_encode_scalar;
+#ifdef SCHC_BASE64_HAVE_X86
+        case SCHC_BASE64_SSE41:     return base64_encode_sse41;
+        case SCHC_BASE64_AVX2:      return base64_encode_avx2;
+#endif
+#ifdef SCHC_BASE64_HAVE_NEON
+        case SCHC_BASE64_NEON:      return base64_encode_neon;
+#endif
+        default:                    return nullptr;
+    }
+}
+
+static base64_decode_fn get_decode_fn(uint8_t impl)
+{
+    switch(impl)
+    {
+        case SCHC_BASE64_SCALAR:    return base64_decode_scalar;
+#ifdef SCHC_BASE64_HAVE_X86
+        case SCHC_BASE64_SSE41:     return base64_decode_sse41;
+        case SCHC_BASE64_AVX2:      return base64_decode_avx2;
+#endif
+#ifdef SCHC_BASE64_HAVE_NEON
+        case SCHC_BASE64_NEON:      return base64_decode_neon;
+#endif
+        default:                    return nullptr;
+    }
+}
+
+static uint8_t detect_impl()
+{
+    /* Se elige la implementacion soportada mas rapida */
+    if(SCHC_GW_Base64::is_supported(SCHC_BASE64_NEON))
+        return SCHC_BASE64_NEON;
+    if(SCHC_GW_Base64::is_supported(SCHC_BASE64_AVX2))
+        return SCHC_BASE64_AVX2;
+    if(SCHC_GW_Base64::is_supported(SCHC_BASE64_SSE41))
+        return SCHC_BASE64_SSE41;
+    return SCHC_BASE64_SCALAR;
+}
+
+static std::atomic<uint8_t>             s_impl{detect_impl()};
+static std::atomic<base64_encode_fn>    s_encode{get_encode_fn(s_impl.load())};
+static std::atomic<base64_decode_fn>    s_decode{get_decode_fn(s_impl.load())};
+
+int SCHC_GW_Base64::encoded_len(int len)
+{
+    return ((len + 2) / 3) * 4;
+}
+
+int SCHC_GW_Base64::encode(const char* data, int len, char* out)
+{
+    s_encode.load(std::memory_order_relaxed)(reinterpret_cast<const uint8_t*>(data), len, reinterpret_cast<uint8_t*>(out));
+    return encoded_len(len);
+}
+
+uint8_t SCHC_GW_Base64::decode(const char* encoded, int len, char* out, int out_cap, int& out_len)
+{
+    int n = s_decode.load(std::memory_order_relaxed)(reinterpret_cast<const uint8_t*>(encoded), len, reinterpret_cast<uint8_t*>(out), out_cap);
+    if(n < 0)
+        return 1;
+    out_len = n;
+    return 0;
+}
+
+int SCHC_GW_Base64::encode_with(uint8_t impl, const char* data, int len, char* out)
+{
+    base64_encode_fn fn = is_supported(impl) ? get_encode_fn(impl) : base64_encode_scalar;
+    fn(reinterpret_cast<const uint8_t*>(data), len, reinterpret_cast<uint8_t*>(out));
+    return encoded_len(len);
+}
+
+uint8_t SCHC_GW_Base64::decode_with(uint8_t impl, const char* encoded, int len, char* out, int out_cap, int& out_len)
+{
+    base64_decode_fn fn = is_supported(impl) ? get_decode_fn(impl) : base64_decode_scalar;
+    int n = fn(reinterpret_cast<const uint8_t*>(encoded), len, reinterpret_cast<uint8_t*>(out), out_cap);
+    if(n < 0)
+        return 1;
+    out_len = n;
+    return 0;
+}
+
+bool SCHC_GW_Base64::is_supported(uint8_t impl)
+{
+    switch(impl)
+    {
+        case SCHC_BASE64_SCALAR:
+            return true;
+#ifdef SCHC_BASE64_HAVE_X86
+        case SCHC_BASE64_SSE41:
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("ssse3") && __builtin_cpu_supports("sse4.1");
+        case SCHC_BASE64_AVX2:
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("avx2");
+#endif
+#ifdef SCHC_BASE64_HAVE_NEON
+        case SCHC_BASE64_NEON:
+            return true;    // Advanced SIMD es obligatorio en aarch64
+#endif
+        default:
+            return false;
+    }
+}
+
+uint8_t SCHC_GW_Base64::get_impl()
+{
+    return s_impl.load();
+}
+
+uint8_t SCHC_GW_Base64::set_impl(uint8_t impl)
+{
+    if(!is_supported(impl))
+        return 1;
+    s_encode.store(get_encode_fn(impl));
+    s_decode.store(get_decode_fn(impl));
+    s_impl.store(impl);
+    return 0;
+}
+
+const char* SCHC_GW_Base64::get_impl_name(uint8_t impl)
+{
+    switch(impl)
+    {
+        case SCHC_BASE64_SCALAR:    return "scalar";
+        case SCHC_BASE64_SSE41:     return "sse4.1";
+        case SCHC_BASE64_AVX2:      return "avx2";
+        case SCHC_BASE64_NEON:      return "neon";
+        default:                    return "unknown";
+    }
+}
\ No newline at end of file
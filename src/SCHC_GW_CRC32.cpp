@@ -0,0 +1,318 @@
+#include "SCHC_GW_CRC32.hpp"
+#include <array>
+#include <atomic>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SCHC_CRC32_HAVE_PCLMUL
+#endif
+
+#if defined(__aarch64__) && defined(__linux__)
+#include <arm_acle.h>
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#define SCHC_CRC32_HAVE_ARMV8
+#endif
+
+typedef uint32_t (*crc32_update_fn)(uint32_t crc, const uint8_t* data, size_t len);
+
+static const uint32_t CRC32_POLYNOMIAL = 0xEDB88320;      // polinomio CRC32 (reflejado)
+
+/* Tablas de slicing-by-8. La tabla 0 es la tabla clasica de 256 entradas */
+static constexpr std::array<std::array<uint32_t, 256>, 8> make_crc32_tables()
+{
+    std::array<std::array<uint32_t, 256>, 8> tables{};
+    for(uint32_t i=0; i<256; i++)
+    {
+        uint32_t crc = i;
+        for(int j=0; j<8; j++)
+        {
+            crc = (crc & 1) ? (crc >> 1) ^ CRC32_POLYNOMIAL : (crc >> 1);
+        }
+        tables[0][i] = crc;
+    }
+    for(int k=1; k<8; k++)
+    {
+        for(int i=0; i<256; i++)
+        {
+            tables[k][i] = (tables[k-1][i] >> 8) ^ tables[0][tables[k-1][i] & 0xFF];
+        }
+    }
+    return tables;
+}
+
+static constexpr std::array<std::array<uint32_t, 256>, 8> CRC32_TABLES = make_crc32_tables();
+
+static inline uint32_t load_le32(const uint8_t* p)
+{
+    return uint32_t(p[0]) | (uint32_t(p[1]) << 8) | (uint32_t(p[2]) << 16) | (uint32_t(p[3]) << 24);
+}
+
+static uint32_t crc32_update_bitwise(uint32_t crc, const uint8_t* data, size_t len)
+{
+    for(size_t i=0; i<len; i++)
+    {
+        crc ^= data[i];
+        for(int j=0; j<8; j++)
+        {
+            if(crc & 1)
+                crc = (crc >> 1) ^ CRC32_POLYNOMIAL;
+            else
+                crc >>= 1;
+        }
+    }
+    return crc;
+}
+
+static uint32_t crc32_update_table(uint32_t crc, const uint8_t* data, size_t len)
+{
+    for(size_t i=0; i<len; i++)
+    {
+        crc = (crc >> 8) ^ CRC32_TABLES[0][(crc ^ data[i]) & 0xFF];
+    }
+    return crc;
+}
+
+static uint32_t crc32_update_slicing8(uint32_t crc, const uint8_t* data, size_t len)
+{
+    while(len >= 8)
+    {
+        uint32_t one = load_le32(data) ^ crc;
+        uint32_t two = load_le32(data + 4);
+        crc = CRC32_TABLES[7][one & 0xFF]         ^ CRC32_TABLES[6][(one >> 8) & 0xFF] ^
+              CRC32_TABLES[5][(one >> 16) & 0xFF] ^ CRC32_TABLES[4][one >> 24]         ^
+              CRC32_TABLES[3][two & 0xFF]         ^ CRC32_TABLES[2][(two >> 8) & 0xFF] ^
+              CRC32_TABLES[1][(two >> 16) & 0xFF] ^ CRC32_TABLES[0][two >> 24];
+        data += 8;
+        len  -= 8;
+    }
+    return crc32_update_table(crc, data, len);
+}
+
+#ifdef SCHC_CRC32_HAVE_PCLMUL
+/* Folding con multiplicacion sin acarreo (Intel, "Fast CRC Computation for Generic
+Polynomials Using PCLMULQDQ Instruction"). Se procesan bloques de 64 bytes en 4
+acumuladores de 128 bits, luego se reduce a 128, 64 y finalmente 32 bits con Barrett.
+Requiere al menos 64 bytes; el resto (< 16 bytes) se procesa con slicing-by-8. */
+__attribute__((target("pclmul,sse4.1")))
+static uint32_t crc32_update_pclmul(uint32_t crc, const uint8_t* data, size_t len)
+{
+    if(len < 64)
+        return crc32_update_slicing8(crc, data, len);
+
+    alignas(16) static const uint64_t k1k2[] = { 0x0154442bd4, 0x01c6e41596 };
+    alignas(16) static const uint64_t k3k4[] = { 0x01751997d0, 0x00ccaa009e };
+    alignas(16) static const uint64_t k5k0[] = { 0x0163cd6124, 0x0000000000 };
+    alignas(16) static const uint64_t poly[] = { 0x01db710641, 0x01f7011641 };
+
+    size_t tail = len & 15;
+    len -= tail;
+
+    __m128i x0, x1, x2, x3, x4, x5, x6, x7, x8, y5, y6, y7, y8;
+
+    x1 = _mm_loadu_si128((const __m128i*)(data + 0x00));
+    x2 = _mm_loadu_si128((const __m128i*)(data + 0x10));
+    x3 = _mm_loadu_si128((const __m128i*)(data + 0x20));
+    x4 = _mm_loadu_si128((const __m128i*)(data + 0x30));
+    x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128(crc));
+    x0 = _mm_load_si128((const __m128i*)k1k2);
+    data += 64;
+    len  -= 64;
+
+    /* Fold de bloques de 64 bytes */
+    while(len >= 64)
+    {
+        x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x6 = _mm_clmulepi64_si128(x2, x0, 0x00);
+        x7 = _mm_clmulepi64_si128(x3, x0, 0x00);
+        x8 = _mm_clmulepi64_si128(x4, x0, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+        x2 = _mm_clmulepi64_si128(x2, x0, 0x11);
+        x3 = _mm_clmulepi64_si128(x3, x0, 0x11);
+        x4 = _mm_clmulepi64_si128(x4, x0, 0x11);
+        y5 = _mm_loadu_si128((const __m128i*)(data + 0x00));
+        y6 = _mm_loadu_si128((const __m128i*)(data + 0x10));
+        y7 = _mm_loadu_si128((const __m128i*)(data + 0x20));
+        y8 = _mm_loadu_si128((const __m128i*)(data + 0x30));
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), y5);
+        x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), y6);
+        x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), y7);
+        x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), y8);
+        data += 64;
+        len  -= 64;
+    }
+
+    /* Fold de los 4 acumuladores a 128 bits */
+    x0 = _mm_load_si128((const __m128i*)k3k4);
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x3), x5);
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x4), x5);
+
+    /* Fold de bloques de 16 bytes */
+    while(len >= 16)
+    {
+        x2 = _mm_loadu_si128((const __m128i*)data);
+        x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+        data += 16;
+        len  -= 16;
+    }
+
+    /* 128 -> 64 bits */
+    x2 = _mm_clmulepi64_si128(x1, x0, 0x10);
+    x3 = _mm_setr_epi32(~0, 0, ~0, 0);
+    x1 = _mm_srli_si128(x1, 8);
+    x1 = _mm_xor_si128(x1, x2);
+    x0 = _mm_loadl_epi64((const __m128i*)k5k0);
+    x2 = _mm_srli_si128(x1, 4);
+    x1 = _mm_and_si128(x1, x3);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+
+    /* Reduccion de Barrett a 32 bits */
+    x0 = _mm_load_si128((const __m128i*)poly);
+    x2 = _mm_and_si128(x1, x3);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x10);
+    x2 = _mm_and_si128(x2, x3);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+    crc = _mm_extract_epi32(x1, 1);
+
+    return crc32_update_slicing8(crc, data, tail);
+}
+#endif
+
+#ifdef SCHC_CRC32_HAVE_ARMV8
+__attribute__((target("arch=armv8-a+crc")))
+static uint32_t crc32_update_armv8(uint32_t crc, const uint8_t* data, size_t len)
+{
+    while(len >= 8)
+    {
+        uint64_t value;
+        std::memcpy(&value, data, 8);
+        crc = __crc32d(crc, value);
+        data += 8;
+        len  -= 8;
+    }
+    while(len > 0)
+    {
+        crc = __crc32b(crc, *data);
+        data++;
+        len--;
+    }
+    return crc;
+}
+#endif
+
+static crc32_update_fn get_update_fn(uint8_t impl)
+{
+    switch(impl)
+    {
+        case SCHC_CRC32_BITWISE:    return crc32_update_bitwise;
+        case SCHC_CRC32_TABLE:      return crc32_update_table;
+        case SCHC_CRC32_SLICING8:   return crc32_update_slicing8;
+#ifdef SCHC_CRC32_HAVE_PCLMUL
+        case SCHC_CRC32_PCLMUL:     return crc32_update_pclmul;
+#endif
+#ifdef SCHC_CRC32_HAVE_ARMV8
+        case SCHC_CRC32_ARMV8:      return crc32_update_armv8;
+#endif
+        default:                    return nullptr;
+    }
+}
+
+static uint8_t detect_impl()
+{
+    /* Se elige la implementacion soportada mas rapida */
+    if(SCHC_GW_CRC32::is_supported(SCHC_CRC32_ARMV8))
+        return SCHC_CRC32_ARMV8;
+    if(SCHC_GW_CRC32::is_supported(SCHC_CRC32_PCLMUL))
+        return SCHC_CRC32_PCLMUL;
+    return SCHC_CRC32_SLICING8;
+}
+
+static std::atomic<uint8_t>         s_impl{detect_impl()};
+static std::atomic<crc32_update_fn> s_update{get_update_fn(s_impl.load())};
+
+uint32_t SCHC_GW_CRC32::init()
+{
+    return 0xFFFFFFFF;
+}
+
+uint32_t SCHC_GW_CRC32::update(uint32_t crc, const char* data, size_t len)
+{
+    return s_update.load(std::memory_order_relaxed)(crc, reinterpret_cast<const uint8_t*>(data), len);
+}
+
+uint32_t SCHC_GW_CRC32::finalize(uint32_t crc)
+{
+    return crc ^ 0xFFFFFFFF;
+}
+
+uint32_t SCHC_GW_CRC32::calculate(const char* data, size_t len)
+{
+    return finalize(update(init(), data, len));
+}
+
+uint32_t SCHC_GW_CRC32::update_with(uint8_t impl, uint32_t crc, const char* data, size_t len)
+{
+    crc32_update_fn fn = is_supported(impl) ? get_update_fn(impl) : crc32_update_slicing8;
+    return fn(crc, reinterpret_cast<const uint8_t*>(data), len);
+}
+
+bool SCHC_GW_CRC32::is_supported(uint8_t impl)
+{
+    switch(impl)
+    {
+        case SCHC_CRC32_BITWISE:
+        case SCHC_CRC32_TABLE:
+        case SCHC_CRC32_SLICING8:
+            return true;
+#ifdef SCHC_CRC32_HAVE_PCLMUL
+        case SCHC_CRC32_PCLMUL:
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("pclmul") && __builtin_cpu_supports("sse4.1");
+#endif
+#ifdef SCHC_CRC32_HAVE_ARMV8
+        case SCHC_CRC32_ARMV8:
+            return (getauxval(AT_HWCAP) & HWCAP_CRC32) != 0;
+#endif
+        default:
+            return false;
+    }
+}
+
+uint8_t SCHC_GW_CRC32::get_impl()
+{
+    return s_impl.load();
+}
+
+uint8_t SCHC_GW_CRC32::set_impl(uint8_t impl)
+{
+    if(!is_supported(impl))
+        return 1;
+    s_update.store(get_update_fn(impl));
+    s_impl.store(impl);
+    return 0;
+}
+
+const char* SCHC_GW_CRC32::get_impl_name(uint8_t impl)
+{
+    switch(impl)
+    {
+        case SCHC_CRC32_BITWISE:    return "bitwise";
+        case SCHC_CRC32_TABLE:      return "table";
+        case SCHC_CRC32_SLICING8:   return "slicing-by-8";
+        case SCHC_CRC32_PCLMUL:     return "pclmulqdq";
+        case SCHC_CRC32_ARMV8:      return "armv8-crc32";
+        default:                    return "unknown";
+    }
+}
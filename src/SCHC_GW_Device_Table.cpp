@@ -0,0 +1,176 @@
+#include "SCHC_GW_Device_Table.hpp"
+#include <atomic>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <vector>
+
+#define SCHC_GW_DEVICE_SHARD_MIN_SLOTS  64
+
+/* Slot de un shard: 0 si esta libre, (hash >> 32) << 32 | (handle + 1) si no. Los bits
+altos del hash eligen el shard y los siguientes el slot, por lo que al crecer el shard
+los slots se reubican sin el device id */
+struct alignas(64) SCHC_GW_Device_Shard
+{
+    std::shared_mutex       mutex;
+    std::vector<uint64_t>   slots;
+    size_t                  count = 0;
+};
+
+static SCHC_GW_Device_Shard                 shards[SCHC_GW_DEVICE_SHARDS];
+static std::mutex                           names_mutex;        // creacion de handles y arena de nombres
+static const char**                         names[SCHC_GW_DEVICE_MAX_BLOCKS];  // handle -> nombre
+static std::vector<std::unique_ptr<char[]>> arena;
+static size_t                               arena_used = SCHC_GW_DEVICE_ARENA_CHUNK;
+static std::atomic<uint32_t>                n_devices{0};
+static std::atomic<size_t>                  memory_usage{0};
+
+static SCHC_GW_Device_Shard& get_shard(uint64_t hash)
+{
+    return shards[(hash >> 32) & (SCHC_GW_DEVICE_SHARDS - 1)];
+}
+
+static size_t get_slot(uint64_t tagged, size_t mask)
+{
+    return (tagged >> 38) & mask;   // bits del hash por encima de los que eligen el shard
+}
+
+static uint32_t lookup(SCHC_GW_Device_Shard& shard, uint64_t hash, const char* dev_id, size_t len)
+{
+    if(shard.slots.empty())
+        return SCHC_GW_DEVICE_INVALID;
+
+    uint64_t tag    = hash & 0xFFFFFFFF00000000ULL;
+    size_t mask     = shard.slots.size() - 1;
+    for(size_t i = get_slot(hash, mask); shard.slots[i] != 0; i = (i + 1) & mask)
+    {
+        uint64_t slot = shard.slots[i];
+        if((slot & 0xFFFFFFFF00000000ULL) != tag)
+            continue;
+        uint32_t device         = uint32_t(slot) - 1;
+        std::string_view name   = SCHC_GW_Device_Table::get_device_id(device);
+        if(name.size() == len && memcmp(name.data(), dev_id, len) == 0)
+            return device;
+    }
+    return SCHC_GW_DEVICE_INVALID;
+}
+
+static void insert_slot(std::vector<uint64_t>& slots, uint64_t tagged)
+{
+    size_t mask = slots.size() - 1;
+    size_t i    = get_slot(tagged, mask);
+    while(slots[i] != 0)
+        i = (i + 1) & mask;
+    slots[i] = tagged;
+}
+
+static void grow(SCHC_GW_Device_Shard& shard)
+{
+    size_t capacity = shard.slots.empty() ? SCHC_GW_DEVICE_SHARD_MIN_SLOTS : shard.slots.size() * 2;
+    std::vector<uint64_t> slots(capacity, 0);
+    for(uint64_t tagged : shard.slots)
+    {
+        if(tagged != 0)
+            insert_slot(slots, tagged);
+    }
+    memory_usage.fetch_add((capacity - shard.slots.size()) * sizeof(uint64_t), std::memory_order_relaxed);
+    shard.slots.swap(slots);
+}
+
+static uint32_t add_name(const char* dev_id, size_t len)
+{
+    std::lock_guard<std::mutex> lock(names_mutex);
+    uint32_t device = n_devices.load(std::memory_order_relaxed);
+    if(device >= uint64_t(SCHC_GW_DEVICE_BLOCK_SIZE) * SCHC_GW_DEVICE_MAX_BLOCKS)
+        return SCHC_GW_DEVICE_INVALID;
+
+    if(arena_used + len + 2 > SCHC_GW_DEVICE_ARENA_CHUNK)
+    {
+        arena.emplace_back(new char[SCHC_GW_DEVICE_ARENA_CHUNK]);
+        arena_used = 0;
+        memory_usage.fetch_add(SCHC_GW_DEVICE_ARENA_CHUNK, std::memory_order_relaxed);
+    }
+    char* name = arena.back().get() + arena_used;
+    name[0] = char(len);
+    memcpy(name + 1, dev_id, len);
+    name[len + 1] = '\0';
+    arena_used = arena_used + len + 2;
+
+    const char**& block = names[device / SCHC_GW_DEVICE_BLOCK_SIZE];
+    if(block == nullptr)
+    {
+        block = new const char*[SCHC_GW_DEVICE_BLOCK_SIZE];
+        memory_usage.fetch_add(SCHC_GW_DEVICE_BLOCK_SIZE * sizeof(const char*), std::memory_order_relaxed);
+    }
+    block[device % SCHC_GW_DEVICE_BLOCK_SIZE] = name;
+    n_devices.store(device + 1, std::memory_order_release);
+    return device;
+}
+
+uint64_t SCHC_GW_Device_Table::hash_device_id(const char* dev_id, size_t len)
+{
+    /* FNV-1a de 64 bits */
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for(size_t i=0; i<len; i++)
+    {
+        hash ^= static_cast<unsigned char>(dev_id[i]);
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+uint32_t SCHC_GW_Device_Table::intern(const char* dev_id, size_t len)
+{
+    if(len == 0 || len > SCHC_GW_DEVICE_ID_MAX_LEN)
+        return SCHC_GW_DEVICE_INVALID;
+
+    uint64_t hash                   = hash_device_id(dev_id, len);
+    SCHC_GW_Device_Shard& shard     = get_shard(hash);
+    {
+        std::shared_lock<std::shared_mutex> lock(shard.mutex);
+        uint32_t device = lookup(shard, hash, dev_id, len);
+        if(device != SCHC_GW_DEVICE_INVALID)
+            return device;
+    }
+
+    /* Dispositivo nuevo. Se busca otra vez con el lock de escritura: otro hilo pudo crearlo */
+    std::unique_lock<std::shared_mutex> lock(shard.mutex);
+    uint32_t device = lookup(shard, hash, dev_id, len);
+    if(device != SCHC_GW_DEVICE_INVALID)
+        return device;
+
+    device = add_name(dev_id, len);
+    if(device == SCHC_GW_DEVICE_INVALID)
+        return SCHC_GW_DEVICE_INVALID;
+    if((shard.count + 1) * 2 > shard.slots.size())
+        grow(shard);
+    insert_slot(shard.slots, (hash & 0xFFFFFFFF00000000ULL) | (uint64_t(device) + 1));
+    shard.count++;
+    return device;
+}
+
+uint32_t SCHC_GW_Device_Table::find(const char* dev_id, size_t len)
+{
+    uint64_t hash                   = hash_device_id(dev_id, len);
+    SCHC_GW_Device_Shard& shard     = get_shard(hash);
+    std::shared_lock<std::shared_mutex> lock(shard.mutex);
+    return lookup(shard, hash, dev_id, len);
+}
+
+std::string_view SCHC_GW_Device_Table::get_device_id(uint32_t device)
+{
+    /* El handle se obtuvo de intern(), que publica el nombre antes de retornar */
+    const char* name = names[device / SCHC_GW_DEVICE_BLOCK_SIZE][device % SCHC_GW_DEVICE_BLOCK_SIZE];
+    return std::string_view(name + 1, static_cast<unsigned char>(name[0]));
+}
+
+size_t SCHC_GW_Device_Table::size()
+{
+    return n_devices.load(std::memory_order_acquire);
+}
+
+size_t SCHC_GW_Device_Table::get_memory_usage()
+{
+    return memory_usage.load(std::memory_order_relaxed);
+}
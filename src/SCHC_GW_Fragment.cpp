@@ -0,0 +1,41 @@
+#include "SCHC_GW_Fragment.hpp"
+#include <cstring>
+
+SCHC_GW_Fragment::SCHC_GW_Fragment(SCHC_GW_Fragment&& other) noexcept
+{
+    *this = std::move(other);
+}
+
+SCHC_GW_Fragment& SCHC_GW_Fragment::operator=(SCHC_GW_Fragment&& other) noexcept
+{
+    if(this == &other)
+        return *this;
+
+    _heap = std::move(other._heap);
+    if(!_heap && other._len > 0)
+        memcpy(_inline, other._inline, other._len);
+    _len        = other._len;
+    _device     = other._device;
+    _rule_id    = other._rule_id;
+    _rx_time    = other._rx_time;
+    other._len  = 0;
+    return *this;
+}
+
+char* SCHC_GW_Fragment::allocate(int capacity)
+{
+    _len = 0;
+    if(capacity <= SCHC_GW_FRAGMENT_INLINE_SIZE)
+    {
+        _heap.reset();
+        return _inline;
+    }
+    _heap.reset(new char[capacity]);
+    return _heap.get();
+}
+
+void SCHC_GW_Fragment::reset()
+{
+    _heap.reset();
+    _len = 0;
+}
@@ -6,44 +6,62 @@ uint8_t SCHC_GW_Fragmenter::set_mqtt_stack(mosquitto *mosqStack)
         return 0;
 }
 
-uint8_t SCHC_GW_Fragmenter::initialize(uint8_t protocol, uint8_t ack_mode, uint8_t error_prob)
+uint8_t SCHC_GW_Fragmenter::set_stack(SCHC_GW_Stack_L2* stack)
+{
+        _stack = stack;
+        return 0;
+}
+
+uint8_t SCHC_GW_Fragmenter::initialize(uint8_t protocol, uint8_t ack_mode, const SCHC_GW_Loss_Pattern& loss_pattern, int n_workers, int max_sessions, size_t session_mem_budget, int grace_period_ms)
 {
         SPDLOG_TRACE("Entering the function");
         _protocol = protocol;
-        _error_prob = error_prob;
+        _loss_pattern = loss_pattern;
+        _grace_period_ms = grace_period_ms;
 
         if(protocol==SCHC_FRAG_LORAWAN)
         {
-                SPDLOG_DEBUG("Initializing mqtt stack to connect to ttn-mqtt broker");
+                if(_stack == nullptr)
+                {
+                        SPDLOG_DEBUG("Initializing mqtt stack to connect to ttn-mqtt broker");
+                        SCHC_GW_TTN_MQTT_Stack* stack_ttn_mqtt = new SCHC_GW_TTN_MQTT_Stack();
+                        stack_ttn_mqtt->set_mqtt_stack(_mosq);
+                        _stack = stack_ttn_mqtt;
+                }
+                _stack->initialize_stack();
 
-                _stack = nullptr;
-                _stack = new SCHC_GW_TTN_MQTT_Stack();
-                SCHC_GW_TTN_MQTT_Stack* stack_ttn_mqtt = dynamic_cast<SCHC_GW_TTN_MQTT_Stack*>(_stack); 
-                stack_ttn_mqtt->set_mqtt_stack(_mosq);
-                stack_ttn_mqtt->initialize_stack();
+                /* initializing the worker pool that runs the state machines */
+                SPDLOG_DEBUG("Initializing worker pool with {} workers", n_workers);
+                _workerPool.initialize(n_workers);
 
-                /* initializing the session pool */
+                /* initializing the timer wheel that releases the retired sessions. 100 ms x 600 slots = 1 minute per round */
+                SPDLOG_DEBUG("Initializing timer wheel with a grace period of {} ms", grace_period_ms);
+                _timerWheel.initialize(100, 600);
 
-                SPDLOG_DEBUG("Initializing SCHC session pool with {} sessions",_SESSION_POOL_SIZE);
+                /* initializing the session tables. The sessions are created on demand.
+                get_free_session_id() solo entrega sesiones de uplink: la tabla de uplink recibe
+                todo el memory budget y la de downlink queda sin sesiones */
 
-                for(uint8_t i=0; i<_SESSION_POOL_SIZE; i++)
-                {
-                _uplinkSessionPool[i].initialize(this,
+                SPDLOG_DEBUG("Initializing SCHC session tables with up to {} sessions", max_sessions);
+
+                _uplinkSessionTable.initialize(this,
                                                 SCHC_FRAG_LORAWAN,
                                                 SCHC_FRAG_UP,
-                                                i,
-                                                stack_ttn_mqtt,
+                                                _stack,
+                                                &_workerPool,
                                                 ack_mode,
-                                                error_prob);
-                _downlinkSessionPool[i].initialize(this,
+                                                &_loss_pattern,
+                                                max_sessions,
+                                                session_mem_budget);
+                _downlinkSessionTable.initialize(this,
                                                 SCHC_FRAG_LORAWAN,
                                                 SCHC_FRAG_DOWN,
-                                                i,
-                                                stack_ttn_mqtt,
+                                                _stack,
+                                                &_workerPool,
                                                 ack_mode,
-                                                error_prob);
-                
-                }
+                                                &_loss_pattern,
+                                                0,
+                                                0);
         }
 
         SPDLOG_TRACE("Leaving the function");
@@ -51,20 +69,53 @@ uint8_t SCHC_GW_Fragmenter::initialize(uint8_t protocol, uint8_t ack_mode, uint8
         return 0;
 }
 
+void SCHC_GW_Fragmenter::stop()
+{
+        /* El publisher de downlinks usa el cliente mosquitto: se detiene antes de destruirlo */
+        if(_stack != nullptr)
+                _stack->stop_stack();
+}
+
+bool SCHC_GW_Fragmenter::is_idle()
+{
+        return _workerPool.is_idle();
+}
+
 uint8_t SCHC_GW_Fragmenter::listen_messages(char *buffer)
 {
         SPDLOG_DEBUG(">>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>");
         SPDLOG_TRACE("\033[1mEntering the function\033[0m");
 
         SCHC_GW_TTN_Parser parser;
-        parser.initialize_parser(buffer);
-        SPDLOG_DEBUG("Receiving messages from: {}", parser.get_device_id());
+        if(parser.initialize_parser(buffer) != 0)
+        {
+                SPDLOG_ERROR("Invalid mqtt message. Discarting message");
+                return -1;
+        }
+        // El device id solo se reconstruye para los logs; las sesiones se buscan por el handle
+        uint32_t device             = parser.get_device();
+        SPDLOG_DEBUG("Receiving messages from: {}", SCHC_GW_Device_Table::get_device_id(device));
 
 
         // Valida si existe una sesión asociada al deviceId.
         // Si no existe, solicita una sesion nueva.
-        std::string device_id = parser.get_device_id();
-        int id = this->get_session_id(device_id);
+        int id = this->get_session_id(device);
+        bool retired_erased = false;    // "true": se elimino la asociacion de la sesion retirada
+        if(id != -1 && !_uplinkSessionTable.get_session(id).is_running())
+        {
+                /* La sesion del dispositivo termino y esta en su grace period. Los
+                fragmentos tardios se descartan, pero el primer fragmento de una nueva
+                sesion no tiene que esperar a que la sesion anterior sea liberada */
+                if(!this->is_first_fragment(parser.get_rule_id(), parser.get_decoded_payload(), parser.get_payload_len()))
+                {
+                        SPDLOG_DEBUG("Late message for the retired session {} of {}. Discarting message", id, SCHC_GW_Device_Table::get_device_id(device));
+                        return 0;       // el fragmento se libera con el parser
+                }
+                SPDLOG_DEBUG("{} starts a new session while the session {} is retired", SCHC_GW_Device_Table::get_device_id(device), id);
+                retired_erased = _associationMap.erase_if_equal(device, id);
+                id = -1;
+        }
+
         if(id == -1)
         {
                 /* No existen sesiones asociadas al device_id */
@@ -73,20 +124,24 @@ uint8_t SCHC_GW_Fragmenter::listen_messages(char *buffer)
                 id = this->get_free_session_id(SCHC_FRAG_UP);
                 if(id == -1)
                 {
+                        /* release_session_id() ya no encontrara la asociacion de la sesion retirada,
+                        por lo que el topic del dispositivo se quita aqui */
+                        if(retired_erased)
+                                _stack->close_device(device);
                         return -1;
                 }
                 else
                 {       
-                        SPDLOG_DEBUG("Associating deviceid: {} with session id: {}", device_id, id);
-                        this->associate_session_id(device_id, id);
-                        this->_uplinkSessionPool[id].set_running(true);
+                        SPDLOG_DEBUG("Associating deviceid: {} with session id: {}", SCHC_GW_Device_Table::get_device_id(device), id);
+                        this->associate_session_id(device, id);
                 }
         }
 
-        if(_uplinkSessionPool[id].is_running())
+        SCHC_GW_Session& session = _uplinkSessionTable.get_session(id);
+        if(session.is_running())
         {
-                SPDLOG_DEBUG("Sending messages from {} to the session with id: {}", device_id, id);
-                this->_uplinkSessionPool[id].process_message(device_id, parser.get_rule_id(), parser.get_decoded_payload(), parser.get_payload_len()); 
+                SPDLOG_DEBUG("Sending messages from {} to the session with id: {}", SCHC_GW_Device_Table::get_device_id(device), id);
+                session.process_message(parser.take_fragment()); 
         }
         else
         {
@@ -102,62 +157,74 @@ int SCHC_GW_Fragmenter::get_free_session_id(uint8_t direction)
 {
         if(_protocol==SCHC_FRAG_LORAWAN && direction==SCHC_FRAG_UP)
         {
-                for(uint8_t i=0; i<_SESSION_POOL_SIZE;i++)
-                {
-                        if(!_uplinkSessionPool[i].is_running())
-                        {
-                                _uplinkSessionPool[i].set_running(true);
-                                SPDLOG_TRACE("Selecting the session {}", i);
-                                return i;
-                        }
-                }
-                SPDLOG_ERROR("All sessiones are used");
+                return _uplinkSessionTable.allocate();
         }
         return -1;
 }
 
-uint8_t SCHC_GW_Fragmenter::associate_session_id(std::string deviceId, int sessionId)
+uint8_t SCHC_GW_Fragmenter::associate_session_id(uint32_t device, int sessionId)
 {
-        auto result = _associationMap.insert({deviceId, sessionId});
-        if (result.second)
+        if (_associationMap.insert(device, sessionId))
         {
                 SPDLOG_DEBUG("Key and value successfully inserted in the map.");
                 return 0;
         } else
         {
-                SPDLOG_ERROR("The key already exists in the map. Key: {}", deviceId);
+                SPDLOG_ERROR("The key already exists in the map. Key: {}", SCHC_GW_Device_Table::get_device_id(device));
                 return -1;
         }
 }
 
-uint8_t SCHC_GW_Fragmenter::disassociate_session_id(std::string deviceId)
+uint8_t SCHC_GW_Fragmenter::disassociate_session_id(uint32_t device, int sessionId)
 {
-        std::this_thread::sleep_for(std::chrono::seconds(10));
-        size_t res = _associationMap.erase(deviceId);
-        if(res == 0)
+        /* La sesion queda retirada durante el grace period y luego el timer wheel
+        la libera. No se bloquea el worker que ejecuta el end callback */
+        _timerWheel.schedule(_grace_period_ms, [this, device, sessionId]()
         {
-                SPDLOG_ERROR("Key not found. Could not disassociate. Key: {}", deviceId);
-                return -1;
-        }
-        else if(res == 1)
+                this->release_session_id(device, sessionId);
+        });
+        SPDLOG_DEBUG("Session {} retired for {} ms. Key: {}", sessionId, _grace_period_ms, SCHC_GW_Device_Table::get_device_id(device));
+        return 0;
+}
+
+void SCHC_GW_Fragmenter::release_session_id(uint32_t device, int sessionId)
+{
+        /* Si el dispositivo ya inicio una nueva sesion, la asociacion apunta a otra sesion y no
+        se elimina. Tampoco se quita su topic de downlink, que la nueva sesion sigue usando */
+        if(_associationMap.erase_if_equal(device, sessionId))
         {
-                SPDLOG_DEBUG("Key successfully disassociated. Key: {}", deviceId);
-                return 0;
+                SPDLOG_DEBUG("Key successfully disassociated. Key: {}", SCHC_GW_Device_Table::get_device_id(device));
+                _stack->close_device(device);
         }
-        return -1;
+
+        /* la sesion vuelve a la free list de la tabla */
+        _uplinkSessionTable.release(sessionId);
+}
+
+bool SCHC_GW_Fragmenter::is_first_fragment(int rule_id, char* msg, int len)
+{
+        /* El primer fragmento de una sesion es un regular fragment con W=0 y FCN=WINDOW_SIZE-1 */
+        SCHC_GW_Message decoder;
+        if(decoder.get_msg_type(_protocol, rule_id, msg, len) != SCHC_REGULAR_FRAGMENT_MSG)
+                return false;
+
+        uint8_t schc_header = msg[0];
+        uint8_t w           = (schc_header >> 6) & 0x03;
+        uint8_t fcn         = schc_header & 0x3F;
+        return (w == 0 && fcn == 62);
 }
 
-int SCHC_GW_Fragmenter::get_session_id(std::string deviceId)
+int SCHC_GW_Fragmenter::get_session_id(uint32_t device)
 {
-        auto it = _associationMap.find(deviceId);
-        if (it != _associationMap.end())
+        int id = _associationMap.find(device);
+        if (id != -1)
         {
-                SPDLOG_DEBUG("Recovering the session id: {} with Key: {}", it->second, deviceId);
-                return it->second;
+                SPDLOG_DEBUG("Recovering the session id: {} with Key: {}", id, SCHC_GW_Device_Table::get_device_id(device));
+                return id;
         }
         else
         {
-                SPDLOG_DEBUG("Session does not exist for the Key: {}", deviceId);
+                SPDLOG_DEBUG("Session does not exist for the Key: {}", SCHC_GW_Device_Table::get_device_id(device));
                 return -1;
         }
 }
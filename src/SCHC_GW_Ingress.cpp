@@ -0,0 +1,226 @@
+#include "SCHC_GW_Ingress.hpp"
+#include "SCHC_GW_Metrics.hpp"
+#include <chrono>
+#include <cstring>
+#include <fmt/format.h>
+
+SCHC_GW_Ingress::~SCHC_GW_Ingress()
+{
+    stop();
+}
+
+uint8_t SCHC_GW_Ingress::initialize(SCHC_GW_Fragmenter* frag, int n_decoders, int ring_size, int slot_size, bool block_when_full)
+{
+    SPDLOG_TRACE("Entering the function");
+
+    _frag               = frag;
+    _slot_size          = slot_size;
+    _block_when_full    = block_when_full;
+
+    if(n_decoders < 1)
+        n_decoders = 1;
+
+    _running.store(true);
+    size_t n_slots = 0;
+    for(int i=0; i<n_decoders; i++)
+    {
+        auto ring       = std::make_unique<Ring>();
+        ring->slots.initialize(ring_size);      // el tamaño del ring se redondea a una potencia de 2
+        n_slots         = ring->slots.get_capacity();
+        ring->storage   = std::make_unique<char[]>(n_slots * slot_size);
+        for(size_t j=0; j<n_slots; j++)
+        {
+            ring->slots.get_entry(j).len    = 0;
+            ring->slots.get_entry(j).data   = ring->storage.get() + j*slot_size;
+        }
+        _rings.push_back(std::move(ring));
+    }
+    for(int i=0; i<n_decoders; i++)
+    {
+        _threads.emplace_back(&SCHC_GW_Ingress::decoder_loop, this, i);
+    }
+
+    SCHC_GW_Metrics::add_callback(this, SCHC_GW_METRIC_GAUGE, "schc_gw_ingress_depth", "", "MQTT messages waiting in the decoder rings", [this]() { return double(get_depth()); });
+    SCHC_GW_Metrics::add_callback(this, SCHC_GW_METRIC_COUNTER, "schc_gw_ingress_messages_total", "result=\"received\"", "MQTT uplink messages by stage of the ingress", [this]() { return double(get_received()); });
+    SCHC_GW_Metrics::add_callback(this, SCHC_GW_METRIC_COUNTER, "schc_gw_ingress_messages_total", "result=\"decoded\"", "", [this]() { return double(get_decoded()); });
+    SCHC_GW_Metrics::add_callback(this, SCHC_GW_METRIC_COUNTER, "schc_gw_ingress_messages_total", "result=\"dropped_full\"", "", [this]() { return double(get_dropped_full()); });
+    SCHC_GW_Metrics::add_callback(this, SCHC_GW_METRIC_COUNTER, "schc_gw_ingress_oversize_total", "", "MQTT uplink messages larger than an ingress slot, copied to the heap", [this]() { return double(get_oversize()); });
+    SCHC_GW_Metrics::add_callback(this, SCHC_GW_METRIC_COUNTER, "schc_gw_ingress_backpressure_waits_total", "", "Times the mqtt thread waited for a free ingress slot", [this]() { return double(get_backpressure_waits()); });
+    SPDLOG_DEBUG("Ingress successfully created with {} decoders, {} slots of {} bytes per decoder", n_decoders, n_slots, slot_size);
+
+    SPDLOG_TRACE("Leaving the function");
+    return 0;
+}
+
+void SCHC_GW_Ingress::stop()
+{
+    if(!_running.exchange(false))
+        return;
+
+    SCHC_GW_Metrics::remove_callbacks(this);
+    for(auto& ring : _rings)
+    {
+        ring->slots.notify_all();
+    }
+    for(auto& thread : _threads)
+    {
+        if(thread.joinable())
+            thread.join();
+    }
+    _threads.clear();
+    SPDLOG_WARN("Ingress stopped: {}", to_string());
+}
+
+uint8_t SCHC_GW_Ingress::push(const char* topic, const char* payload, int len)
+{
+    /* Se ejecuta en el hilo de mosquitto: solo copia el mensaje y retorna */
+    std::unique_ptr<char[]> heap;
+    if(len + 1 > _slot_size)     // el payload se guarda terminado en '\0'
+    {
+        /* No cabe en un slot: se copia al heap y el decoder lo libera despues de procesarlo */
+        heap.reset(new char[len + 1]);
+        memcpy(heap.get(), payload, len);
+        heap[len] = '\0';
+        uint64_t oversize = _oversize.fetch_add(1, std::memory_order_relaxed) + 1;
+        if((oversize & (oversize - 1)) == 0)    // se informa en el 1ro, 2do, 4to, 8vo, ... mensaje
+            SPDLOG_WARN("MQTT message of {} bytes does not fit in an ingress slot of {} bytes. {} messages copied to the heap so far", len, _slot_size, oversize);
+    }
+
+    int   decoder_id = get_decoder_id(topic);
+    Ring& ring       = *_rings[decoder_id];
+    if(try_push(ring, payload, len, heap))
+    {
+        _received.fetch_add(1, std::memory_order_relaxed);
+        return 0;
+    }
+
+    if(!_block_when_full)
+    {
+        uint64_t dropped = _dropped_full.fetch_add(1, std::memory_order_relaxed) + 1;
+        if((dropped & (dropped - 1)) == 0)      // se informa en la 1ra, 2da, 4ta, 8va, ... perdida
+            SPDLOG_WARN("Ingress ring of decoder {} is full. {} messages dropped so far", decoder_id, dropped);
+        return 1;
+    }
+
+    /* Backpressure: el hilo de mosquitto deja de leer el socket hasta que el decoder libere un slot */
+    _backpressure_waits.fetch_add(1, std::memory_order_relaxed);
+    while(_running.load(std::memory_order_relaxed))
+    {
+        std::this_thread::sleep_for(std::chrono::microseconds(50));
+        if(try_push(ring, payload, len, heap))
+        {
+            _received.fetch_add(1, std::memory_order_relaxed);
+            return 0;
+        }
+    }
+    return 1;
+}
+
+bool SCHC_GW_Ingress::try_push(Ring& ring, const char* payload, int len, std::unique_ptr<char[]>& heap)
+{
+    return ring.slots.try_push([&](Slot& slot)
+    {
+        if(heap)
+        {
+            slot.heap = std::move(heap);
+        }
+        else
+        {
+            memcpy(slot.data, payload, len);
+            slot.data[len] = '\0';
+        }
+        slot.len = len;
+    });
+}
+
+int SCHC_GW_Ingress::get_decoder_id(const char* topic)
+{
+    /* topic: v3/{application id}@{tenant id}/devices/{device id}/up */
+    static const char   devices[]   = "/devices/";
+    const char*         dev_id      = (topic != nullptr) ? strstr(topic, devices) : nullptr;
+    if(dev_id == nullptr)
+        return 0;
+    dev_id = dev_id + sizeof(devices) - 1;
+    const char* end = strchr(dev_id, '/');
+    size_t len      = (end != nullptr) ? size_t(end - dev_id) : strlen(dev_id);
+    return SCHC_GW_Device_Table::hash_device_id(dev_id, len) % _rings.size();
+}
+
+void SCHC_GW_Ingress::decoder_loop(int decoder_id)
+{
+    SPDLOG_INFO("Entering decoder_loop() of decoder {}", decoder_id);
+
+    Ring& ring = *_rings[decoder_id];
+
+    while(_running.load(std::memory_order_relaxed))
+    {
+        Slot* slot = ring.slots.front();
+        if(slot != nullptr)
+        {
+            /* El mensaje se procesa dentro del slot, sin copiarlo otra vez */
+            _frag->listen_messages(slot->heap ? slot->heap.get() : slot->data);
+            slot->heap.reset();
+            _decoded.fetch_add(1, std::memory_order_relaxed);
+            ring.slots.pop();
+            continue;
+        }
+
+        /* Ring vacio. El decoder duerme hasta que un productor lo despierte */
+        ring.slots.wait(100, _running);
+    }
+
+    SPDLOG_WARN("\033[1mDecoder {} finished\033[0m", decoder_id);
+    return;
+}
+
+int SCHC_GW_Ingress::get_n_decoders()
+{
+    return _rings.size();
+}
+
+uint64_t SCHC_GW_Ingress::get_received()
+{
+    return _received.load(std::memory_order_relaxed);
+}
+
+uint64_t SCHC_GW_Ingress::get_decoded()
+{
+    return _decoded.load(std::memory_order_relaxed);
+}
+
+uint64_t SCHC_GW_Ingress::get_dropped_full()
+{
+    return _dropped_full.load(std::memory_order_relaxed);
+}
+
+uint64_t SCHC_GW_Ingress::get_oversize()
+{
+    return _oversize.load(std::memory_order_relaxed);
+}
+
+uint64_t SCHC_GW_Ingress::get_backpressure_waits()
+{
+    return _backpressure_waits.load(std::memory_order_relaxed);
+}
+
+size_t SCHC_GW_Ingress::get_depth()
+{
+    /* Mensajes encolados que los decoders aun no procesan */
+    size_t depth = 0;
+    for(auto& ring : _rings)
+    {
+        depth = depth + ring->slots.get_size();
+    }
+    return depth;
+}
+
+std::string SCHC_GW_Ingress::to_string()
+{
+    return fmt::format("received={} decoded={} depth={} dropped_full={} oversize={} backpressure_waits={}",
+                       get_received(),
+                       get_decoded(),
+                       get_depth(),
+                       get_dropped_full(),
+                       get_oversize(),
+                       get_backpressure_waits());
+}
\ No newline at end of file
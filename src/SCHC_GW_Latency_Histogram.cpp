@@ -0,0 +1,116 @@
+#include "SCHC_GW_Latency_Histogram.hpp"
+#include <fmt/format.h>
+
+SCHC_GW_Latency_Histogram::SCHC_GW_Latency_Histogram()
+{
+    reset();
+}
+
+void SCHC_GW_Latency_Histogram::record(uint64_t ns)
+{
+    /* bucket = numero de bits significativos de ns (0 ns -> bucket 0) */
+    int bucket = 0;
+    uint64_t v = ns;
+    while(v != 0 && bucket < SCHC_GW_HISTOGRAM_BUCKETS - 1)
+    {
+        v >>= 1;
+        bucket++;
+    }
+
+    _buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+    _count.fetch_add(1, std::memory_order_relaxed);
+    _sum_ns.fetch_add(ns, std::memory_order_relaxed);
+
+    uint64_t prev = _max_ns.load(std::memory_order_relaxed);
+    while(ns > prev && !_max_ns.compare_exchange_weak(prev, ns, std::memory_order_relaxed))
+    {
+    }
+}
+
+uint64_t SCHC_GW_Latency_Histogram::get_count()
+{
+    return _count.load(std::memory_order_relaxed);
+}
+
+uint64_t SCHC_GW_Latency_Histogram::get_mean_ns()
+{
+    uint64_t count = get_count();
+    if(count == 0)
+        return 0;
+    return _sum_ns.load(std::memory_order_relaxed) / count;
+}
+
+uint64_t SCHC_GW_Latency_Histogram::get_sum_ns()
+{
+    return _sum_ns.load(std::memory_order_relaxed);
+}
+
+uint64_t SCHC_GW_Latency_Histogram::get_max_ns()
+{
+    return _max_ns.load(std::memory_order_relaxed);
+}
+
+uint64_t SCHC_GW_Latency_Histogram::get_percentile_ns(double p)
+{
+    /* Retorna el limite superior del bucket donde cae el percentil p (0.0 - 1.0) */
+    uint64_t count = get_count();
+    if(count == 0)
+        return 0;
+
+    uint64_t target  = static_cast<uint64_t>(p * count);
+    uint64_t acum    = 0;
+    for(int i=0; i<SCHC_GW_HISTOGRAM_BUCKETS; i++)
+    {
+        acum += _buckets[i].load(std::memory_order_relaxed);
+        if(acum > target)
+            return get_bucket_upper_ns(i);
+    }
+    return get_max_ns();
+}
+
+uint64_t SCHC_GW_Latency_Histogram::get_bucket_count(int bucket)
+{
+    return _buckets[bucket].load(std::memory_order_relaxed);
+}
+
+uint64_t SCHC_GW_Latency_Histogram::get_bucket_upper_ns(int bucket)
+{
+    return (uint64_t(1) << bucket);
+}
+
+std::string SCHC_GW_Latency_Histogram::to_string()
+{
+    return fmt::format("n={} mean={}us p50<={}us p99<={}us max={}us",
+                       get_count(),
+                       get_mean_ns()/1000.0,
+                       get_percentile_ns(0.50)/1000.0,
+                       get_percentile_ns(0.99)/1000.0,
+                       get_max_ns()/1000.0);
+}
+
+void SCHC_GW_Latency_Histogram::merge(SCHC_GW_Latency_Histogram& other)
+{
+    for(int i=0; i<SCHC_GW_HISTOGRAM_BUCKETS; i++)
+    {
+        _buckets[i].fetch_add(other.get_bucket_count(i), std::memory_order_relaxed);
+    }
+    _count.fetch_add(other.get_count(), std::memory_order_relaxed);
+    _sum_ns.fetch_add(other.get_sum_ns(), std::memory_order_relaxed);
+
+    uint64_t max_ns = other.get_max_ns();
+    uint64_t prev   = _max_ns.load(std::memory_order_relaxed);
+    while(max_ns > prev && !_max_ns.compare_exchange_weak(prev, max_ns, std::memory_order_relaxed))
+    {
+    }
+}
+
+void SCHC_GW_Latency_Histogram::reset()
+{
+    for(int i=0; i<SCHC_GW_HISTOGRAM_BUCKETS; i++)
+    {
+        _buckets[i].store(0, std::memory_order_relaxed);
+    }
+    _count.store(0, std::memory_order_relaxed);
+    _sum_ns.store(0, std::memory_order_relaxed);
+    _max_ns.store(0, std::memory_order_relaxed);
+}
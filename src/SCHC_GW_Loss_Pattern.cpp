@@ -0,0 +1,143 @@
+#include "SCHC_GW_Loss_Pattern.hpp"
+#include <cstdlib>
+#include <fmt/format.h>
+#include <fmt/ranges.h>
+
+static uint32_t percent_to_threshold(double percent)
+{
+    if(percent <= 0)
+        return 0;
+    if(percent >= 100)
+        return UINT32_MAX;
+    return static_cast<uint32_t>(percent / 100.0 * 4294967296.0);
+}
+
+uint8_t SCHC_GW_Loss_Pattern::parse(const std::string& spec, SCHC_GW_Loss_Pattern& pattern)
+{
+    pattern = SCHC_GW_Loss_Pattern();
+    if(spec.empty() || spec == "none")
+        return 0;
+
+    size_t colon = spec.find(':');
+    if(colon == std::string::npos)
+        return 1;
+    std::string type    = spec.substr(0, colon);
+    const char* p       = spec.c_str() + colon + 1;
+
+    /* Lista de numeros separados por coma */
+    double  values[SCHC_GW_LOSS_MAX_LIST];
+    int     n_values = 0;
+    while(*p != '\0')
+    {
+        if(n_values == SCHC_GW_LOSS_MAX_LIST)
+            return 1;
+        char* end;
+        values[n_values] = strtod(p, &end);
+        if(end == p || values[n_values] < 0)
+            return 1;
+        n_values++;
+        p = end;
+        if(*p == ',')
+            p++;
+        else if(*p != '\0')
+            return 1;
+    }
+
+    if(type == "list" && n_values > 0)
+    {
+        pattern._type = SCHC_GW_LOSS_LIST;
+        for(int i=0; i<n_values; i++)
+            pattern._list[i] = static_cast<uint32_t>(values[i]);
+        pattern._list_len = n_values;
+    }
+    else if(type == "random" && n_values == 1)
+    {
+        pattern._type       = SCHC_GW_LOSS_RANDOM;
+        pattern._p_percent  = values[0];
+        pattern._p          = percent_to_threshold(values[0]);
+    }
+    else if(type == "burst" && n_values == 2 && values[0] >= 1)
+    {
+        pattern._type       = SCHC_GW_LOSS_BURST;
+        pattern._p          = static_cast<uint32_t>(values[0]);
+        pattern._r          = static_cast<uint32_t>(values[1]);
+    }
+    else if(type == "gilbert" && n_values == 2)
+    {
+        pattern._type       = SCHC_GW_LOSS_GILBERT;
+        pattern._p_percent  = values[0];
+        pattern._r_percent  = values[1];
+        pattern._p          = percent_to_threshold(values[0]);
+        pattern._r          = percent_to_threshold(values[1]);
+    }
+    else
+    {
+        return 1;
+    }
+    return 0;
+}
+
+void SCHC_GW_Loss_Pattern::reset(uint64_t seed)
+{
+    _counter    = 0;
+    _rng        = seed;
+    _bad        = false;
+}
+
+bool SCHC_GW_Loss_Pattern::drop()
+{
+    _counter++;
+    switch(_type)
+    {
+        case SCHC_GW_LOSS_LIST:
+            for(int i=0; i<_list_len; i++)
+            {
+                if(_list[i] == _counter)
+                    return true;
+            }
+            return false;
+        case SCHC_GW_LOSS_RANDOM:
+            return next_random() < _p;
+        case SCHC_GW_LOSS_BURST:
+            return (_counter - 1) % _p < _r;
+        case SCHC_GW_LOSS_GILBERT:
+            if(_bad)
+                _bad = next_random() >= _r;
+            else
+                _bad = next_random() < _p;
+            return _bad;
+        default:
+            return false;
+    }
+}
+
+bool SCHC_GW_Loss_Pattern::is_enabled() const
+{
+    return _type != SCHC_GW_LOSS_NONE;
+}
+
+std::string SCHC_GW_Loss_Pattern::to_string() const
+{
+    switch(_type)
+    {
+        case SCHC_GW_LOSS_LIST:
+            return fmt::format("list:{}", fmt::join(_list, _list + _list_len, ","));
+        case SCHC_GW_LOSS_RANDOM:
+            return fmt::format("random:{}", _p_percent);
+        case SCHC_GW_LOSS_BURST:
+            return fmt::format("burst:{},{}", _p, _r);
+        case SCHC_GW_LOSS_GILBERT:
+            return fmt::format("gilbert:{},{}", _p_percent, _r_percent);
+        default:
+            return "none";
+    }
+}
+
+uint32_t SCHC_GW_Loss_Pattern::next_random()
+{
+    /* splitmix64 */
+    uint64_t z = (_rng += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return static_cast<uint32_t>((z ^ (z >> 31)) >> 32);
+}
\ No newline at end of file
@@ -1,232 +1,145 @@
 #include "SCHC_GW_Message.hpp"
+#include "SCHC_GW_Metrics.hpp"
 
 SCHC_GW_Message::SCHC_GW_Message()
 {
 }
 
-uint8_t SCHC_GW_Message::create_schc_ack(uint8_t rule_id, uint8_t dtag, uint8_t w, uint8_t c, std::vector<uint8_t> bitmap_vector, char*& buffer, int& len, bool must_compress)
+/* Escribe campos de bits MSB-first en el buffer de salida. Los bits se acumulan en
+   una palabra de 64 bits y se vuelcan de a un byte, sin vectores intermedios */
+struct SCHC_GW_Bit_Writer
 {
+    char*       out;
+    int         bytes   = 0;
+    uint64_t    acc     = 0;
+    int         n_acc   = 0;    // bits pendientes en acc (alineados a la derecha, siempre < 8)
+
+    explicit SCHC_GW_Bit_Writer(char* buffer) : out(buffer) {}
+
+    void put(uint64_t value, int n)
+    {
+        if(n > 32)
+        {
+            put(value >> 32, n - 32);
+            n = 32;
+        }
+        if(n == 0)
+            return;
+        acc     = (acc << n) | (value & ((uint64_t(1) << n) - 1));
+        n_acc   = n_acc + n;
+        while(n_acc >= 8)
+        {
+            n_acc = n_acc - 8;
+            out[bytes++] = static_cast<char>(acc >> n_acc);
+        }
+    }
+};
+
+uint8_t SCHC_GW_Message::create_schc_ack(uint8_t rule_id, uint8_t dtag, uint8_t w, uint8_t c, uint64_t bitmap, uint8_t win_size, char* buffer, int& len, bool must_compress)
+{
+    /* bitmap: un bit por tile de la ventana, el tile 0 en el bit mas significativo.
+       buffer: debe tener al menos SCHC_ACK_MAX_LEN bytes */
     uint8_t w_mask      = 0xC0;
     uint8_t c_mask      = 0x20;
 
     if(c == 1)
     {
         // No hay errores, se agregan 5 bits de padding
-        char* schc_header   = new char[1];  // * Liberada en SCHC_GW_Ack_on_error::RX_RCV_WIN_recv_fragments (linea 220 y 255) y 
-        schc_header[0]  = ((w << 6)& w_mask) | ((c << 5) & c_mask) | 0x00;
-        buffer = schc_header;
-        len = 1;
+        buffer[0]   = ((w << 6)& w_mask) | ((c << 5) & c_mask) | 0x00;
+        len         = 1;
+        SCHC_GW_Metrics::add(SCHC_GW_METRIC_ACKS_SENT);
+        return 0;
+    }
+
+    // hay errores, se deben calcular los bits de padding según:
+    // https://www.rfc-editor.org/rfc/rfc8724.html#name-schc-ack-format
+    SCHC_GW_Bit_Writer writer(buffer);
+    writer.put(w, 2);
+    writer.put(c, 1);
+
+    if(must_compress)
+    {
+        /* Se obtiene la ubicación del ultimo cero del bitmap: el cero menos significativo de la palabra */
+        uint64_t full_mask  = ~uint64_t(0) << (64 - win_size);
+        uint64_t zeros      = ~bitmap & full_mask;
+        int last_zero       = 0;
+        if(zeros != 0)
+            last_zero = 63 - __builtin_ctzll(zeros);
+
+        int n_bitmap_bits   = last_zero + 1;
+        int n_paddin_bits   = 8 - ((n_bitmap_bits + 3) % 8);
+        writer.put(bitmap >> (64 - n_bitmap_bits), n_bitmap_bits);
+        writer.put((uint64_t(1) << n_paddin_bits) - 1, n_paddin_bits);   // padding con 1s
     }
     else
     {
-        // hay errores, se deben calcular los bits de padding según:
-        // https://www.rfc-editor.org/rfc/rfc8724.html#name-schc-ack-format
+        int n_paddin_bits   = 8 - ((win_size + 3) % 8);
+        writer.put(bitmap >> (64 - win_size), win_size);
+        writer.put(0, n_paddin_bits);                                   // padding con 0s
+    }
 
-        if(must_compress)
-        {
-            int last_zero = 0;
-            //std::reverse(bitmap_vector.begin(), bitmap_vector.end());
-            std::vector<uint8_t> compress_bitmap_vector;
-
-            /* Se obtiene la ubicación del ultimo cero revisando de izquierda a derecha en el bitmap*/
-            for(size_t i=0; i<bitmap_vector.size(); i++)
-            {
-                if(bitmap_vector[i] == 0)
-                    last_zero = i;
-            }
-
-            for(size_t i=0; i<=last_zero; i++)
-            {
-                compress_bitmap_vector.push_back(bitmap_vector[i]);
-            }
-
-            int n_paddin_bits = 8 - ((compress_bitmap_vector.size() + 3) % 8);
-            for(int i=0; i< n_paddin_bits; i++)
-            {
-                compress_bitmap_vector.push_back(1);
-            }
-
-            // construye los bits del SCHC packet (header + bitmap) como un vector
-            std::vector<uint8_t> bits;
-
-            // bits para w y c. Está compuesto por 2 bits. Cada bit lo almacena en un uint8_t
-            bits.push_back((w >> 1) & 0b00000001);
-            bits.push_back(w & 0b00000001);
-            bits.push_back(c & 0b00000001);
-
-            for(int i=0; i<compress_bitmap_vector.size(); i++)
-            {
-                bits.push_back(compress_bitmap_vector[i]);
-            }
-
-            /* Convirte el mensaje SCHC desde un vector a un array de char*/
-            if(bits.size()%8 == 0)
-            {
-                
-                len = bits.size()/8;
-                char* schc_header   = new char[len];
-                int k=0;
-                for(int i=0; i < len; i++)
-                {
-                    schc_header[i] = ((bits[k] << 7) & 0b10000000) |
-                                ((bits[k+1] << 6) & 0b01000000) |
-                                ((bits[k+2] << 5) & 0b00100000) |
-                                ((bits[k+3] << 4) & 0b00010000) |
-                                ((bits[k+4] << 3) & 0b00001000) |
-                                ((bits[k+5] << 2) & 0b00000100) |
-                                ((bits[k+6] << 1) & 0b00000010) |
-                                (bits[k+7] & 0b00000001);
-                    k = k + 8;
-                }
-                buffer = schc_header;
-            }
-            else
-            {
-                SPDLOG_ERROR("The compressed bitmap is not a multiple of an L2 word");
-                return 1;
-            }
-        }
-        else
-        {
-            int n_paddin_bits = 8 - ((bitmap_vector.size() + 3) % 8);
-            for(int i=0; i< n_paddin_bits; i++)
-            {
-                bitmap_vector.push_back(0);
-            }
-
-            // construye los bits del SCHC packet (header + bitmap) como un vector
-            std::vector<uint8_t> bits;
-
-            // bits para w y c. Está compuesto por 2 bits. Cada bit lo almacena en un uint8_t
-            bits.push_back((w >> 1) & 0b00000001);
-            bits.push_back(w & 0b00000001);
-            bits.push_back(c & 0b00000001);
-
-            for(int i=0; i<bitmap_vector.size(); i++)
-            {
-                bits.push_back(bitmap_vector[i]);
-            }
-
-            /* Convirte el mensaje SCHC desde un vector a un array de char*/
-            if(bits.size()%8 == 0)
-            {
-                
-                len = bits.size()/8;
-                char* schc_header   = new char[len];
-                int k=0;
-                for(int i=0; i < len; i++)
-                {
-                    schc_header[i] = ((bits[k] << 7) & 0b10000000) |
-                                ((bits[k+1] << 6) & 0b01000000) |
-                                ((bits[k+2] << 5) & 0b00100000) |
-                                ((bits[k+3] << 4) & 0b00010000) |
-                                ((bits[k+4] << 3) & 0b00001000) |
-                                ((bits[k+5] << 2) & 0b00000100) |
-                                ((bits[k+6] << 1) & 0b00000010) |
-                                (bits[k+7] & 0b00000001);
-                    k = k + 8;
-                }
-                buffer = schc_header;
-            }
-            else
-            {
-                SPDLOG_ERROR("The compressed bitmap is not a multiple of an L2 word");
-                return 1;
-            }
-        }
+    if(writer.n_acc != 0)
+    {
+        SPDLOG_ERROR("The compressed bitmap is not a multiple of an L2 word");
+        return 1;
     }
+    len = writer.bytes;
+    SCHC_GW_Metrics::add(SCHC_GW_METRIC_ACKS_SENT);
     return 0;
 }
 
-uint8_t SCHC_GW_Message::create_schc_ack_compound(uint8_t rule_id, uint8_t dtag, int last_win, std::vector<uint8_t> c_vector, uint8_t** bitmap_array, uint8_t win_size, char *&buffer, int &len)
+uint8_t SCHC_GW_Message::create_schc_ack_compound(uint8_t rule_id, uint8_t dtag, int last_win, uint8_t win_mask, const uint64_t* bitmaps, uint8_t win_size, char* buffer, int& len)
 {
-    
-    if(c_vector.empty())
+    /* win_mask: bit w en 1 si la ventana w va en el ACK. Las ventanas se incluyen en orden ascendente.
+       bitmaps: una palabra por ventana, el tile 0 en el bit mas significativo.
+       buffer: debe tener al menos SCHC_ACK_MAX_LEN bytes */
+    _compound_win_mask  = win_mask;
+    _compound_bitmaps   = bitmaps;
+    _compound_win_size  = win_size;
+
+    if(win_mask == 0)
     {
         // No hay errores, se agregan 5 bits de padding
-
         uint8_t w_mask  = 0xC0;
         uint8_t c_mask  = 0x20;
         uint8_t c       = 1;
 
-        char* schc_header   = new char[1];  // * Liberada en SCHC_GW_Ack_on_error::RX_RCV_WIN_recv_fragments (linea 220 y 255) y 
-        schc_header[0]  = ((last_win << 6)& w_mask) | ((c << 5) & c_mask) | 0x00;
-        buffer = schc_header;
-        len = 1;
+        buffer[0]   = ((last_win << 6)& w_mask) | ((c << 5) & c_mask) | 0x00;
+        len         = 1;
+        SCHC_GW_Metrics::add(SCHC_GW_METRIC_ACKS_SENT);
+        return 0;
     }
-    else
+
+    int n_bits = 1 + __builtin_popcount(win_mask) * (2 + win_size);    // c + (w + bitmap) por ventana
+    if(n_bits + 8 > SCHC_ACK_MAX_LEN*8)
     {
-        /* Construye los bits del SCHC packet (header + bitmap) como un vector */
-        std::vector<uint8_t>    bits;
-        std::string             bitmap_str = "";
-        bool                    first_win_with_error = true;
+        SPDLOG_ERROR("The compound ACK does not fit in {} bytes", SCHC_ACK_MAX_LEN);
+        return 1;
+    }
 
-        for(int i=0; i < c_vector.size(); i++)
-        {
-            uint8_t w = c_vector[i];
-            
-            if(first_win_with_error)    // solo para la primera ventana lleva w, c y el bitmap
-            {
-                // bits para w y c. Está compuesto por 2 bits. Cada bit lo almacena en un uint8_t
-                bits.push_back((w >> 1) & 0b00000001);
-                bits.push_back(w & 0b00000001);
-                bits.push_back(0);      // c = 0
-
-                bitmap_str = bitmap_str + "W=" + std::to_string(w) + " - Bitmap:";
-                for(int i=0; i<win_size; i++)
-                {
-                    bits.push_back(bitmap_array[w][i]);                             // vector que se transformara en un array de char
-                    bitmap_str = bitmap_str + std::to_string(bitmap_array[w][i]);   // string para mostrar en pantalla
-                }
-                first_win_with_error = false;
-            }
-            else                        // para el resto de las ventanas solo lleva w y el bitmap
-            {
-                bits.push_back((w >> 1) & 0b00000001);
-                bits.push_back(w & 0b00000001);
-
-                bitmap_str = bitmap_str + ", W=" + std::to_string(w) + " - Bitmap:";
-                for(int i=0; i<win_size; i++)
-                {
-                    bits.push_back(bitmap_array[w][i]);                             // vector que se transformara en un array de char
-                    bitmap_str = bitmap_str + std::to_string(bitmap_array[w][i]);   // string para mostrar en pantalla
-                }
-
-            }            
-        }
+    SCHC_GW_Bit_Writer  writer(buffer);
+    bool                first_win_with_error = true;
+    uint8_t             pending = win_mask;
+    while(pending != 0)
+    {
+        uint8_t w   = __builtin_ctz(pending);
+        pending     = pending & (pending - 1);
 
-        /* Se agregan los bits de padding */
-        int n_paddin_bits = 8 - (bits.size()% 8);
-        for(int i=0; i< n_paddin_bits; i++)
+        writer.put(w, 2);
+        if(first_win_with_error)    // solo para la primera ventana lleva w, c y el bitmap
         {
-            bits.push_back(0);
-        }
-
-
-        /* Convirte el mensaje SCHC desde un vector a un array de char*/
-        if(bits.size()%8 == 0)
-        {    
-            len = bits.size()/8;
-            char* schc_header   = new char[len];
-            int k=0;
-            for(int i=0; i < len; i++)
-            {
-                schc_header[i] = ((bits[k] << 7) & 0b10000000) |
-                            ((bits[k+1] << 6) & 0b01000000) |
-                            ((bits[k+2] << 5) & 0b00100000) |
-                            ((bits[k+3] << 4) & 0b00010000) |
-                            ((bits[k+4] << 3) & 0b00001000) |
-                            ((bits[k+5] << 2) & 0b00000100) |
-                            ((bits[k+6] << 1) & 0b00000010) |
-                            (bits[k+7] & 0b00000001);
-                k = k + 8;
-            }
-            buffer = schc_header;
+            writer.put(0, 1);       // c = 0
+            first_win_with_error = false;
         }
-
-        _compound_ack_string = bitmap_str;
+        writer.put(bitmaps[w] >> (64 - win_size), win_size);
     }
 
+    /* Se agregan los bits de padding */
+    int n_paddin_bits = 8 - (n_bits % 8);
+    writer.put(0, n_paddin_bits);
+
+    len = writer.bytes;
+    SCHC_GW_Metrics::add(SCHC_GW_METRIC_ACKS_SENT);
     return 0;
 }
 
@@ -288,8 +201,7 @@ uint8_t SCHC_GW_Message::decode_message(uint8_t protocol, int rule_id, char *msg
                    (static_cast<uint32_t>(msg[3] << 8)) & 0x0000FF00  | (static_cast<uint32_t>(msg[4])) & 0x000000FF;
 
             _schc_payload_len   = (len - 5)*8;                          // in bits
-            _schc_payload       = new char[_schc_payload_len/8];        // * Liberada en linea 172. largo del mensaje menos 1 byte del header
-            std::memcpy(_schc_payload, msg + 5, _schc_payload_len/8);
+            _schc_payload       = msg + 5;                              // largo del mensaje menos 1 byte del header y 4 del RCS
              
         }
         else if (rule_id==SCHC_FRAG_UPDIR_RULE_ID && len>1)
@@ -297,12 +209,11 @@ uint8_t SCHC_GW_Message::decode_message(uint8_t protocol, int rule_id, char *msg
             SPDLOG_DEBUG("Decoding SCHC Regular message");
 
             _schc_payload_len   = (len - 1)*8;                      // in bits
-            _schc_payload       = new char[_schc_payload_len/8];    // * Liberada en linea 172. Largo del mensaje menos 1 byte del header
-            std::memcpy(_schc_payload, msg + 1, _schc_payload_len/8);
+            _schc_payload       = msg + 1;                          // largo del mensaje menos 1 byte del header
         }   
     }
 
-    delete[] msg;   // * Libera la memoria solicitada en SCHC_GW_TTN_Parser::base64_decode(), linea 110
+    // msg no se libera aqui. Pertenece al SCHC_GW_Fragment que el worker libera despues de execute_machine()
     return 0;
 }
 
@@ -332,98 +243,44 @@ uint8_t SCHC_GW_Message::get_schc_payload(char* schc_payload)
     return 0;
 }
 
-uint32_t SCHC_GW_Message::get_rcs()
+const char* SCHC_GW_Message::get_schc_payload_view()
 {
-    return _rcs;
+    // Valido mientras el mensaje decodificado no sea devuelto al pool
+    return _schc_payload;
 }
 
-std::string SCHC_GW_Message::get_compound_bitmap_str()
+uint32_t SCHC_GW_Message::get_rcs()
 {
-    return _compound_ack_string;
+    return _rcs;
 }
 
-void SCHC_GW_Message::print_buffer_in_hex(char* buffer, int len)
+SCHC_GW_Compound_Bitmap SCHC_GW_Message::get_compound_bitmap()
 {
-    std::ostringstream oss;
-    for (int i = 0; i < len; ++i) 
-    {
-        oss << fmt::format("{:02x} ", static_cast<unsigned char>(buffer[i]));
-    }
-    SPDLOG_TRACE("{}", oss.str());
+    /* El texto se genera solo cuando el log se escribe, a partir de los bitmaps del ultimo compound ACK */
+    return SCHC_GW_Compound_Bitmap(_compound_win_mask, _compound_bitmaps, _compound_win_size);
 }
 
-void SCHC_GW_Message::delete_schc_payload()
+void SCHC_GW_Message::print_buffer_in_hex(char* buffer, int len)
 {
-    delete[] _schc_payload;
+    SPDLOG_TRACE("{}", SCHC_GW_Hex(buffer, len));
 }
 
 void SCHC_GW_Message::printMsg(uint8_t protocol, uint8_t msgType, char *msg, int len)
 {
-    char* buff = new char[100]; // * Liberada en linea 240
+    /* El mensaje se decodifica solo si el nivel DEBUG esta activo. Si SPDLOG_ACTIVE_LEVEL
+    elimina los SPDLOG_DEBUG en compilacion, las variables quedan sin uso */
+    if(!spdlog::should_log(spdlog::level::debug))
+        return;
+    [[maybe_unused]] uint8_t w      = (msg[0] & 0xC0) >> 6;
+    [[maybe_unused]] uint8_t fcn    = (msg[0] & 0x3F);
     if(msgType==SCHC_REGULAR_FRAGMENT_MSG)
     {
-        uint8_t w = (msg[0] & 0xC0) >> 6;
-        uint8_t fcn = (msg[0] & 0x3F);
-        sprintf(buff, "|-----W=");
-        sprintf(buff,"%d",w);
-        sprintf(buff, ", FCN=");
-        sprintf(buff,"%d",fcn);
-        if(fcn>9)
-        {
-            sprintf(buff, "----->| ");
-        }
-        else
-        {
-            sprintf(buff, " ----->| ");
-        }
-
         int tile_size = 10;          // hardcoding warning - tile size = 10
-        int n_tiles = (len-1)/tile_size;   
-        if(n_tiles>9)
-        {
-            sprintf(buff, "%d", n_tiles);
-            sprintf(buff, " tiles sent");
-        }
-        else
-        {
-            sprintf(buff, " %d", n_tiles);
-            sprintf(buff, " tiles sent");
-        }      
-    }
-    else if(msgType==SCHC_ACK_REQ_MSG)
-    {
-        uint8_t w = (msg[0] & 0xC0) >> 6;
-        uint8_t fcn = (msg[0] & 0x3F);
-        sprintf(buff, "|-----W=");
-        sprintf(buff,"%d",w);
-        sprintf(buff, ", FCN=");
-        sprintf(buff,"%d",fcn);
-        if(fcn>9)
-        {
-            sprintf(buff, "----->| ");
-        }
-        else
-        {
-            sprintf(buff, " ----->| ");
-        }
+        [[maybe_unused]] int n_tiles = (len-1)/tile_size;
+        SPDLOG_DEBUG("|-----W={}, FCN={:<2}----->| {:>2} tiles sent", w, fcn, n_tiles);
     }
-    else if(msgType==SCHC_SENDER_ABORT_MSG)
+    else if(msgType==SCHC_ACK_REQ_MSG || msgType==SCHC_SENDER_ABORT_MSG)
     {
-        uint8_t w = (msg[0] & 0xC0) >> 6;
-        uint8_t fcn = (msg[0] & 0x3F);
-        sprintf(buff, "|-----W=");
-        sprintf(buff,"%d",w);
-        sprintf(buff, ", FCN=");
-        sprintf(buff,"%d",fcn);
-        if(fcn>9)
-        {
-            sprintf(buff,"----->| ");
-        }
-        else
-        {
-            sprintf(buff," ----->| ");
-        }
+        SPDLOG_DEBUG("|-----W={}, FCN={:<2}----->| ", w, fcn);
     }
-    SPDLOG_DEBUG("{}",buff);
-    delete[] buff;
 }
\ No newline at end of file
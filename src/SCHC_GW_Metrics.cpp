@@ -0,0 +1,342 @@
+#include "SCHC_GW_Metrics.hpp"
+#include "SCHC_GW_Macros.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <fmt/format.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#define SCHC_GW_METRICS_MAX_REQUEST     4096
+#define SCHC_GW_METRICS_DEADLINE_MS     1000    // tiempo maximo por peticion, desde accept() hasta enviar la respuesta
+#define SCHC_GW_METRICS_FIRST_BUCKET    10      // 1.024 us. Los buckets menores se acumulan en el primero
+#define SCHC_GW_METRICS_LAST_BUCKET     36      // 68.7 s
+
+/* Bloque de metricas de un hilo. Solo su hilo escribe en el, por lo que las
+operaciones atomicas no compiten por la linea de cache */
+struct alignas(64) SCHC_GW_Metrics_Block
+{
+    std::atomic<uint64_t>       counters[SCHC_GW_METRIC_COUNTERS] = {};
+    SCHC_GW_Latency_Histogram   histograms[SCHC_GW_METRIC_HISTOGRAMS];
+};
+
+struct SCHC_GW_Metrics_Callback
+{
+    const void*                 owner;
+    uint8_t                     type;
+    std::string                 name;
+    std::string                 labels;
+    std::string                 help;
+    std::function<double()>     value;
+};
+
+struct SCHC_GW_Metrics_Info
+{
+    const char*     name;
+    const char*     labels;
+    const char*     help;
+};
+
+static const SCHC_GW_Metrics_Info counter_info[SCHC_GW_METRIC_COUNTERS] =
+{
+    {"schc_gw_fragments_received_total",    "type=\"regular\"",         "SCHC messages received by the state machines, by type"},
+    {"schc_gw_fragments_received_total",    "type=\"all1\"",            nullptr},
+    {"schc_gw_fragments_received_total",    "type=\"ack\"",             nullptr},
+    {"schc_gw_fragments_received_total",    "type=\"ack_req\"",         nullptr},
+    {"schc_gw_fragments_received_total",    "type=\"sender_abort\"",    nullptr},
+    {"schc_gw_fragments_received_total",    "type=\"receiver_abort\"",  nullptr},
+    {"schc_gw_fragments_received_total",    "type=\"unknown\"",         nullptr},
+    {"schc_gw_acks_sent_total",             "",                         "SCHC ACKs built by the state machines"},
+    {"schc_gw_tiles_lost_total",            "",                         "Tiles skipped by a later regular fragment (gaps in the reassembly)"},
+    {"schc_gw_fragments_dropped_total",     "",                         "Regular fragments discarded by the simulated loss pattern"},
+    {"schc_gw_rcs_failures_total",          "",                         "All-1 fragments whose RCS did not match the reassembled packet"},
+    {"schc_gw_sessions_started_total",      "",                         "Uplink sessions started"},
+    {"schc_gw_sessions_ended_total",        "",                         "Uplink sessions finished"},
+};
+
+static const SCHC_GW_Metrics_Info histogram_info[SCHC_GW_METRIC_HISTOGRAMS] =
+{
+    {"schc_gw_queue_latency_seconds",       "",     "Time between the enqueue of a message in a worker and the execution of its state machine"},
+    {"schc_gw_downlink_latency_seconds",    "",     "Time between the enqueue of a downlink in the outbox and its delivery to the broker"},
+};
+
+static std::vector<SCHC_GW_Metrics_Block*>      metrics_blocks;         // los bloques nunca se liberan: sobreviven a sus hilos
+static std::mutex                               blocks_mutex;
+static std::vector<SCHC_GW_Metrics_Callback>    metrics_callbacks;
+static std::mutex                               callbacks_mutex;        // no se toma junto con blocks_mutex
+static std::thread                              server_thread;
+static std::atomic<bool>                        server_running{false};
+
+static SCHC_GW_Metrics_Block& get_block()
+{
+    thread_local SCHC_GW_Metrics_Block* block = nullptr;
+    if(block == nullptr)
+    {
+        block = new SCHC_GW_Metrics_Block();
+        std::lock_guard<std::mutex> lock(blocks_mutex);
+        metrics_blocks.push_back(block);
+    }
+    return *block;
+}
+
+void SCHC_GW_Metrics::add(int counter, uint64_t n)
+{
+    get_block().counters[counter].fetch_add(n, std::memory_order_relaxed);
+}
+
+void SCHC_GW_Metrics::add_received(uint8_t msg_type)
+{
+    if(msg_type > SCHC_RECEIVER_ABORT_MSG)
+        add(SCHC_GW_METRIC_RX_UNKNOWN);
+    else
+        add(SCHC_GW_METRIC_RX_MSG + msg_type);
+}
+
+void SCHC_GW_Metrics::record(int histogram, uint64_t ns)
+{
+    get_block().histograms[histogram].record(ns);
+}
+
+uint64_t SCHC_GW_Metrics::get_counter(int counter)
+{
+    std::lock_guard<std::mutex> lock(blocks_mutex);
+    uint64_t sum = 0;
+    for(SCHC_GW_Metrics_Block* block : metrics_blocks)
+    {
+        sum = sum + block->counters[counter].load(std::memory_order_relaxed);
+    }
+    return sum;
+}
+
+void SCHC_GW_Metrics::get_histogram(int histogram, SCHC_GW_Latency_Histogram& out)
+{
+    out.reset();
+    std::lock_guard<std::mutex> lock(blocks_mutex);
+    for(SCHC_GW_Metrics_Block* block : metrics_blocks)
+    {
+        out.merge(block->histograms[histogram]);
+    }
+}
+
+void SCHC_GW_Metrics::add_callback(const void* owner, uint8_t type, const char* name, const std::string& labels, const char* help, std::function<double()> value)
+{
+    std::lock_guard<std::mutex> lock(callbacks_mutex);
+    metrics_callbacks.push_back({owner, type, name, labels, help, std::move(value)});
+}
+
+void SCHC_GW_Metrics::remove_callbacks(const void* owner)
+{
+    /* Al retornar ningun render() esta usando los callbacks del owner */
+    std::lock_guard<std::mutex> lock(callbacks_mutex);
+    metrics_callbacks.erase(std::remove_if(metrics_callbacks.begin(), metrics_callbacks.end(),
+                                           [owner](const SCHC_GW_Metrics_Callback& callback) { return callback.owner == owner; }),
+                            metrics_callbacks.end());
+}
+
+std::string SCHC_GW_Metrics::render()
+{
+    fmt::memory_buffer out;
+    auto header = [&out](const char* name, const char* help, const char* type)
+    {
+        fmt::format_to(std::back_inserter(out), "# HELP {} {}\n# TYPE {} {}\n", name, help, name, type);
+    };
+    auto sample = [&out](const std::string& name, const std::string& labels, auto value)
+    {
+        if(labels.empty())
+            fmt::format_to(std::back_inserter(out), "{} {}\n", name, value);
+        else
+            fmt::format_to(std::back_inserter(out), "{}{{{}}} {}\n", name, labels, value);
+    };
+
+    /* Contadores de los bloques. Las series de un mismo nombre son consecutivas en counter_info */
+    for(int i=0; i<SCHC_GW_METRIC_COUNTERS; i++)
+    {
+        if(counter_info[i].help != nullptr)
+            header(counter_info[i].name, counter_info[i].help, "counter");
+        sample(counter_info[i].name, counter_info[i].labels, get_counter(i));
+    }
+
+    /* Histogramas, con buckets acumulados en segundos */
+    for(int i=0; i<SCHC_GW_METRIC_HISTOGRAMS; i++)
+    {
+        SCHC_GW_Latency_Histogram histogram;
+        get_histogram(i, histogram);
+        std::string name = histogram_info[i].name;
+        header(histogram_info[i].name, histogram_info[i].help, "histogram");
+
+        uint64_t acum = 0;
+        for(int b=0; b<SCHC_GW_HISTOGRAM_BUCKETS; b++)
+        {
+            acum = acum + histogram.get_bucket_count(b);
+            if(b >= SCHC_GW_METRICS_FIRST_BUCKET && b <= SCHC_GW_METRICS_LAST_BUCKET)
+                sample(name + "_bucket", fmt::format("le=\"{}\"", SCHC_GW_Latency_Histogram::get_bucket_upper_ns(b) / 1e9), acum);
+        }
+        sample(name + "_bucket", "le=\"+Inf\"", acum);
+        sample(name + "_sum", "", histogram.get_sum_ns() / 1e9);
+        sample(name + "_count", "", acum);
+    }
+
+    /* Callbacks agrupados por nombre: HELP y TYPE van una sola vez por metrica */
+    std::lock_guard<std::mutex> lock(callbacks_mutex);
+    std::vector<const SCHC_GW_Metrics_Callback*> callbacks;
+    for(const SCHC_GW_Metrics_Callback& callback : metrics_callbacks)
+    {
+        callbacks.push_back(&callback);
+    }
+    std::stable_sort(callbacks.begin(), callbacks.end(),
+                     [](const SCHC_GW_Metrics_Callback* a, const SCHC_GW_Metrics_Callback* b) { return a->name < b->name; });
+
+    for(size_t i=0; i<callbacks.size(); i++)
+    {
+        const SCHC_GW_Metrics_Callback& callback = *callbacks[i];
+        if(i == 0 || callbacks[i - 1]->name != callback.name)
+            header(callback.name.c_str(), callback.help.c_str(), callback.type == SCHC_GW_METRIC_COUNTER ? "counter" : "gauge");
+        sample(callback.name, callback.labels, callback.value());
+    }
+
+    return fmt::to_string(out);
+}
+
+uint8_t SCHC_GW_Metrics::start_server(const std::string& bind_address, int port)
+{
+    SPDLOG_TRACE("Entering the function");
+
+    if(server_running.load())
+        return 0;
+
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port   = htons(port);
+    if(inet_pton(AF_INET, bind_address.c_str(), &addr.sin_addr) != 1)
+    {
+        SPDLOG_ERROR("Invalid metrics bind address: {}", bind_address);
+        return 1;
+    }
+
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if(fd < 0)
+    {
+        SPDLOG_ERROR("The metrics socket could not be created: {}", strerror(errno));
+        return 1;
+    }
+    int reuse = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    if(bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || listen(fd, 16) != 0)
+    {
+        SPDLOG_ERROR("The metrics server could not listen on {}:{}: {}", bind_address, port, strerror(errno));
+        close(fd);
+        return 1;
+    }
+
+    server_running.store(true);
+    server_thread = std::thread(&SCHC_GW_Metrics::server_loop, fd);
+    SPDLOG_DEBUG("Metrics server listening on http://{}:{}/metrics", bind_address, port);
+
+    SPDLOG_TRACE("Leaving the function");
+    return 0;
+}
+
+void SCHC_GW_Metrics::stop_server()
+{
+    if(!server_running.exchange(false))
+        return;
+
+    if(server_thread.joinable())
+        server_thread.join();
+}
+
+void SCHC_GW_Metrics::server_loop(int listen_fd)
+{
+    SPDLOG_INFO("Entering server_loop()");
+
+    /* Las peticiones se atienden de a una: el exportador es consultado cada varios segundos */
+    pollfd pfd = {listen_fd, POLLIN, 0};
+    while(server_running.load())
+    {
+        if(poll(&pfd, 1, 200) <= 0)
+            continue;
+        int fd = accept(listen_fd, nullptr, nullptr);
+        if(fd < 0)
+            continue;
+        serve(fd);
+        close(fd);
+    }
+    close(listen_fd);
+
+    SPDLOG_WARN("\033[1mMetrics server finished\033[0m");
+    return;
+}
+
+static int remaining_ms(std::chrono::steady_clock::time_point deadline)
+{
+    auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+    return left > 0 ? int(left) : 0;
+}
+
+void SCHC_GW_Metrics::serve(int fd)
+{
+    /* Las peticiones se atienden de a una, por lo que toda la conexion tiene un solo deadline.
+    Un cliente lento no puede retener el endpoint renovando el timeout con cada byte */
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(SCHC_GW_METRICS_DEADLINE_MS);
+
+    /* Lee la peticion hasta el fin de los headers */
+    char    request[SCHC_GW_METRICS_MAX_REQUEST + 1];
+    int     len = 0;
+    pollfd  pfd = {fd, POLLIN, 0};
+    while(len < SCHC_GW_METRICS_MAX_REQUEST)
+    {
+        int timeout = remaining_ms(deadline);
+        if(timeout == 0 || poll(&pfd, 1, timeout) <= 0)
+            return;
+        ssize_t n = recv(fd, request + len, SCHC_GW_METRICS_MAX_REQUEST - len, 0);
+        if(n <= 0)
+            return;
+        len = len + n;
+        request[len] = '\0';
+        if(strstr(request, "\r\n\r\n") != nullptr)
+            break;
+    }
+    request[len] = '\0';
+
+    std::string body;
+    const char* status;
+    const char* content_type;
+    if(strncmp(request, "GET /metrics", 12) == 0 && (request[12] == ' ' || request[12] == '?'))
+    {
+        status          = "200 OK";
+        content_type    = "text/plain; version=0.0.4; charset=utf-8";
+        body            = render();
+    }
+    else
+    {
+        status          = "404 Not Found";
+        content_type    = "text/plain; charset=utf-8";
+        body            = "Not Found\n";
+    }
+
+    std::string response = fmt::format("HTTP/1.1 {}\r\nContent-Type: {}\r\nContent-Length: {}\r\nConnection: close\r\n\r\n", status, content_type, body.size());
+    response.append(body);
+
+    size_t sent = 0;
+    pfd.events  = POLLOUT;
+    while(sent < response.size())
+    {
+        int timeout = remaining_ms(deadline);
+        if(timeout == 0 || poll(&pfd, 1, timeout) <= 0)
+            return;
+        ssize_t n = send(fd, response.data() + sent, response.size() - sent, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if(n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            continue;
+        if(n <= 0)
+            return;
+        sent = sent + n;
+    }
+}
@@ -1,14 +1,16 @@
 #include "SCHC_GW_Session.hpp"
 #include "SCHC_GW_Fragmenter.hpp"
+#include "SCHC_GW_Metrics.hpp"
 
-uint8_t SCHC_GW_Session::initialize(SCHC_GW_Fragmenter* frag, uint8_t protocol, uint8_t direction, uint8_t session_id, SCHC_GW_Stack_L2 *stack_ptr, uint8_t ack_mode, uint8_t error_prob)
+uint8_t SCHC_GW_Session::initialize(SCHC_GW_Fragmenter* frag, uint8_t protocol, uint8_t direction, int session_id, SCHC_GW_Stack_L2 *stack_ptr, SCHC_GW_Worker_Pool* pool, uint8_t ack_mode, const SCHC_GW_Loss_Pattern* loss_pattern)
 {
     SPDLOG_TRACE("Entering the function");
 
     _session_id = session_id;
     _frag       = frag;
+    _pool       = pool;
     _ack_mode   = ack_mode;
-    _error_prob = error_prob;
+    _loss_pattern = loss_pattern;
 
     set_running(false);         // at the beginning, the sessions are not being used
     set_is_first_msg(true);     // the flag allows to create the state machine only with the first message
@@ -51,7 +53,7 @@ uint8_t SCHC_GW_Session::initialize(SCHC_GW_Fragmenter* frag, uint8_t protocol,
     return 0;
 }
 
-void SCHC_GW_Session::process_message(std::string dev_id, int rule_id, char* msg, int len)
+void SCHC_GW_Session::process_message(SCHC_GW_Fragment&& frag)
 {
 
     SPDLOG_TRACE("Entering the function.");
@@ -60,42 +62,49 @@ void SCHC_GW_Session::process_message(std::string dev_id, int rule_id, char* msg
     {
         if(is_first_msg())
         {
-            SPDLOG_WARN("\033[34mReceiving first message from: {}\033[0m", dev_id);
-            _dev_id     = dev_id;
+            _device     = frag.get_device();
+            _worker_id  = _pool->get_worker_id(_device);
+            _stack->open_device(_device);       // el topic de los ACKs se arma una vez por sesion
+            SPDLOG_WARN("\033[34mReceiving first message from: {}\033[0m", SCHC_GW_Device_Table::get_device_id(_device));
 
             /* Creando e inicializando maquina de estado*/
             _stateMachine = std::make_shared<SCHC_GW_Ack_on_error>();
 
             _stateMachine->set_end_callback(std::bind(&SCHC_GW_Session::destroyStateMachine, this));
-            _stateMachine->set_error_prob(_error_prob);
+            _stateMachine->set_loss_pattern(*_loss_pattern, std::hash<std::string_view>{}(SCHC_GW_Device_Table::get_device_id(_device)));     // perdidas reproducibles por dispositivo
             SPDLOG_DEBUG("State machine successfully created.");
 
             /* Inicializando maquina de estado */
-            _stateMachine->init(dev_id, rule_id, 0, _windowSize, _tileSize, _n, _m, _ack_mode, _stack, _retransTimer, _maxAckReq);
+            _stateMachine->init(_device, frag.get_rule_id(), 0, _windowSize, _tileSize, _n, _m, _ack_mode, _stack, _retransTimer, _maxAckReq);
             SPDLOG_DEBUG("State machine successfully initiated.");
 
             set_is_first_msg(false);
+            SCHC_GW_Metrics::add(SCHC_GW_METRIC_SESSIONS_STARTED);
         }
 
-        _stateMachine->queue_message(rule_id, msg, len);
-        SPDLOG_DEBUG("Message successfully queue in the state machine.");
+        _pool->post(_worker_id, _stateMachine, std::move(frag));
+        SPDLOG_DEBUG("Message successfully queue in the worker {}.", _worker_id);
     }
     else if (_protocol==SCHC_FRAG_LORAWAN && _direction==SCHC_FRAG_DOWN)
     {
         if(is_first_msg())
         {
+            _device     = frag.get_device();
+            _worker_id  = _pool->get_worker_id(_device);
+            _stack->open_device(_device);
+
             /* Creando e inicializando maquina de estado*/
             // TODO: Instanciar un SCHC_ACK_Always()  
 
             /* Inicializando maquina de estado */
-            _stateMachine->init(dev_id, rule_id, 0, _windowSize, _tileSize, _n, _m, ACK_MODE_ACK_END_WIN, _stack, _retransTimer, _maxAckReq);
+            _stateMachine->init(_device, frag.get_rule_id(), 0, _windowSize, _tileSize, _n, _m, ACK_MODE_ACK_END_WIN, _stack, _retransTimer, _maxAckReq);
 
             SPDLOG_DEBUG("State machine successfully created, initiated, and started");
 
             set_is_first_msg(false);
         }    
 
-        _stateMachine->queue_message(rule_id, msg, len);    
+        _pool->post(_worker_id, _stateMachine, std::move(frag));
     }
     
     SPDLOG_TRACE("Leaving the function");
@@ -125,10 +134,26 @@ void SCHC_GW_Session::destroyStateMachine()
 {
     set_running(false);
     set_is_first_msg(true);
+    SCHC_GW_Metrics::add(SCHC_GW_METRIC_SESSIONS_ENDED);
     SPDLOG_WARN("Blocking new message reception (is_running = false).");
     _stateMachine.reset();
     SPDLOG_WARN("State machine successfully destroyed");
-    _frag->disassociate_session_id(_dev_id);
-    SPDLOG_WARN("Session successfully disassociate");
+    _frag->disassociate_session_id(_device, _session_id);
+    SPDLOG_WARN("Session successfully retired");
     return;
 }
+
+size_t SCHC_GW_Session::get_memory_footprint(uint8_t protocol, uint8_t direction)
+{
+    size_t size = sizeof(SCHC_GW_Session);
+    if(direction==SCHC_FRAG_UP && protocol==SCHC_FRAG_LORAWAN)
+    {
+        // Ack-on-Error con el perfil LoRaWAN (ver SCHC_GW_Ack_on_error::init()):
+        // 4 ventanas de 63 tiles de 10 bytes, mas el ultimo tile y los bitmaps
+        size_t nWindows = 4;
+        size_t nTiles   = 63*nWindows;
+        size = size + sizeof(SCHC_GW_Ack_on_error);
+        size = size + nWindows*8 + nTiles*10 + 10 + SCHC_REASSEMBLY_ALIGN;   // arena de reensamblado
+    }
+    return size;
+}
@@ -0,0 +1,141 @@
+#include "SCHC_GW_Session_Table.hpp"
+#include "SCHC_GW_Metrics.hpp"
+
+SCHC_GW_Session_Table::~SCHC_GW_Session_Table()
+{
+    SCHC_GW_Metrics::remove_callbacks(this);
+    for(int i=0; i<_n_slabs; i++)
+    {
+        delete[] _slabs[i].load();
+    }
+}
+
+uint8_t SCHC_GW_Session_Table::initialize(SCHC_GW_Fragmenter* frag, uint8_t protocol, uint8_t direction, SCHC_GW_Stack_L2* stack_ptr, SCHC_GW_Worker_Pool* pool, uint8_t ack_mode, const SCHC_GW_Loss_Pattern* loss_pattern, int max_sessions, size_t mem_budget)
+{
+    SPDLOG_TRACE("Entering the function");
+
+    _frag       = frag;
+    _protocol   = protocol;
+    _direction  = direction;
+    _stack      = stack_ptr;
+    _pool       = pool;
+    _ack_mode   = ack_mode;
+    _loss_pattern = loss_pattern;
+    _n_slabs    = 0;
+    _active     = 0;
+
+    /* El limite efectivo es el menor entre max_sessions y las sesiones que caben en mem_budget */
+    size_t session_size = SCHC_GW_Session::get_memory_footprint(protocol, direction);
+    _max_sessions       = max_sessions;
+    if(mem_budget > 0 && mem_budget/session_size < (size_t)_max_sessions)
+    {
+        _max_sessions = mem_budget/session_size;
+        SPDLOG_WARN("Session table limited by the memory budget to {} sessions ({} bytes per session)", _max_sessions, session_size);
+    }
+
+    _max_slabs  = (_max_sessions + _SESSION_SLAB_SIZE - 1) / _SESSION_SLAB_SIZE;
+    _slabs.reset(new std::atomic<SCHC_GW_Session*>[_max_slabs]);
+    for(int i=0; i<_max_slabs; i++)
+    {
+        _slabs[i].store(nullptr);
+    }
+    _free_list.reserve(_SESSION_SLAB_SIZE);
+    _in_use.reserve(_SESSION_SLAB_SIZE);
+
+    SCHC_GW_Metrics::add_callback(this, SCHC_GW_METRIC_GAUGE, "schc_gw_active_sessions", direction == SCHC_FRAG_UP ? "direction=\"up\"" : "direction=\"down\"",
+                                  "Sessions allocated in the session table, including the retired ones in their grace period", [this]() { return double(get_active_sessions()); });
+
+    SPDLOG_DEBUG("Session table initialized. Max sessions: {}, slab size: {}", _max_sessions, _SESSION_SLAB_SIZE);
+    SPDLOG_TRACE("Leaving the function");
+    return 0;
+}
+
+int SCHC_GW_Session_Table::allocate()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    if(_active >= _max_sessions)
+    {
+        SPDLOG_ERROR("All sessiones are used. Max sessions: {}", _max_sessions);
+        return -1;
+    }
+
+    if(_free_list.empty() && !grow())
+    {
+        SPDLOG_ERROR("All sessiones are used. Max sessions: {}", _max_sessions);
+        return -1;
+    }
+
+    int session_id = _free_list.back();
+    _free_list.pop_back();
+    _in_use[session_id] = true;
+    _active++;
+
+    get_session(session_id).set_running(true);
+    SPDLOG_TRACE("Selecting the session {}", session_id);
+    return session_id;
+}
+
+uint8_t SCHC_GW_Session_Table::release(int session_id)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    if(session_id < 0 || session_id >= (int)_in_use.size() || !_in_use[session_id])
+    {
+        /* Un segundo release() pondria el id dos veces en la free list y dos sesiones compartirian el slot */
+        SPDLOG_ERROR("The session {} is not in use. Could not release", session_id);
+        return 1;
+    }
+    _in_use[session_id] = false;
+    _free_list.push_back(session_id);
+    _active--;
+    return 0;
+}
+
+SCHC_GW_Session& SCHC_GW_Session_Table::get_session(int session_id)
+{
+    SCHC_GW_Session* slab = _slabs[session_id / _SESSION_SLAB_SIZE].load(std::memory_order_acquire);
+    return slab[session_id % _SESSION_SLAB_SIZE];
+}
+
+int SCHC_GW_Session_Table::get_active_sessions()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _active;
+}
+
+int SCHC_GW_Session_Table::get_capacity()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _n_slabs * _SESSION_SLAB_SIZE;
+}
+
+int SCHC_GW_Session_Table::get_max_sessions()
+{
+    return _max_sessions;
+}
+
+bool SCHC_GW_Session_Table::grow()
+{
+    /* Se llama con _mutex tomado */
+    if(_n_slabs >= _max_slabs)
+        return false;
+
+    SCHC_GW_Session* slab = new SCHC_GW_Session[_SESSION_SLAB_SIZE];
+    int first_id = _n_slabs * _SESSION_SLAB_SIZE;
+    for(int i=0; i<_SESSION_SLAB_SIZE; i++)
+    {
+        slab[i].initialize(_frag, _protocol, _direction, first_id + i, _stack, _pool, _ack_mode, _loss_pattern);
+    }
+    _slabs[_n_slabs].store(slab, std::memory_order_release);
+    _n_slabs++;
+    _in_use.resize(_n_slabs * _SESSION_SLAB_SIZE, false);
+
+    /* Se agregan en orden inverso para que allocate() entregue primero los id mas bajos */
+    for(int i=_SESSION_SLAB_SIZE-1; i>=0; i--)
+    {
+        _free_list.push_back(first_id + i);
+    }
+
+    SPDLOG_DEBUG("Session table grown to {} sessions", _n_slabs * _SESSION_SLAB_SIZE);
+    return true;
+}
@@ -1,4 +1,31 @@
 #include "SCHC_GW_TTN_MQTT_Stack.hpp"
+#include "SCHC_GW_Alloc_Counter.hpp"
+
+/* Plantilla del JSON de los downlinks de TTN. Las claves van en el mismo orden que
+generaba nlohmann::json::dump() */
+static const char   json_prefix[]   = "{\"downlinks\":[{\"f_port\":";
+static const char   json_middle[]   = ",\"frm_payload\":\"";
+static const char   json_suffix[]   = "\",\"priority\":\"NORMAL\"}]}";
+static const char   topic_suffix[]  = "/down/push";
+
+static_assert(sizeof(json_prefix) + 3 + sizeof(json_middle) + 4 * ((SCHC_GW_DOWNLINK_MAX_LEN + 2) / 3) + sizeof(json_suffix) <= SCHC_GW_DOWNLINK_JSON_MAX_LEN,
+              "SCHC_GW_DOWNLINK_JSON_MAX_LEN is too small for the downlink JSON");
+
+SCHC_GW_TTN_MQTT_Stack::~SCHC_GW_TTN_MQTT_Stack()
+{
+    stop_stack();
+
+    free_retired_topics();
+    for(auto& topic_block : _topic_blocks)
+    {
+        std::atomic<char*>* block = topic_block.load();
+        if(block == nullptr)
+            continue;
+        for(size_t i=0; i<SCHC_GW_DEVICE_BLOCK_SIZE; i++)
+            delete[] block[i].load();
+        delete[] block;
+    }
+}
 
 uint8_t SCHC_GW_TTN_MQTT_Stack::initialize_stack(void)
 {
@@ -13,62 +40,288 @@ uint8_t SCHC_GW_TTN_MQTT_Stack::initialize_stack(void)
         return 1;
     }
 
-    _mqqt_username = ini.GetValue("mqtt", "username", "Desconocido");
+    // Se copia: el valor que retorna GetValue() se libera junto con ini
+    _mqqt_username          = ini.GetValue("mqtt", "username", "Desconocido");
+    int outbox_size         = std::stoi(ini.GetValue("downlink", "outbox_size", "1024"));
+    _batch_size             = std::stoi(ini.GetValue("downlink", "batch_size", "32"));
+    if(_batch_size < 1)
+        _batch_size = 1;
+
+    /* El prefijo del topic no cambia. Se reserva espacio para el device id mas largo */
+    _topic_prefix       = "v3/" + _mqqt_username + "/devices/";
+    _topic              = _topic_prefix;
+    _topic.reserve(_topic_prefix.size() + SCHC_GW_DEVICE_ID_MAX_LEN + sizeof(topic_suffix));
+
+    _outbox.initialize(outbox_size);
+
+    /* mosquitto asigna los mids de 1 a 65535. La tabla cubre varias vueltas del outbox */
+    size_t n_in_flight = 2;
+    while(n_in_flight < 4 * _outbox.get_capacity() && n_in_flight < 65536)
+        n_in_flight = n_in_flight * 2;
+    _in_flight      = std::make_unique<In_Flight[]>(n_in_flight);
+    _in_flight_mask = n_in_flight - 1;
 
+    mosquitto_user_data_set(_mosq, this);
+    mosquitto_publish_callback_set(_mosq, SCHC_GW_TTN_MQTT_Stack::on_publish);
+
+    SCHC_GW_Metrics::add_callback(this, SCHC_GW_METRIC_GAUGE, "schc_gw_outbox_depth", "", "Downlinks waiting in the outbox", [this]() { return double(get_depth()); });
+    SCHC_GW_Metrics::add_callback(this, SCHC_GW_METRIC_COUNTER, "schc_gw_downlinks_total", "result=\"enqueued\"", "Downlinks by stage of the outbox", [this]() { return double(get_enqueued()); });
+    SCHC_GW_Metrics::add_callback(this, SCHC_GW_METRIC_COUNTER, "schc_gw_downlinks_total", "result=\"published\"", "", [this]() { return double(get_published()); });
+    SCHC_GW_Metrics::add_callback(this, SCHC_GW_METRIC_COUNTER, "schc_gw_downlinks_total", "result=\"completed\"", "", [this]() { return double(get_completed()); });
+    SCHC_GW_Metrics::add_callback(this, SCHC_GW_METRIC_COUNTER, "schc_gw_downlinks_total", "result=\"dropped\"", "", [this]() { return double(get_dropped()); });
+    SCHC_GW_Metrics::add_callback(this, SCHC_GW_METRIC_COUNTER, "schc_gw_downlinks_total", "result=\"publish_error\"", "", [this]() { return double(get_publish_errors()); });
+    SCHC_GW_Metrics::add_callback(this, SCHC_GW_METRIC_GAUGE, "schc_gw_downlink_topics", "", "Downlink topics cached for devices with a session", [this]() { return double(get_cached_topics()); });
+    SCHC_GW_Metrics::add_callback(this, SCHC_GW_METRIC_COUNTER, "schc_gw_downlink_topic_misses_total", "", "Downlinks whose topic was not in the cache", [this]() { return double(get_topic_misses()); });
+
+    _running.store(true);
+    _publisher = std::thread(&SCHC_GW_TTN_MQTT_Stack::publisher_loop, this);
+    SPDLOG_DEBUG("Downlink publisher successfully created with an outbox of {} downlinks and batches of {}", _outbox.get_capacity(), _batch_size);
 
     return 0;
 }
 
-uint8_t SCHC_GW_TTN_MQTT_Stack::send_downlink_frame(std::string dev_id, uint8_t ruleID, char *msg, int len)
+void SCHC_GW_TTN_MQTT_Stack::stop_stack(void)
 {
-    std::string topic = "v3/" + std::string(_mqqt_username) + "/devices/" + dev_id + "/down/push";
+    if(!_running.exchange(false))
+        return;
 
-    // Variables con valores dinámicos
-    int         f_port_value        = ruleID;
-    std::string frm_payload_value   = this->base64_encode(msg, len);
-    std::string priority_value      = "NORMAL";
+    SCHC_GW_Metrics::remove_callbacks(this);
+    _outbox.notify_all();
+    if(_publisher.joinable())
+        _publisher.join();
+    SPDLOG_WARN("Downlink publisher stopped: {}", to_string());
+    if(SCHC_GW_Alloc_Counter::is_enabled())
+        SPDLOG_WARN("Heap allocations per downlink in the publisher: {:.2f}", get_allocs_per_downlink());
+}
 
-    // Crear un objeto JSON con valores provenientes de variables
-    json json_object = {
-        {"downlinks", {
-            {
-                {"f_port", f_port_value},
-                {"frm_payload", frm_payload_value},
-                {"priority", priority_value}
-            }
-        }}
-    };
+uint8_t SCHC_GW_TTN_MQTT_Stack::send_downlink_frame(uint32_t device, uint8_t ruleID, char *msg, int len)
+{
+    /* Se ejecuta en los hilos de las sesiones: solo copia el downlink al outbox y retorna */
+    if(len < 0 || len > SCHC_GW_DOWNLINK_MAX_LEN)
+    {
+        _dropped.fetch_add(1, std::memory_order_relaxed);
+        SPDLOG_ERROR("Downlink of {} bytes for {} does not fit in the outbox. Discarding downlink", len, SCHC_GW_Device_Table::get_device_id(device));
+        return 1;
+    }
 
-    // Convertir el objeto JSON a una cadena (string) y luego a char*
-    std::string json_string = json_object.dump();
-    const char* json_c_str = json_string.c_str();
+    bool pushed = _outbox.try_push([&](Downlink& downlink)
+    {
+        downlink.device         = device;
+        downlink.rule_id        = ruleID;
+        downlink.len            = len;
+        memcpy(downlink.payload, msg, len);
+        downlink.enqueued_at    = std::chrono::steady_clock::now();
+    });
+    if(!pushed)
+    {
+        uint64_t dropped = _dropped.fetch_add(1, std::memory_order_relaxed) + 1;
+        if((dropped & (dropped - 1)) == 0)      // se informa en la 1ra, 2da, 4ta, 8va, ... perdida
+            SPDLOG_WARN("Downlink outbox is full. {} downlinks dropped so far", dropped);
+        return 1;
+    }
+    _enqueued.fetch_add(1, std::memory_order_relaxed);
+    return 0;
+}
 
-    SPDLOG_DEBUG("Downlink topic: {}", topic);
-    SPDLOG_DEBUG("Downlink JSON: {}", json_string);
+void SCHC_GW_TTN_MQTT_Stack::open_device(uint32_t device)
+{
+    /* Se ejecuta al empezar la sesion. Si el dispositivo ya tiene su topic (una sesion
+    nueva durante el grace period de la anterior) se mantiene */
+    std::atomic<char*>* slot = get_topic_slot(device, true);
+    if(slot == nullptr || slot->load(std::memory_order_acquire) != nullptr)
+        return;
 
-    int result = mosquitto_loop(_mosq, -1, 1);
-    if (result != MOSQ_ERR_SUCCESS) {
-        SPDLOG_ERROR("Connection lost with mqtt broker: {}", mosquitto_strerror(result));
-        mosquitto_disconnect(_mosq);
-        mosquitto_destroy(_mosq);
-        return EXIT_FAILURE;
+    std::string_view dev_id = SCHC_GW_Device_Table::get_device_id(device);
+    char* topic = new char[_topic_prefix.size() + dev_id.size() + sizeof(topic_suffix)];
+    char* p     = topic;
+    memcpy(p, _topic_prefix.data(), _topic_prefix.size());
+    p = p + _topic_prefix.size();
+    memcpy(p, dev_id.data(), dev_id.size());
+    p = p + dev_id.size();
+    memcpy(p, topic_suffix, sizeof(topic_suffix));     // incluye el '\0'
+
+    char* expected = nullptr;
+    if(!slot->compare_exchange_strong(expected, topic, std::memory_order_acq_rel))
+    {
+        delete[] topic;     // otro hilo lo armo primero
+        return;
+    }
+    _cached_topics.fetch_add(1, std::memory_order_relaxed);
+    SPDLOG_DEBUG("Downlink topic cached for {}: {}", dev_id, topic);
+}
+
+void SCHC_GW_TTN_MQTT_Stack::close_device(uint32_t device)
+{
+    std::atomic<char*>* slot = get_topic_slot(device, false);
+    if(slot == nullptr)
+        return;
+    char* topic = slot->exchange(nullptr, std::memory_order_acq_rel);
+    if(topic == nullptr)
+        return;
+    _cached_topics.fetch_sub(1, std::memory_order_relaxed);
+
+    /* El publisher puede estar publicando con este topic: lo libera el mismo entre dos lotes */
+    std::lock_guard<std::mutex> lock(_topics_mutex);
+    _retired_topics.push_back(topic);
+    _has_retired_topics.store(true, std::memory_order_release);
+}
+
+std::atomic<char*>* SCHC_GW_TTN_MQTT_Stack::get_topic_slot(uint32_t device, bool create)
+{
+    size_t b = device / SCHC_GW_DEVICE_BLOCK_SIZE;
+    if(b >= SCHC_GW_DEVICE_MAX_BLOCKS)
+        return nullptr;
+
+    std::atomic<char*>* block = _topic_blocks[b].load(std::memory_order_acquire);
+    if(block == nullptr)
+    {
+        if(!create)
+            return nullptr;
+        std::lock_guard<std::mutex> lock(_topics_mutex);
+        block = _topic_blocks[b].load(std::memory_order_acquire);
+        if(block == nullptr)
+        {
+            block = new std::atomic<char*>[SCHC_GW_DEVICE_BLOCK_SIZE]();
+            _topic_blocks[b].store(block, std::memory_order_release);
+        }
     }
-    else
+    return &block[device % SCHC_GW_DEVICE_BLOCK_SIZE];
+}
+
+void SCHC_GW_TTN_MQTT_Stack::free_retired_topics()
+{
+    std::lock_guard<std::mutex> lock(_topics_mutex);
+    for(char* topic : _retired_topics)
+        delete[] topic;
+    _retired_topics.clear();
+    _has_retired_topics.store(false, std::memory_order_relaxed);
+}
+
+void SCHC_GW_TTN_MQTT_Stack::publisher_loop()
+{
+    SPDLOG_INFO("Entering publisher_loop()");
+
+    while(true)
+    {
+        /* Entre dos lotes el publisher no usa ningun topic del cache */
+        if(_has_retired_topics.load(std::memory_order_acquire))
+            free_retired_topics();
+
+        /* Publica hasta batch_size downlinks por vuelta. Al detenerse se vacia el outbox */
+        int n = 0;
+        Downlink* downlink;
+        while(n < _batch_size && (downlink = _outbox.front()) != nullptr)
+        {
+            uint64_t allocs = SCHC_GW_Alloc_Counter::get_thread_allocs();
+            publish(*downlink);
+            _allocs.fetch_add(SCHC_GW_Alloc_Counter::get_thread_allocs() - allocs, std::memory_order_relaxed);
+            _outbox.pop();
+            n++;
+        }
+        if(n > 0)
+        {
+            SPDLOG_DEBUG("Published a batch of {} downlinks", n);
+            continue;
+        }
+        if(!_running.load())
+            break;
+
+        /* Outbox vacio. El publisher duerme hasta que una sesion encole un downlink */
+        _outbox.wait(100, _running);
+    }
+
+    SPDLOG_WARN("\033[1mDownlink publisher finished\033[0m");
+    return;
+}
+
+void SCHC_GW_TTN_MQTT_Stack::publish(Downlink& downlink)
+{
+    /* Topic armado al empezar la sesion del dispositivo */
+    std::atomic<char*>* slot    = get_topic_slot(downlink.device, false);
+    const char* topic           = (slot != nullptr) ? slot->load(std::memory_order_acquire) : nullptr;
+    if(topic == nullptr)
     {
-        SPDLOG_DEBUG("Connection with mqtt broker.... OK");
+        /* Sin topic en el cache: solo cambia el device id, la capacidad de _topic ya fue reservada */
+        _topic_misses.fetch_add(1, std::memory_order_relaxed);
+        _topic.resize(_topic_prefix.size());
+        _topic.append(SCHC_GW_Device_Table::get_device_id(downlink.device));
+        _topic.append(topic_suffix, sizeof(topic_suffix) - 1);
+        topic = _topic.c_str();
     }
 
+    int json_len = format_downlink_json(downlink.rule_id, downlink.payload, downlink.len, _json);
+
+    SPDLOG_DEBUG("Downlink topic: {}", topic);
+    SPDLOG_DEBUG("Downlink JSON: {}", fmt::string_view(_json, json_len));
+
+    if(_dry_run)
+    {
+        /* Sin broker: el downlink recorre todo el camino salvo la entrega a mosquitto */
+        _published.fetch_add(1, std::memory_order_relaxed);
+        _completed.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
 
-    result = mosquitto_publish(_mosq, nullptr, topic.c_str(), strlen(json_c_str), json_c_str, 0, false);
+    int mid     = 0;
+    int result  = mosquitto_publish(_mosq, &mid, topic, json_len, _json, 0, false);
     if (result != MOSQ_ERR_SUCCESS) {
-        SPDLOG_ERROR("The message could not be published. Code: {}" , mosquitto_strerror(result));
-        return 1;
+        /* El loop de mosquitto se encarga de reconectar. La sesion recupera el ACK con un ACK REQ */
+        uint64_t errors = _publish_errors.fetch_add(1, std::memory_order_relaxed) + 1;
+        if((errors & (errors - 1)) == 0)
+            SPDLOG_ERROR("The message could not be published. Code: {}. {} errors so far", mosquitto_strerror(result), errors);
+        return;
     }
-    else
+    _published.fetch_add(1, std::memory_order_relaxed);
+
+    /* on_publish() puede llegar antes de que mosquitto_publish() retorne. Quien llega
+    segundo a la entrada del mid registra la latencia */
+    int64_t   enqueued_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(downlink.enqueued_at.time_since_epoch()).count();
+    In_Flight& in_flight  = _in_flight[mid & _in_flight_mask];
+    in_flight.enqueued_ns.store(enqueued_ns, std::memory_order_relaxed);
+    uint64_t prev = in_flight.tag.exchange((uint64_t(mid) << 1) | 1, std::memory_order_acq_rel);
+    if(prev == (uint64_t(mid) << 1))
+        SCHC_GW_Metrics::record(SCHC_GW_METRIC_DOWNLINK_LATENCY, std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - downlink.enqueued_at).count());
+}
+
+int SCHC_GW_TTN_MQTT_Stack::format_downlink_json(uint8_t f_port, const char* payload, int len, char* out)
+{
+    /* {"downlinks":[{"f_port":<f_port>,"frm_payload":"<base64>","priority":"NORMAL"}]} */
+    char* p = out;
+    memcpy(p, json_prefix, sizeof(json_prefix) - 1);
+    p = p + sizeof(json_prefix) - 1;
+
+    if(f_port >= 100)
+        *p++ = '0' + f_port / 100;
+    if(f_port >= 10)
+        *p++ = '0' + (f_port / 10) % 10;
+    *p++ = '0' + f_port % 10;
+
+    memcpy(p, json_middle, sizeof(json_middle) - 1);
+    p = p + sizeof(json_middle) - 1;
+    p = p + SCHC_GW_Base64::encode(payload, len, p);
+    memcpy(p, json_suffix, sizeof(json_suffix) - 1);
+    p = p + sizeof(json_suffix) - 1;
+
+    return p - out;
+}
+
+void SCHC_GW_TTN_MQTT_Stack::on_publish(struct mosquitto* mosq, void* obj, int mid)
+{
+    if(obj != nullptr)
+        static_cast<SCHC_GW_TTN_MQTT_Stack*>(obj)->complete(mid);
+}
+
+void SCHC_GW_TTN_MQTT_Stack::complete(int mid)
+{
+    _completed.fetch_add(1, std::memory_order_relaxed);
+
+    In_Flight& in_flight = _in_flight[mid & _in_flight_mask];
+    uint64_t   prev      = in_flight.tag.exchange(uint64_t(mid) << 1, std::memory_order_acq_rel);
+    if(prev == ((uint64_t(mid) << 1) | 1))
     {
-        SPDLOG_DEBUG("Message sent successfully");
+        int64_t now_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+        SCHC_GW_Metrics::record(SCHC_GW_METRIC_DOWNLINK_LATENCY, now_ns - in_flight.enqueued_ns.load(std::memory_order_relaxed));
     }
-    return 0;
 }
 
 int SCHC_GW_TTN_MQTT_Stack::getMtu(bool consider_Fopt)
@@ -84,6 +337,11 @@ uint8_t SCHC_GW_TTN_MQTT_Stack::set_mqtt_stack(mosquitto *mosqStack)
     return 0;
 }
 
+void SCHC_GW_TTN_MQTT_Stack::set_dry_run(bool dry_run)
+{
+    _dry_run = dry_run;
+}
+
 void SCHC_GW_TTN_MQTT_Stack::set_application_id(std::string app)
 {
     _application_id = app;
@@ -94,31 +352,66 @@ void SCHC_GW_TTN_MQTT_Stack::set_tenant_id(std::string tenant)
     _tenant_id = tenant;
 }
 
-std::string SCHC_GW_TTN_MQTT_Stack::base64_encode(const char* buffer, int len) {
-    static const std::string base64_chars = 
-        "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
-        "abcdefghijklmnopqrstuvwxyz"
-        "0123456789+/";
+uint64_t SCHC_GW_TTN_MQTT_Stack::get_enqueued()
+{
+    return _enqueued.load(std::memory_order_relaxed);
+}
 
-    std::string encoded;
-    int val = 0, valb = -6;
+uint64_t SCHC_GW_TTN_MQTT_Stack::get_published()
+{
+    return _published.load(std::memory_order_relaxed);
+}
 
-    for (int i = 0; i < len; ++i) {
-        val = (val << 8) + (unsigned char)buffer[i];
-        valb += 8;
-        while (valb >= 0) {
-            encoded.push_back(base64_chars[(val >> valb) & 0x3F]);
-            valb -= 6;
-        }
-    }
+uint64_t SCHC_GW_TTN_MQTT_Stack::get_completed()
+{
+    return _completed.load(std::memory_order_relaxed);
+}
 
-    if (valb > -6) {
-        encoded.push_back(base64_chars[((val << 8) >> (valb + 8)) & 0x3F]);
-    }
+uint64_t SCHC_GW_TTN_MQTT_Stack::get_dropped()
+{
+    return _dropped.load(std::memory_order_relaxed);
+}
 
-    while (encoded.size() % 4) {
-        encoded.push_back('=');
-    }
+uint64_t SCHC_GW_TTN_MQTT_Stack::get_publish_errors()
+{
+    return _publish_errors.load(std::memory_order_relaxed);
+}
 
-    return encoded;
+size_t SCHC_GW_TTN_MQTT_Stack::get_depth()
+{
+    return _outbox.get_size();
+}
+
+uint64_t SCHC_GW_TTN_MQTT_Stack::get_cached_topics()
+{
+    return _cached_topics.load(std::memory_order_relaxed);
+}
+
+uint64_t SCHC_GW_TTN_MQTT_Stack::get_topic_misses()
+{
+    return _topic_misses.load(std::memory_order_relaxed);
+}
+
+double SCHC_GW_TTN_MQTT_Stack::get_allocs_per_downlink()
+{
+    uint64_t published = _published.load(std::memory_order_relaxed) + _publish_errors.load(std::memory_order_relaxed);
+    if(published == 0)
+        return 0;
+    return double(_allocs.load(std::memory_order_relaxed)) / published;
+}
+
+std::string SCHC_GW_TTN_MQTT_Stack::to_string()
+{
+    SCHC_GW_Latency_Histogram downlink_latency;
+    SCHC_GW_Metrics::get_histogram(SCHC_GW_METRIC_DOWNLINK_LATENCY, downlink_latency);
+    return fmt::format("enqueued={} published={} completed={} depth={} dropped={} publish_errors={} topics={} topic_misses={} latency: {}",
+                       get_enqueued(),
+                       get_published(),
+                       get_completed(),
+                       get_depth(),
+                       get_dropped(),
+                       get_publish_errors(),
+                       get_cached_topics(),
+                       get_topic_misses(),
+                       downlink_latency.to_string());
 }
\ No newline at end of file
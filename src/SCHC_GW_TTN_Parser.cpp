@@ -1,62 +1,82 @@
 #include "SCHC_GW_TTN_Parser.hpp"
+#include <cstring>
 
 int SCHC_GW_TTN_Parser::initialize_parser(char *buffer)
 {
     SPDLOG_TRACE("Entering the function");
-    try{
-        // Parsear el char* a un objeto JSON
-        json parsed_json = json::parse(buffer);
+    _fragment.set_rx_time(std::chrono::steady_clock::now());
 
-        // Obtener y almacenar el valor de "device_id"
-        if(parsed_json.contains("end_device_ids") && parsed_json["end_device_ids"].contains("device_id"))
-        {
-            _deviceId = parsed_json["end_device_ids"]["device_id"];
-
-            SPDLOG_TRACE("DeviceID: {}", _deviceId);
-        }
-        else
-        {
-            SPDLOG_ERROR("The mqtt JSON message not include the \"end_device_ids\" key");
-            return -1;        
-        }
+    /* El JSON se recorre una sola vez y sin construir un DOM. Solo se extraen
+    end_device_ids.device_id, uplink_message.f_port y uplink_message.frm_payload;
+    el resto de los valores (rx_metadata, settings, locations, ...) se saltan */
+    const char* p   = buffer;
+    const char* end = buffer + strlen(buffer);
+    p = skip_ws(p, end);
+    if(p >= end || *p != '{' || scan_object(p, end, SCHC_GW_TTN_JSON_ROOT) == nullptr)
+    {
+        SPDLOG_ERROR("JSON error parsing: malformed uplink message");
+        return 1;
+    }
 
-        // Obtener y almacenar el valor de frm_payload decodificado
-        if(parsed_json.contains("uplink_message") && parsed_json["uplink_message"].contains("frm_payload"))
-        {
-            // save and print encoded buffer
-            std::string frm_payload = parsed_json["uplink_message"]["frm_payload"];
-
-            // save and print decoded buffer (text format)
-            base64_decode(frm_payload, _decoded_payload, _len);
-            SPDLOG_TRACE("Decoded Payload (hex format):");
-            SCHC_GW_Message::print_buffer_in_hex(_decoded_payload, _len);
-            
-            SPDLOG_TRACE("Length: {}", _len);
-        }
-        else
+    // Obtener y almacenar el valor de "device_id"
+    if(_json_device_id != nullptr && _json_device_id_escaped)
+    {
+        SPDLOG_ERROR("The \"device_id\" contains escaped characters");
+        return -1;
+    }
+    else if(_json_device_id != nullptr)
+    {
+        // El device id se reemplaza por su handle. El string no se copia si el dispositivo ya es conocido
+        _device = SCHC_GW_Device_Table::intern(_json_device_id, _json_device_id_len);
+        if(_device == SCHC_GW_DEVICE_INVALID)
         {
-            SPDLOG_WARN("The mqtt JSON message not include the \"uplink_message\" and \"frm_payload\" keys");
-            return -1; 
+            SPDLOG_ERROR("The \"device_id\" is empty or longer than {} characters", SCHC_GW_DEVICE_ID_MAX_LEN);
+            return -1;
         }
+        _fragment.set_device(_device);
 
+        SPDLOG_TRACE("DeviceID: {} (handle {})", SCHC_GW_Device_Table::get_device_id(_device), _device);
+    }
+    else
+    {
+        SPDLOG_ERROR("The mqtt JSON message not include the \"end_device_ids\" key");
+        return -1;        
+    }
 
-        // Obtener y almacenar el rule ID
-        if(parsed_json.contains("uplink_message") && parsed_json["uplink_message"].contains("f_port"))
-        {
-            // save and print encoded buffer
-            _rule_id = parsed_json["uplink_message"]["f_port"];
-            SPDLOG_TRACE("Rule ID: {}", _rule_id);
-        }
-        else
+    // Obtener y almacenar el valor de frm_payload decodificado
+    if(_json_frm_payload != nullptr)
+    {
+        // decoded buffer. Se decodifica directamente desde el mensaje MQTT al fragmento (inline si cabe en el MTU de LoRaWAN)
+        int capacity = (_json_frm_payload_len + 3) / 4 * 3;
+        int len;
+        if(SCHC_GW_Base64::decode(_json_frm_payload, _json_frm_payload_len, _fragment.allocate(capacity), capacity, len) != 0)
         {
-            SPDLOG_ERROR("The mqtt JSON message not include the \"uplink_message\" and \"f_port\" keys");
-            return -1; 
+            SPDLOG_ERROR("The frm_payload could not be decoded");
+            release_decoded_payload();
+            return -1;
         }
+        _fragment.set_size(len);
+        SPDLOG_TRACE("Decoded Payload (hex format): {}", SCHC_GW_Hex(_fragment.data(), len));
+        
+        SPDLOG_TRACE("Length: {}", len);
     }
-    catch (const std::exception& e) {
-        // Manejo de errores
-        SPDLOG_ERROR("JSON error parsing: {}", e.what());
-        return 1;
+    else
+    {
+        SPDLOG_WARN("The mqtt JSON message not include the \"uplink_message\" and \"frm_payload\" keys");
+        return -1; 
+    }
+
+    // El rule ID ya fue almacenado por el scanner
+    if(_json_has_f_port)
+    {
+        _fragment.set_rule_id(_rule_id);
+        SPDLOG_TRACE("Rule ID: {}", _rule_id);
+    }
+    else
+    {
+        SPDLOG_ERROR("The mqtt JSON message not include the \"uplink_message\" and \"f_port\" keys");
+        release_decoded_payload();
+        return -1; 
     }
     SPDLOG_TRACE("Leaving the function");
 
@@ -65,17 +85,22 @@ int SCHC_GW_TTN_Parser::initialize_parser(char *buffer)
 
 char* SCHC_GW_TTN_Parser::get_decoded_payload()
 {
-    return _decoded_payload;
+    return _fragment.data();
+}
+
+SCHC_GW_Fragment SCHC_GW_TTN_Parser::take_fragment()
+{
+    return std::move(_fragment);
 }
 
 int SCHC_GW_TTN_Parser::get_payload_len()
 {
-    return _len;
+    return _fragment.size();
 }
 
-std::string SCHC_GW_TTN_Parser::get_device_id()
+uint32_t SCHC_GW_TTN_Parser::get_device()
 {
-    return _deviceId;
+    return _device;
 }
 
 int SCHC_GW_TTN_Parser::get_rule_id()
@@ -83,32 +108,178 @@ int SCHC_GW_TTN_Parser::get_rule_id()
     return _rule_id;
 }
 
-void SCHC_GW_TTN_Parser::delete_decoded_payload()
+void SCHC_GW_TTN_Parser::release_decoded_payload()
 {
-    delete[] _decoded_payload;
+    _fragment.reset();
+}
+
+const char* SCHC_GW_TTN_Parser::scan_object(const char* p, const char* end, uint8_t object)
+{
+    /* p apunta al '{' del objeto. Retorna el puntero al caracter siguiente al '}'
+    o nullptr si el JSON esta mal formado */
+    p = skip_ws(p + 1, end);
+    if(p < end && *p == '}')
+        return p + 1;
+
+    while(p < end)
+    {
+        const char* key;
+        int         key_len;
+        bool        escaped;
+        if(*p != '"')
+            return nullptr;
+        p = scan_string(p, end, key, key_len, escaped);
+        if(p == nullptr)
+            return nullptr;
+        p = skip_ws(p, end);
+        if(p >= end || *p != ':')
+            return nullptr;
+        p = skip_ws(p + 1, end);
+        if(p >= end)
+            return nullptr;
+
+        p = scan_field(object, key, key_len, p, end);
+        if(p == nullptr)
+            return nullptr;
+
+        p = skip_ws(p, end);
+        if(p >= end)
+            return nullptr;
+        if(*p == '}')
+            return p + 1;
+        if(*p != ',')
+            return nullptr;
+        p = skip_ws(p + 1, end);
+    }
+    return nullptr;
 }
 
-uint8_t SCHC_GW_TTN_Parser::base64_decode(std::string encoded, char*& decoded_buffer, int& len)
+const char* SCHC_GW_TTN_Parser::scan_field(uint8_t object, const char* key, int key_len, const char* p, const char* end)
 {
-    static const std::string base64_chars = 
-        "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
-        "abcdefghijklmnopqrstuvwxyz"
-        "0123456789+/";
-    std::string decoded;
-    int val = 0, valb = -8;
-    for (unsigned char c : encoded) {
-        if (base64_chars.find(c) == std::string::npos) break;
-        val = (val << 6) + base64_chars.find(c);
-        valb += 6;
-        if (valb >= 0) {
-            decoded.push_back(char((val >> valb) & 0xFF));
-            valb -= 8;
+    /* Procesa el valor de la llave key (p apunta al inicio del valor). Solo se
+    entra a los objetos y valores que usa el gateway, el resto se salta */
+    auto key_is = [key, key_len](const char* name, int name_len) {
+        return key_len == name_len && memcmp(key, name, name_len) == 0;
+    };
+
+    if(object == SCHC_GW_TTN_JSON_ROOT)
+    {
+        if(*p == '{' && key_is("end_device_ids", 14))
+            return scan_object(p, end, SCHC_GW_TTN_JSON_END_DEVICE_IDS);
+        if(*p == '{' && key_is("uplink_message", 14))
+            return scan_object(p, end, SCHC_GW_TTN_JSON_UPLINK_MESSAGE);
+    }
+    else if(object == SCHC_GW_TTN_JSON_END_DEVICE_IDS)
+    {
+        if(*p == '"' && key_is("device_id", 9))
+            return scan_string(p, end, _json_device_id, _json_device_id_len, _json_device_id_escaped);
+    }
+    else if(object == SCHC_GW_TTN_JSON_UPLINK_MESSAGE)
+    {
+        if(*p == '"' && key_is("frm_payload", 11))
+        {
+            bool escaped;   // el alfabeto base64 no usa caracteres escapados
+            return scan_string(p, end, _json_frm_payload, _json_frm_payload_len, escaped);
+        }
+        if(*p >= '0' && *p <= '9' && key_is("f_port", 6))
+        {
+            int value = 0;
+            while(p < end && *p >= '0' && *p <= '9' && value < 100000)
+            {
+                value = value*10 + (*p - '0');
+                p++;
+            }
+            _rule_id            = value;
+            _json_has_f_port    = true;
+            if(p < end && (*p == '.' || *p == 'e' || *p == 'E'))
+                return skip_value(p, end);  // resto del numero
+            return p;
         }
     }
-    len = decoded.size();
-    // Esta memoria debe liberarse cuando ya no se use mas el mensaje
-    char* buffer = new char[len];       // * Liberada en SCHC_GW_Message::decode_message(), linea 122
-    std::strcpy(buffer, decoded.c_str());
-    decoded_buffer = buffer;   
-    return 0;
+    return skip_value(p, end);
+}
+
+const char* SCHC_GW_TTN_Parser::scan_string(const char* p, const char* end, const char*& str, int& str_len, bool& escaped)
+{
+    /* p apunta a la comilla inicial. str apunta al contenido sin comillas (sin
+    procesar los escapes) y escaped indica si el string contiene escapes */
+    const char* q = p + 1;
+    while(q < end)
+    {
+        // memchr busca la siguiente comilla de a varios bytes a la vez
+        const char* quote = static_cast<const char*>(memchr(q, '"', end - q));
+        if(quote == nullptr)
+            return nullptr;
+
+        // la comilla esta escapada si la precede un numero impar de '\'
+        const char* b = quote;
+        while(b > p + 1 && *(b - 1) == '\\')
+            b--;
+        if(((quote - b) & 1) == 0)
+        {
+            str     = p + 1;
+            str_len = quote - (p + 1);
+            escaped = memchr(str, '\\', str_len) != nullptr;
+            return quote + 1;
+        }
+        q = quote + 1;
+    }
+    return nullptr;
+}
+
+const char* SCHC_GW_TTN_Parser::skip_value(const char* p, const char* end)
+{
+    /* Salta un valor completo: string, objeto, arreglo, numero o literal */
+    if(p >= end)
+        return nullptr;
+
+    if(*p == '"')
+    {
+        const char* str;
+        int         str_len;
+        bool        escaped;
+        return scan_string(p, end, str, str_len, escaped);
+    }
+
+    if(*p == '{' || *p == '[')
+    {
+        int depth = 0;
+        while(p < end)
+        {
+            char c = *p;
+            if(c == '"')
+            {
+                const char* str;
+                int         str_len;
+                bool        escaped;
+                p = scan_string(p, end, str, str_len, escaped);
+                if(p == nullptr)
+                    return nullptr;
+                continue;
+            }
+            if(c == '{' || c == '[')
+                depth++;
+            else if(c == '}' || c == ']')
+            {
+                depth--;
+                if(depth == 0)
+                    return p + 1;
+            }
+            p++;
+        }
+        return nullptr;
+    }
+
+    // numero o literal (true, false, null)
+    const char* start = p;
+    while(p < end && *p != ',' && *p != '}' && *p != ']' && *p != ' ' && *p != '\t' && *p != '\r' && *p != '\n')
+        p++;
+    return (p == start) ? nullptr : p;
+}
+
+const char* SCHC_GW_TTN_Parser::skip_ws(const char* p, const char* end)
+{
+    while(p < end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n'))
+        p++;
+    return p;
 }
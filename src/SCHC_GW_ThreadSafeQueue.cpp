@@ -1,34 +1,84 @@
 #include "SCHC_GW_ThreadSafeQueue.hpp"
+#include <thread>
 
-void SCHC_GW_ThreadSafeQueue::push(uint8_t rule_id, char* mesg, int len) {
-    std::lock_guard<std::mutex> lock(_mutex);
-    _queue.push({rule_id, mesg, len});
+SCHC_GW_ThreadSafeQueue::SCHC_GW_ThreadSafeQueue(size_t size)
+{
+    _ring.initialize(size);
 }
 
-bool SCHC_GW_ThreadSafeQueue::pop(uint8_t& rule_id, char*& mesg, int& len) {
-    std::lock_guard<std::mutex> lock(_mutex);
-    if(_queue.empty())
+bool SCHC_GW_ThreadSafeQueue::push(machine_ptr machine, SCHC_GW_Fragment&& frag) {
+    if(try_push(machine, frag))
+        return true;
+
+    /* Cola llena: el productor espera a que el worker libere una entrada, como el ingreso con block_when_full */
+    while(_open.load(std::memory_order_relaxed))
     {
+        std::this_thread::sleep_for(std::chrono::microseconds(50));
+        if(try_push(machine, frag))
+            return true;
+    }
+    return false;
+}
+
+bool SCHC_GW_ThreadSafeQueue::try_push(machine_ptr& machine, SCHC_GW_Fragment& frag) {
+    return _ring.try_push([&](entry_t& entry)
+    {
+        std::get<0>(entry) = std::move(machine);
+        std::get<1>(entry) = std::move(frag);
+        std::get<2>(entry) = std::chrono::steady_clock::now();
+    });
+}
+
+bool SCHC_GW_ThreadSafeQueue::pop(machine_ptr& machine, SCHC_GW_Fragment& frag) {
+    entry_t* entry = _ring.front();
+    if(entry == nullptr)
         return false;
+
+    machine = std::move(std::get<0>(*entry));
+    frag    = std::move(std::get<1>(*entry));
+    _ring.pop();
+    return true;
+}
+
+size_t SCHC_GW_ThreadSafeQueue::try_pop_batch(batch_t& batch, size_t max_entries) {
+    /* Las entradas se mueven: la celda del ring no retiene la maquina de estado ni el payload */
+    size_t n = 0;
+    entry_t* entry;
+    while(n < max_entries && (entry = _ring.front()) != nullptr)
+    {
+        batch.push_back(std::move(*entry));
+        _ring.pop();
+        n++;
     }
-    else
+    return n;
+}
+
+bool SCHC_GW_ThreadSafeQueue::wait_and_pop_all(batch_t& batch) {
+    while(true)
     {
-        auto tuple = _queue.front();
-        rule_id = std::get<0>(tuple);
-        mesg = std::get<1>(tuple);
-        len = std::get<2>(tuple);
-        _queue.pop();
-        return true;
+        if(try_pop_batch(batch, _ring.get_capacity()) > 0)
+            return true;
+        if(!_open.load())
+            return false;
+        _ring.wait(100, _open);
     }
 }
 
+void SCHC_GW_ThreadSafeQueue::close() {
+    _open.store(false);
+    _ring.notify_all();
+}
+
 bool SCHC_GW_ThreadSafeQueue::empty() {
-    std::lock_guard<std::mutex> lock(_mutex);
-    return _queue.empty();
+    return _ring.get_size() == 0;
 }
 
 size_t SCHC_GW_ThreadSafeQueue::size()
 {
-    std::lock_guard<std::mutex> lock(_mutex);
-    return _queue.size();
+    return _ring.get_size();
+}
+
+size_t SCHC_GW_ThreadSafeQueue::get_capacity()
+{
+    return _ring.get_capacity();
 }
@@ -0,0 +1,116 @@
+#include "SCHC_GW_Timer_Wheel.hpp"
+
+SCHC_GW_Timer_Wheel::~SCHC_GW_Timer_Wheel()
+{
+    stop();
+}
+
+uint8_t SCHC_GW_Timer_Wheel::initialize(int tick_ms, int n_slots)
+{
+    SPDLOG_TRACE("Entering the function");
+
+    if(tick_ms < 1)
+        tick_ms = 1;
+    if(n_slots < 1)
+        n_slots = 1;
+
+    _tick_ms    = tick_ms;
+    _cursor     = 0;
+    _pending    = 0;
+    _slots.resize(n_slots);
+    _running    = true;
+    _thread     = std::thread(&SCHC_GW_Timer_Wheel::run, this);
+    SPDLOG_DEBUG("Timer wheel successfully created. tick: {} ms, slots: {}", tick_ms, n_slots);
+
+    SPDLOG_TRACE("Leaving the function");
+    return 0;
+}
+
+void SCHC_GW_Timer_Wheel::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if(!_running)
+            return;
+        _running = false;
+    }
+    _cond.notify_all();
+    if(_thread.joinable())
+        _thread.join();
+}
+
+void SCHC_GW_Timer_Wheel::schedule(int delay_ms, callback_t callback)
+{
+    /* Se redondea hacia arriba para que el timer nunca venza antes del retardo pedido */
+    int ticks = (delay_ms + _tick_ms - 1) / _tick_ms;
+    if(ticks < 1)
+        ticks = 1;
+
+    int n_slots = _slots.size();
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    if(!_running)
+    {
+        SPDLOG_ERROR("The timer wheel is stopped. Discarding timer");
+        return;
+    }
+    int slot = (_cursor + ticks) % n_slots;
+    _slots[slot].push_back({(ticks - 1) / n_slots, std::move(callback)});
+    _pending++;
+}
+
+size_t SCHC_GW_Timer_Wheel::get_pending()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _pending;
+}
+
+void SCHC_GW_Timer_Wheel::run()
+{
+    SPDLOG_INFO("Entering run() of the timer wheel");
+
+    std::vector<callback_t>                 expired;
+    std::chrono::steady_clock::time_point   next_tick = std::chrono::steady_clock::now();
+
+    std::unique_lock<std::mutex> lock(_mutex);
+    while(_running)
+    {
+        next_tick += std::chrono::milliseconds(_tick_ms);
+        if(_cond.wait_until(lock, next_tick, [this]{ return !_running; }))
+            break;
+
+        /* Avanza la rueda y extrae los timers vencidos de la posicion actual */
+        _cursor = (_cursor + 1) % _slots.size();
+        std::vector<Timer>& slot = _slots[_cursor];
+        for(size_t i=0; i<slot.size(); )
+        {
+            if(slot[i].rounds == 0)
+            {
+                expired.push_back(std::move(slot[i].callback));
+                if(i != slot.size() - 1)
+                    slot[i] = std::move(slot.back());
+                slot.pop_back();
+                _pending--;
+            }
+            else
+            {
+                slot[i].rounds--;
+                i++;
+            }
+        }
+
+        if(expired.empty())
+            continue;
+
+        lock.unlock();
+        for(auto& callback : expired)
+        {
+            callback();
+        }
+        expired.clear();
+        lock.lock();
+    }
+
+    SPDLOG_WARN("\033[1mTimer wheel finished\033[0m");
+    return;
+}
@@ -0,0 +1,202 @@
+#include "SCHC_GW_Trace.hpp"
+#include "SCHC_GW_Log_Format.hpp"
+#include "SCHC_GW_Metrics.hpp"
+#include <chrono>
+#include <cstring>
+#include <fmt/format.h>
+#include <spdlog/details/os.h>
+
+static SCHC_GW_MPSC_Ring<SCHC_GW_Trace_Event>   trace_ring;
+static std::shared_ptr<spdlog::logger>          trace_logger;
+static std::thread                              trace_thread;
+static std::atomic<bool>                        trace_running{false};
+static std::atomic<uint64_t>                    trace_recorded{0};
+static std::atomic<uint64_t>                    trace_dropped{0};
+
+uint8_t SCHC_GW_Trace::initialize(size_t ring_size, bool enabled)
+{
+    SPDLOG_TRACE("Entering the function");
+
+    if(trace_running.load())
+        return 0;
+
+    /* El hilo y la hora se escriben desde el evento, no desde el hilo de traza */
+    trace_logger = spdlog::get("schc_trace");
+    if(trace_logger == nullptr)
+        trace_logger = spdlog::stdout_color_mt("schc_trace");
+    trace_logger->set_pattern("[%H:%M:%S.%e][%^%L%$]%v");
+
+    trace_ring.initialize(ring_size);
+    trace_running.store(true);
+    trace_thread = std::thread(&SCHC_GW_Trace::trace_loop);
+
+    SCHC_GW_Metrics::add_callback(&trace_ring, SCHC_GW_METRIC_COUNTER, "schc_gw_trace_events_total", "result=\"recorded\"", "SCHC trace events", []() { return double(get_recorded()); });
+    SCHC_GW_Metrics::add_callback(&trace_ring, SCHC_GW_METRIC_COUNTER, "schc_gw_trace_events_total", "result=\"dropped\"", "", []() { return double(get_dropped()); });
+
+    /* Los eventos se escriben con nivel WARN. Si el logger no los va a mostrar no se registran */
+    set_enabled(enabled);
+    SPDLOG_DEBUG("SCHC trace successfully created with a ring of {} events. Enabled: {}", trace_ring.get_capacity(), is_enabled());
+
+    SPDLOG_TRACE("Leaving the function");
+    return 0;
+}
+
+void SCHC_GW_Trace::stop()
+{
+    if(!trace_running.exchange(false))
+        return;
+
+    SCHC_GW_Metrics::remove_callbacks(&trace_ring);
+    _enabled.store(false);
+    trace_ring.notify_all();
+    if(trace_thread.joinable())
+        trace_thread.join();
+    SPDLOG_WARN("SCHC trace stopped: recorded={} dropped={}", get_recorded(), get_dropped());
+}
+
+void SCHC_GW_Trace::set_enabled(bool enabled)
+{
+    _enabled.store(enabled && trace_running.load() && trace_logger->should_log(spdlog::level::warn));
+}
+
+void SCHC_GW_Trace::fragment(uint8_t w, uint8_t fcn, int tiles)
+{
+    SCHC_GW_Trace_Event event = {};
+    event.type  = SCHC_GW_TRACE_FRAGMENT;
+    event.w     = w;
+    event.fcn   = fcn;
+    event.value = tiles;
+    record(event);
+}
+
+void SCHC_GW_Trace::all1(uint8_t w, uint8_t fcn, int bits, bool rcs_ok)
+{
+    SCHC_GW_Trace_Event event = {};
+    event.type  = SCHC_GW_TRACE_ALL1;
+    event.w     = w;
+    event.fcn   = fcn;
+    event.value = bits;
+    event.flag  = rcs_ok;
+    record(event);
+}
+
+void SCHC_GW_Trace::ack_req(uint8_t w, bool discarded)
+{
+    SCHC_GW_Trace_Event event = {};
+    event.type  = SCHC_GW_TRACE_ACK_REQ;
+    event.w     = w;
+    event.flag  = discarded;
+    record(event);
+}
+
+void SCHC_GW_Trace::ack(uint8_t w, uint8_t c, uint64_t bitmap, uint8_t win_size)
+{
+    SCHC_GW_Trace_Event event = {};
+    event.type          = SCHC_GW_TRACE_ACK;
+    event.w             = w;
+    event.c             = c;
+    event.win_size      = win_size;
+    event.bitmaps[0]    = bitmap;
+    record(event);
+}
+
+void SCHC_GW_Trace::compound_ack(uint8_t c, uint8_t win_mask, const uint64_t* bitmaps, uint8_t win_size)
+{
+    SCHC_GW_Trace_Event event = {};
+    event.type      = SCHC_GW_TRACE_COMPOUND_ACK;
+    event.c         = c;
+    event.win_size  = win_size;
+    event.win_mask  = win_mask;
+
+    /* Solo se copian los bitmaps de las ventanas incluidas en el ACK */
+    uint8_t pending = win_mask;
+    while(pending != 0)
+    {
+        uint8_t w           = __builtin_ctz(pending);
+        pending             = pending & (pending - 1);
+        event.bitmaps[w]    = bitmaps[w];
+    }
+    record(event);
+}
+
+void SCHC_GW_Trace::record(SCHC_GW_Trace_Event& event)
+{
+    event.time_ns   = std::chrono::duration_cast<std::chrono::nanoseconds>(spdlog::log_clock::now().time_since_epoch()).count();
+    event.thread_id = static_cast<uint32_t>(spdlog::details::os::thread_id());
+
+    bool pushed = trace_ring.try_push([&](SCHC_GW_Trace_Event& slot)
+    {
+        memcpy(&slot, &event, sizeof(event));
+    });
+    if(!pushed)
+    {
+        /* Nunca se bloquea a la sesion. El evento se pierde */
+        trace_dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    trace_recorded.fetch_add(1, std::memory_order_relaxed);
+}
+
+void SCHC_GW_Trace::trace_loop()
+{
+    SPDLOG_INFO("Entering trace_loop()");
+
+    while(true)
+    {
+        SCHC_GW_Trace_Event* event = trace_ring.front();
+        if(event != nullptr)
+        {
+            write(*event);
+            trace_ring.pop();
+            continue;
+        }
+        if(!trace_running.load())
+            break;      // ring vacio y stop() pedido
+
+        trace_ring.wait(100, trace_running);
+    }
+    trace_logger->flush();
+
+    SPDLOG_WARN("\033[1mSCHC trace finished\033[0m");
+    return;
+}
+
+void SCHC_GW_Trace::write(const SCHC_GW_Trace_Event& event)
+{
+    fmt::memory_buffer out;
+    fmt::format_to(std::back_inserter(out), "[{}] ", event.thread_id);
+
+    switch(event.type)
+    {
+        case SCHC_GW_TRACE_FRAGMENT:
+            fmt::format_to(std::back_inserter(out), "|--- W={:<1}, FCN={:<2} --->| {:>2} tiles", event.w, event.fcn, event.value);
+            break;
+        case SCHC_GW_TRACE_ALL1:
+            fmt::format_to(std::back_inserter(out), "|- W={:<1}, FCN={:<2}+RCS ->| {:>2} bits - Integrity check: {}", event.w, event.fcn, event.value, event.flag ? "success" : "failure");
+            break;
+        case SCHC_GW_TRACE_ACK_REQ:
+            fmt::format_to(std::back_inserter(out), "|--- ACK REQ, W={:<1} -->|{}", event.w, event.flag ? " pull ACK REQ discarded" : "");
+            break;
+        case SCHC_GW_TRACE_ACK:
+            fmt::format_to(std::back_inserter(out), "|<-- ACK, W={:<1}, C={:<1} --| Bitmap:{}", event.w, event.c, SCHC_GW_Bitmap(event.bitmaps[0], event.win_size));
+            break;
+        case SCHC_GW_TRACE_COMPOUND_ACK:
+            fmt::format_to(std::back_inserter(out), "|<-- ACK, C={} -------| {}", event.c, SCHC_GW_Compound_Bitmap(event.win_mask, event.bitmaps, event.win_size));
+            break;
+        default:
+            return;
+    }
+
+    spdlog::log_clock::time_point time(std::chrono::duration_cast<spdlog::log_clock::duration>(std::chrono::nanoseconds(event.time_ns)));
+    trace_logger->log(time, spdlog::source_loc{}, spdlog::level::warn, spdlog::string_view_t(out.data(), out.size()));
+}
+
+uint64_t SCHC_GW_Trace::get_recorded()
+{
+    return trace_recorded.load(std::memory_order_relaxed);
+}
+
+uint64_t SCHC_GW_Trace::get_dropped()
+{
+    return trace_dropped.load(std::memory_order_relaxed);
+}
\ No newline at end of file
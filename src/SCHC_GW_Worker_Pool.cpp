@@ -0,0 +1,139 @@
+#include "SCHC_GW_Worker_Pool.hpp"
+
+SCHC_GW_Worker_Pool::~SCHC_GW_Worker_Pool()
+{
+    stop();
+}
+
+uint8_t SCHC_GW_Worker_Pool::initialize(int n_workers)
+{
+    SPDLOG_TRACE("Entering the function");
+
+    if(n_workers < 1)
+        n_workers = 1;
+
+    _running.store(true);
+    for(int i=0; i<n_workers; i++)
+    {
+        _queues.push_back(std::make_unique<SCHC_GW_ThreadSafeQueue>());
+    }
+    for(int i=0; i<n_workers; i++)
+    {
+        _threads.emplace_back(&SCHC_GW_Worker_Pool::worker_loop, this, i);
+    }
+    for(int i=0; i<n_workers; i++)
+    {
+        SCHC_GW_ThreadSafeQueue* queue = _queues[i].get();
+        SCHC_GW_Metrics::add_callback(this, SCHC_GW_METRIC_GAUGE, "schc_gw_worker_queue_depth", fmt::format("worker=\"{}\"", i),
+                                      "Messages waiting in the run queue of each worker", [queue]() { return double(queue->size()); });
+    }
+    SCHC_GW_Metrics::add_callback(this, SCHC_GW_METRIC_COUNTER, "schc_gw_worker_executed_total", "",
+                                  "Messages executed by the workers", [this]() { return double(_executed.load(std::memory_order_relaxed)); });
+    SPDLOG_DEBUG("Worker pool successfully created with {} workers", n_workers);
+
+    SPDLOG_TRACE("Leaving the function");
+    return 0;
+}
+
+void SCHC_GW_Worker_Pool::stop()
+{
+    if(!_running.exchange(false))
+        return;
+
+    SCHC_GW_Metrics::remove_callbacks(this);
+    for(auto& queue : _queues)
+    {
+        queue->close();
+    }
+    for(auto& thread : _threads)
+    {
+        if(thread.joinable())
+            thread.join();
+    }
+    _threads.clear();
+}
+
+int SCHC_GW_Worker_Pool::get_worker_id(uint32_t device)
+{
+    /* Los handles son consecutivos: los dispositivos se reparten por turnos entre los workers */
+    return device % _queues.size();
+}
+
+void SCHC_GW_Worker_Pool::post(int worker_id, std::shared_ptr<SCHC_GW_State_Machine> machine, SCHC_GW_Fragment&& frag)
+{
+    _posted.fetch_add(1, std::memory_order_relaxed);
+    _queues[worker_id]->push(std::move(machine), std::move(frag));
+}
+
+int SCHC_GW_Worker_Pool::get_n_workers()
+{
+    return _queues.size();
+}
+
+bool SCHC_GW_Worker_Pool::is_idle()
+{
+    /* _finished se lee primero: un mensaje contado en _finished ya fue contado en _posted */
+    uint64_t finished = _finished.load(std::memory_order_acquire);
+    return finished == _posted.load(std::memory_order_acquire);
+}
+
+double SCHC_GW_Worker_Pool::get_allocs_per_message()
+{
+    uint64_t executed = _executed.load(std::memory_order_relaxed);
+    if(executed == 0)
+        return 0;
+    return double(_allocs.load(std::memory_order_relaxed)) / executed;
+}
+
+void SCHC_GW_Worker_Pool::worker_loop(int worker_id)
+{
+    SPDLOG_INFO("Entering worker_loop() of worker {}", worker_id);
+
+    SCHC_GW_ThreadSafeQueue&            queue = *_queues[worker_id];
+    SCHC_GW_ThreadSafeQueue::batch_t    batch;
+    batch.reserve(queue.get_capacity());        // el batch se reutiliza: extraer mensajes no usa el heap
+
+    while(_running.load())
+    {
+        /* El hilo duerme hasta que llega un mensaje y luego procesa todos los mensajes encolados */
+        batch.clear();
+        if(!queue.wait_and_pop_all(batch))
+            continue;
+        SPDLOG_DEBUG("\033[32mExtracting {} messages from the queue of worker {}.\033[0m", batch.size(), worker_id);
+
+        for(auto& entry : batch)
+        {
+            auto machine            = std::move(std::get<0>(entry));    // mantiene viva la maquina aunque la sesion la destruya
+            SCHC_GW_Fragment& frag  = std::get<1>(entry);               // el batch se limpia en la siguiente vuelta
+            SCHC_GW_Metrics::record(SCHC_GW_METRIC_QUEUE_LATENCY, std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - std::get<2>(entry)).count());
+
+            if(!machine->is_processing())
+            {
+                /* Mensajes que llegaron despues del fin de la sesion */
+                SPDLOG_DEBUG("The state machine has finished. Discarding message");
+                _finished.fetch_add(1, std::memory_order_release);
+                continue;
+            }
+
+            SPDLOG_DEBUG(">>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>");
+            uint64_t allocs = SCHC_GW_Alloc_Counter::get_thread_allocs();
+            machine->execute_machine(frag.get_rule_id(), frag.data(), frag.size());
+            _allocs.fetch_add(SCHC_GW_Alloc_Counter::get_thread_allocs() - allocs, std::memory_order_relaxed);
+            _executed.fetch_add(1, std::memory_order_relaxed);
+            frag.reset();   // la maquina de estado ya copio los tiles
+            _finished.fetch_add(1, std::memory_order_release);
+
+            if(!machine->is_processing() && spdlog::should_log(spdlog::level::debug))
+            {
+                SCHC_GW_Latency_Histogram queue_latency;    // suma de los bloques de todos los hilos
+                SCHC_GW_Metrics::get_histogram(SCHC_GW_METRIC_QUEUE_LATENCY, queue_latency);
+                SPDLOG_DEBUG("Enqueue-to-execute latency: {}", queue_latency.to_string());
+                if(SCHC_GW_Alloc_Counter::is_enabled())
+                    SPDLOG_DEBUG("Heap allocations per message in execute_machine(): {:.2f}", get_allocs_per_message());
+            }
+        }
+    }
+
+    SPDLOG_WARN("\033[1mWorker {} finished\033[0m", worker_id);
+    return;
+}
@@ -2,25 +2,40 @@
 #include <iostream>
 #include <cstring>
 
+#ifndef SPDLOG_ACTIVE_LEVEL
 #define SPDLOG_ACTIVE_LEVEL SPDLOG_LEVEL_TRACE
+#endif
 #include <spdlog/spdlog.h>
 #include <spdlog/sinks/stdout_color_sinks.h>
 
 #include <string>
+#include <fstream>
+#include <chrono>
+#include <thread>
 #include "SimpleIni.h"
 #include "SCHC_GW_Fragmenter.hpp"
+#include "SCHC_GW_Ingress.hpp"
+#include "SCHC_GW_Trace.hpp"
+#include "SCHC_GW_Metrics.hpp"
 
 //Global variables
 const char* topic_1_char;
 const char *host;
 SCHC_GW_Fragmenter frag;
+SCHC_GW_Ingress ingress;       // declarado despues de frag: sus decoders se detienen antes de destruir frag
 
 // Callbacks declaration
 void on_connect(struct mosquitto *mosq, void *obj, int rc);
 void on_message(struct mosquitto *mosq, void *obj, const struct mosquitto_message *msg);
+uint64_t replay_traffic(const char* path);
 
 
-int main() {
+int main(int argc, char** argv) {
+    // Modo replay: ./schc_gateway --replay <archivo>. Inyecta un trafico de uplinks grabado sin conectarse al broker
+    const char* replay_path = nullptr;
+    if(argc >= 3 && strcmp(argv[1], "--replay") == 0)
+        replay_path = argv[2];
+
     CSimpleIniA ini;
     ini.SetUnicode();
     ini.LoadFile("config.ini");
@@ -76,6 +91,16 @@ int main() {
         spdlog::set_level(spdlog::level::err);
         SPDLOG_CRITICAL("Using SPDLOG parameter - log level: OFF");
     }
+    if(spdlog::get_level() < SPDLOG_ACTIVE_LEVEL)
+        SPDLOG_CRITICAL("Log level {} is below the compiled log level {}. Those logs are not available in this build", spdlog::level::to_string_view(spdlog::get_level()), spdlog::level::to_string_view(static_cast<spdlog::level::level_enum>(SPDLOG_ACTIVE_LEVEL)));
+
+    // Traza de los mensajes SCHC. Se formatea en su propio hilo
+    const char* schc_trace_char     = ini.GetValue("logging", "schc_trace", "1");
+    const bool schc_trace           = std::stoi(schc_trace_char) != 0;
+    const char* trace_size_char     = ini.GetValue("logging", "trace_ring_size", "4096");
+    const int trace_ring_size       = std::stoi(trace_size_char);
+    SCHC_GW_Trace::initialize(trace_ring_size, schc_trace);
+    SPDLOG_CRITICAL("Using SPDLOG parameter - schc_trace: {}, trace_ring_size: {}", SCHC_GW_Trace::is_enabled(), trace_ring_size);
     
     // MQTT parameters
     host                    = ini.GetValue("mqtt", "host", "Desconocido");
@@ -105,10 +130,66 @@ int main() {
 
 
 
-    const char* error_prob_char = ini.GetValue("schc", "error_prob", "Desconocido");
+    const char* error_prob_char = ini.GetValue("schc", "error_prob", "0");
     const uint8_t error_prob    = std::stoi(error_prob_char);
     SPDLOG_CRITICAL("Using SCHC parameter - error_prob: {}", error_prob);
 
+    const char* loss_pattern_char   = ini.GetValue("schc", "loss_pattern", "none");
+    SCHC_GW_Loss_Pattern loss_pattern;
+    if(SCHC_GW_Loss_Pattern::parse(loss_pattern_char, loss_pattern) != 0)
+    {
+        SPDLOG_ERROR("Invalid loss_pattern: {}", loss_pattern_char);
+        return 1;
+    }
+    if(!loss_pattern.is_enabled() && error_prob > 0)
+        SCHC_GW_Loss_Pattern::parse("random:" + std::to_string(error_prob), loss_pattern);   // error_prob equivale a random:<error_prob>
+    SPDLOG_CRITICAL("Using SCHC parameter - loss_pattern: {}", loss_pattern.to_string());
+
+    const char* n_workers_char  = ini.GetValue("schc", "n_workers", "4");
+    const int n_workers         = std::stoi(n_workers_char);
+    SPDLOG_CRITICAL("Using SCHC parameter - n_workers: {}", n_workers);
+
+    const char* max_sessions_char   = ini.GetValue("schc", "max_sessions", "10000");
+    const int max_sessions          = std::stoi(max_sessions_char);
+    SPDLOG_CRITICAL("Using SCHC parameter - max_sessions: {}", max_sessions);
+
+    const char* mem_budget_char     = ini.GetValue("schc", "session_mem_budget_mb", "0");
+    const size_t session_mem_budget = std::stoul(mem_budget_char)*1024*1024;
+    SPDLOG_CRITICAL("Using SCHC parameter - session_mem_budget_mb: {}", mem_budget_char);
+
+    const char* grace_period_char   = ini.GetValue("schc", "session_grace_period_ms", "10000");
+    const int grace_period_ms       = std::stoi(grace_period_char);
+    SPDLOG_CRITICAL("Using SCHC parameter - session_grace_period_ms: {}", grace_period_ms);
+
+    // Ingress parameters
+    const char* n_decoders_char     = ini.GetValue("ingress", "n_decoders", "2");
+    const int n_decoders            = std::stoi(n_decoders_char);
+    SPDLOG_CRITICAL("Using ingress parameter - n_decoders: {}", n_decoders);
+
+    const char* ring_size_char      = ini.GetValue("ingress", "ring_size", "1024");
+    const int ring_size             = std::stoi(ring_size_char);
+    SPDLOG_CRITICAL("Using ingress parameter - ring_size: {}", ring_size);
+
+    const char* slot_size_char      = ini.GetValue("ingress", "slot_size", "4096");
+    const int slot_size             = std::stoi(slot_size_char);
+    SPDLOG_CRITICAL("Using ingress parameter - slot_size: {}", slot_size);
+
+    const char* block_char          = ini.GetValue("ingress", "block_when_full", "0");
+    const bool block_when_full      = std::stoi(block_char) != 0 || replay_path != nullptr;   // el replay no descarta mensajes
+    SPDLOG_CRITICAL("Using ingress parameter - block_when_full: {}", block_when_full);
+
+    // Metrics parameters
+    const char* metrics_port_char   = ini.GetValue("metrics", "port", "9464");
+    const int metrics_port          = std::stoi(metrics_port_char);
+    SPDLOG_CRITICAL("Using metrics parameter - port: {}", metrics_port);
+
+    const char* metrics_bind_char   = ini.GetValue("metrics", "bind_address", "127.0.0.1");
+    SPDLOG_CRITICAL("Using metrics parameter - bind_address: {}", metrics_bind_char);
+
+    // El endpoint de metricas no es necesario para procesar mensajes: si no se puede abrir se continua sin el
+    if(metrics_port > 0)
+        SCHC_GW_Metrics::start_server(metrics_bind_char, metrics_port);
+
     mosquitto_lib_init();
 
     // Crear una instancia del cliente MQTT
@@ -126,6 +207,38 @@ int main() {
         return 1;
     }
 
+    // El publisher de downlinks publica desde su propio hilo mientras este hilo atiende la red
+    mosquitto_threaded_set(mosq, true);
+
+    if(replay_path != nullptr)
+    {
+        // Sin broker: los ACKs pasan por todo el camino de downlink salvo mosquitto_publish(), que
+        // fallaria con MOSQ_ERR_NO_CONN y haria que PGO entrene con el camino de error.
+        // Como el stack que crea initialize(), vive hasta el final del proceso
+        SCHC_GW_TTN_MQTT_Stack* replay_stack = new SCHC_GW_TTN_MQTT_Stack();
+        replay_stack->set_mqtt_stack(mosq);
+        replay_stack->set_dry_run(true);
+        frag.set_stack(replay_stack);
+        frag.initialize(SCHC_FRAG_LORAWAN, ack_mode, loss_pattern, n_workers, max_sessions, session_mem_budget, grace_period_ms);
+        ingress.initialize(&frag, n_decoders, ring_size, slot_size, block_when_full);
+
+        auto start          = std::chrono::steady_clock::now();
+        uint64_t messages   = replay_traffic(replay_path);
+        // Espera a que los decoders y luego los workers terminen todos los mensajes encolados
+        while(ingress.get_decoded() < ingress.get_received() || !frag.is_idle())
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        double seconds      = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        SPDLOG_CRITICAL("Replay of {} finished: {} messages decoded in {:.3f} s. {}", replay_path, messages, seconds, ingress.to_string());
+        SCHC_GW_Metrics::stop_server();
+        ingress.stop();
+        frag.stop();
+        SCHC_GW_Trace::stop();
+        mosquitto_destroy(mosq);
+        mosquitto_lib_cleanup();
+        return 0;
+    }
+
     // Configurar los callbacks
     mosquitto_connect_callback_set(mosq, on_connect);
     mosquitto_message_callback_set(mosq, on_message);
@@ -140,12 +253,19 @@ int main() {
 
     // Initialize a SCHC_GW_Fragmenter to process the uplink and downlink messages
     frag.set_mqtt_stack(mosq);
-    frag.initialize(SCHC_FRAG_LORAWAN, ack_mode, error_prob);
+    frag.initialize(SCHC_FRAG_LORAWAN, ack_mode, loss_pattern, n_workers, max_sessions, session_mem_budget, grace_period_ms);
+
+    // Los mensajes MQTT se parsean y despachan en los decoders, fuera del hilo de mosquitto
+    ingress.initialize(&frag, n_decoders, ring_size, slot_size, block_when_full);
     
     // Iniciar el bucle de la biblioteca para manejar mensajes
     mosquitto_loop_forever(mosq, 30000, 1);
 
     SPDLOG_CRITICAL("Disconnection of the mqtt broker");
+    SCHC_GW_Metrics::stop_server();
+    ingress.stop();
+    frag.stop();
+    SCHC_GW_Trace::stop();
     mosquitto_loop_stop(mosq, true);
     mosquitto_destroy(mosq);
     mosquitto_lib_cleanup();
@@ -169,8 +289,39 @@ void on_message(struct mosquitto *mosq, void *obj, const struct mosquitto_messag
 
     if (msg->payloadlen > 0)
     {
-        frag.listen_messages(static_cast<char*>(msg->payload));
+        // Solo se copia el mensaje al ring del decoder. El parseo se hace fuera de este hilo
+        ingress.push(msg->topic, static_cast<const char*>(msg->payload), msg->payloadlen);
     }
     return;
 }
 
+/* Cada linea del archivo es un mensaje MQTT de uplink: "<topic> <payload JSON>". Las lineas
+vacias y las que empiezan con '#' se ignoran. Retorna el numero de mensajes inyectados */
+uint64_t replay_traffic(const char* path)
+{
+    std::ifstream file(path);
+    if(!file.is_open())
+    {
+        SPDLOG_ERROR("Could not open the replay file {}", path);
+        return 0;
+    }
+
+    uint64_t messages = 0;
+    std::string line;
+    while(std::getline(file, line))
+    {
+        if(!line.empty() && line.back() == '\r')
+            line.pop_back();
+        if(line.empty() || line[0] == '#')
+            continue;
+        size_t separator = line.find(' ');
+        if(separator == std::string::npos)
+            continue;
+
+        line[separator] = '\0';     // fin del topic
+        ingress.push(line.c_str(), line.c_str() + separator + 1, line.size() - separator - 1);
+        messages++;
+    }
+    return messages;
+}
+